@@ -0,0 +1,242 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "x_libpd_abstraction_cache.h"
+#include "x_libpd_path_cache.h"
+#include "x_libpd_binary_patch.h"
+
+/* not exported through any of pd's headers */
+void glob_setfilename(void* dummy, t_symbol* name, t_symbol* dir);
+int pd_setloadingabstraction(t_symbol* sym);
+
+/* Parsed abstractions are keyed by their full path, size and modification stamp.
+   Symbols and binbufs belong to the pd instance that created them, so every
+   instance has its own entries. Since path symbols are unique per instance,
+   comparing the symbol pointer is enough to find the right entry. */
+typedef struct _abscache_entry
+{
+    t_pdinstance* ae_instance;
+    t_symbol* ae_path;
+    int64_t ae_mtime;
+    int64_t ae_size;
+    unsigned int ae_generation;
+    t_binbuf* ae_binbuf;
+    struct _abscache_entry* ae_next;
+} t_abscache_entry;
+
+#define ABSCACHE_NBUCKETS 256
+
+static t_abscache_entry* abscache_buckets[ABSCACHE_NBUCKETS];
+static unsigned int abscache_generation = 0;
+static int abscache_hits, abscache_parses;
+
+/* the bucket lists are shared between all instances, which may run on different threads */
+static pthread_mutex_t abscache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int abscache_hash(t_symbol* path)
+{
+    return (unsigned int)(((size_t)path >> 4) % ABSCACHE_NBUCKETS);
+}
+
+/* Entries are only ever freed by the instance that owns them, while it holds its own lock.
+   That means that the binbuf we return can't be freed while we are evaluating it. */
+static t_binbuf* abscache_get(t_symbol* path, int64_t mtime, int64_t size)
+{
+    t_abscache_entry** bucket = &abscache_buckets[abscache_hash(path)];
+    t_abscache_entry* entry;
+    t_binbuf* b;
+
+    pthread_mutex_lock(&abscache_mutex);
+    for (entry = *bucket; entry; entry = entry->ae_next)
+    {
+        if (entry->ae_path == path && entry->ae_instance == pd_this)
+            break;
+    }
+
+    if (entry && entry->ae_generation == abscache_generation
+        && entry->ae_mtime == mtime && entry->ae_size == size)
+    {
+        abscache_hits++;
+        pthread_mutex_unlock(&abscache_mutex);
+        return entry->ae_binbuf;
+    }
+    pthread_mutex_unlock(&abscache_mutex);
+
+    /* missing or outdated: parse the file without holding the cache lock */
+    b = binbuf_new();
+    if (libpd_binary_patch_read(b, path->s_name))
+    {
+        binbuf_free(b);
+        return 0;
+    }
+
+    pthread_mutex_lock(&abscache_mutex);
+    abscache_parses++;
+    if (entry)
+        binbuf_free(entry->ae_binbuf);
+    else
+    {
+        entry = (t_abscache_entry*)getbytes(sizeof(t_abscache_entry));
+        entry->ae_instance = pd_this;
+        entry->ae_path = path;
+        entry->ae_next = *bucket;
+        *bucket = entry;
+    }
+    entry->ae_binbuf = b;
+    entry->ae_mtime = mtime;
+    entry->ae_size = size;
+    entry->ae_generation = abscache_generation;
+    pthread_mutex_unlock(&abscache_mutex);
+
+    return b;
+}
+
+/* same as binbuf_evalfile(), but evaluates an already parsed binbuf */
+static void abscache_eval(t_binbuf* b, t_symbol* name, t_symbol* dir)
+{
+    int dspstate = canvas_suspend_dsp();
+    t_pd *bounda = gensym("#A")->s_thing, *boundn = s__N.s_thing;
+
+    /* set filename so that new canvases can pick them up */
+    glob_setfilename(0, name, dir);
+
+    gensym("#A")->s_thing = 0;
+    s__N.s_thing = &pd_canvasmaker;
+    binbuf_eval(b, 0, 0, 0);
+    gensym("#A")->s_thing = bounda;
+    s__N.s_thing = boundn;
+
+    glob_setfilename(0, &s_, &s_);
+    canvas_resume_dsp(dspstate);
+}
+
+/* creator for abstractions, replaces pd's do_create_abstraction() */
+static void* abscache_new(t_symbol* s, int argc, t_atom* argv)
+{
+    char dirbuf[MAXPDSTRING], pathbuf[MAXPDSTRING], *nameptr;
+    t_canvas* owner = canvas_getcurrent();
+    t_binbuf* b = 0;
+    t_pd* was;
+    int64_t mtime, size;
+    int fd;
+
+    if (pd_setloadingabstraction(s))
+    {
+        pd_error(owner, "%s: can't load abstraction within itself\n", s->s_name);
+        return 0;
+    }
+
+    /* resolve relative to the owning canvas, two canvases may have different abstractions with the same name */
+    if ((fd = libpd_path_cache_open(owner, s->s_name, ".pd", dirbuf, &nameptr, MAXPDSTRING)) < 0)
+        return 0;
+
+    /* stat through the descriptor we already have, instead of hitting the path again */
+    if (libpd_binary_patch_stat(0, fd, &mtime, &size))
+    {
+        snprintf(pathbuf, MAXPDSTRING, "%s/%s", dirbuf, nameptr);
+        b = abscache_get(gensym(pathbuf), mtime, size);
+    }
+    sys_close(fd);
+
+    was = s__X.s_thing;
+    canvas_setargs(argc, argv);
+
+    if (b)
+        abscache_eval(b, gensym(nameptr), gensym(dirbuf));
+    else
+        binbuf_evalfile(gensym(nameptr), gensym(dirbuf));
+
+    if (s__X.s_thing && was != s__X.s_thing)
+        canvas_popabstraction((t_canvas*)(s__X.s_thing));
+    else
+        s__X.s_thing = was;
+
+    canvas_setargs(0, 0);
+    return pd_this->pd_newest;
+}
+
+/* Loaders are tried for every search path before pd tries to load an abstraction from it,
+   so registering our creator here takes over abstraction loading with the same precedence */
+static int abscache_loader(t_canvas* canvas, char const* classname, char const* path)
+{
+    char dirbuf[MAXPDSTRING], *nameptr;
+    int fd;
+
+    if (!path)
+        return 0;
+
+    if ((fd = sys_trytoopenone(path, classname, ".pd", dirbuf, &nameptr, MAXPDSTRING, 1)) < 0)
+        return 0;
+
+    sys_close(fd);
+    class_addcreator((t_newmethod)abscache_new, gensym(classname), A_GIMME, 0);
+    return 1;
+}
+
+void libpd_abstraction_cache_setup(void)
+{
+    sys_register_loader(abscache_loader);
+}
+
+void libpd_abstraction_cache_addcreator(t_symbol* s)
+{
+    class_addcreator((t_newmethod)abscache_new, s, A_GIMME, 0);
+}
+
+void libpd_abstraction_cache_invalidate(void)
+{
+    pthread_mutex_lock(&abscache_mutex);
+    abscache_generation++;
+    pthread_mutex_unlock(&abscache_mutex);
+}
+
+void libpd_abstraction_cache_get_stats(int* hits, int* parses)
+{
+    pthread_mutex_lock(&abscache_mutex);
+    *hits = abscache_hits;
+    *parses = abscache_parses;
+    pthread_mutex_unlock(&abscache_mutex);
+}
+
+void libpd_abstraction_cache_reset_stats(void)
+{
+    pthread_mutex_lock(&abscache_mutex);
+    abscache_hits = abscache_parses = 0;
+    pthread_mutex_unlock(&abscache_mutex);
+}
+
+void libpd_abstraction_cache_free(void)
+{
+    int i;
+    pthread_mutex_lock(&abscache_mutex);
+    for (i = 0; i < ABSCACHE_NBUCKETS; i++)
+    {
+        t_abscache_entry** entry = &abscache_buckets[i];
+        while (*entry)
+        {
+            t_abscache_entry* next = (*entry)->ae_next;
+            if ((*entry)->ae_instance == pd_this)
+            {
+                binbuf_free((*entry)->ae_binbuf);
+                freebytes(*entry, sizeof(t_abscache_entry));
+                *entry = next;
+            }
+            else
+                entry = &(*entry)->ae_next;
+        }
+    }
+    pthread_mutex_unlock(&abscache_mutex);
+}
@@ -0,0 +1,35 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Registers a loader that instantiates abstractions from a cache of parsed binbufs,
+// so creating N copies of an abstraction only reads and parses the file once
+void libpd_abstraction_cache_setup(void);
+
+// Registers the abstraction creator for a class name, for when we already know an abstraction provides it
+void libpd_abstraction_cache_addcreator(t_symbol* s);
+
+// Marks all cached abstractions as outdated, they will be reparsed on their next instantiation
+// Safe to call from any thread
+void libpd_abstraction_cache_invalidate(void);
+
+// Counters for benchmarking: instantiations that used a cached parse, and abstraction files that were parsed
+void libpd_abstraction_cache_get_stats(int* hits, int* parses);
+void libpd_abstraction_cache_reset_stats(void);
+
+// Frees all cache entries that belong to the current pd instance
+void libpd_abstraction_cache_free(void);
+
+#ifdef __cplusplus
+}
+#endif
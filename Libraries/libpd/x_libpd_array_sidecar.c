@@ -0,0 +1,396 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "x_libpd_array_sidecar.h"
+#include "x_libpd_mod_utils.h"
+
+/* Arrays that save their contents write them as "#A" messages of text floats, which makes large
+   tables slow to save, parse and evaluate. For large arrays, we replace those messages with
+   "#A read <name>.txt <name>.f32 <n>". The .f32 file holds the values as raw float32 in native
+   byte order, and the .txt file holds the same values in the format of the array "read" method.
+   Vanilla pd ignores the arguments after the first one, so it reads the text file. We replace
+   the "read" method of arrays, so that we read the raw file instead with a single read, and only
+   fall back to the text file if that fails. Pd arrays store their points as t_words, so there's
+   nothing to gain from mapping the file: the values are copied either way.
+
+   Sidecar files are named after the patch and the array. They are written before the patch, each
+   to a temporary file that is moved into place once it's complete, so a saved patch never refers to
+   contents that weren't written. If writing a sidecar fails, that array keeps its contents in the
+   patch. Sidecars that already hold the same values aren't written again. Once the patch is saved,
+   the ones that the previous version of the patch used but the new one doesn't are removed. */
+
+struct _sidecar
+{
+    char s_name[MAXPDSTRING]; /* file name, without extension */
+    float* s_values;
+    int s_size;
+    int s_n;
+    struct _sidecar* s_next;
+};
+
+struct _sidecars
+{
+    struct _sidecar* s_list;
+    t_binbuf* s_previous; /* references in the file we are about to replace */
+    char s_base[MAXPDSTRING];
+};
+
+typedef void (*t_sidecar_readfn)(t_garray* x, t_symbol* filename);
+static t_sidecar_readfn sidecar_garray_read;
+
+/* reads n raw values, returns 0 if that didn't work */
+static int sidecar_load(t_garray* x, t_symbol* file, int n)
+{
+    char path[MAXPDSTRING];
+    t_canvas* owner = canvas_getcurrent();
+    int size, i, ok;
+    t_word* vec;
+    float* values;
+    FILE* fd;
+
+    if (!garray_getfloatwords(x, &size, &vec))
+        return 0;
+
+    if (owner)
+        snprintf(path, MAXPDSTRING, "%s/%s", canvas_getdir(owner)->s_name, file->s_name);
+    else
+        snprintf(path, MAXPDSTRING, "%s", file->s_name);
+
+    if (n > size)
+        n = size;
+    if (n <= 0)
+        return 1;
+
+    if (!(fd = sys_fopen(path, "rb")))
+        return 0;
+
+    values = (float*)getbytes(n * sizeof(float));
+    if ((ok = (int)fread(values, sizeof(float), n, fd) == n))
+    {
+        for (i = 0; i < n; i++)
+            vec[i].w_float = values[i];
+        garray_redraw(x);
+    }
+
+    freebytes(values, n * sizeof(float));
+    sys_fclose(fd);
+    return ok;
+}
+
+static void sidecar_read(t_garray* x, t_symbol* s, int argc, t_atom* argv)
+{
+    if (argc == 3 && argv[1].a_type == A_SYMBOL && argv[2].a_type == A_FLOAT
+        && sidecar_load(x, argv[1].a_w.w_symbol, (int)argv[2].a_w.w_float))
+        return;
+
+    if (argc && argv[0].a_type == A_SYMBOL)
+        sidecar_garray_read(x, argv[0].a_w.w_symbol);
+    else
+        pd_error(x, "array read: no file name");
+}
+
+void libpd_array_sidecar_setup(void)
+{
+    /* keep the original method around for the text fallback */
+    t_pd cls = garray_class;
+    sidecar_garray_read = (t_sidecar_readfn)zgetfn(&cls, gensym("read"));
+    class_addmethod(garray_class, (t_method)sidecar_read, gensym("read"), A_GIMME, 0);
+}
+
+/* returns the number of atoms in the message that starts at onset, without the semicolon */
+static int sidecar_msglength(t_atom const* vec, int natom, int onset)
+{
+    int i;
+    for (i = onset; i < natom && vec[i].a_type != A_SEMI; i++)
+        ;
+    return i - onset;
+}
+
+static int sidecar_isdata(t_atom const* vec, int n)
+{
+    int i;
+    if (n < 2 || vec[0].a_type != A_SYMBOL || vec[0].a_w.w_symbol != gensym("#A"))
+        return 0;
+    for (i = 1; i < n; i++)
+    {
+        if (vec[i].a_type != A_FLOAT)
+            return 0;
+    }
+    return 1;
+}
+
+/* "#A read <name>.txt <name>.f32 <n>", see above */
+static int sidecar_isreference(t_atom const* vec, int n)
+{
+    return n == 5 && vec[0].a_type == A_SYMBOL && vec[0].a_w.w_symbol == gensym("#A")
+        && vec[1].a_type == A_SYMBOL && vec[1].a_w.w_symbol == gensym("read")
+        && vec[2].a_type == A_SYMBOL && vec[3].a_type == A_SYMBOL && vec[4].a_type == A_FLOAT;
+}
+
+/* writes to a temporary file first, so that the target always has complete contents */
+static int sidecar_writefile(struct _sidecar* y, char const* dir, int text)
+{
+    char path[MAXPDSTRING], tmppath[MAXPDSTRING];
+    int i, ok;
+    FILE* fd;
+
+    snprintf(path, MAXPDSTRING, "%s/%s.%s", dir, y->s_name, text ? "txt" : "f32");
+    snprintf(tmppath, MAXPDSTRING, "%s.tmp", path);
+    if (!(fd = sys_fopen(tmppath, text ? "w" : "wb")))
+        return 0;
+
+    if (text)
+    {
+        for (i = 0, ok = 1; i < y->s_n && ok; i++)
+            ok = fprintf(fd, "%g\n", y->s_values[i]) > 0;
+    }
+    else
+        ok = (int)fwrite(y->s_values, sizeof(float), y->s_n, fd) == y->s_n;
+    ok = !sys_fclose(fd) && ok;
+
+    if (!ok || !libpd_commitfile(tmppath, path))
+    {
+        remove(tmppath);
+        return 0;
+    }
+    return 1;
+}
+
+/* the raw file already holds exactly these values, and the text file is still there */
+static int sidecar_isunchanged(struct _sidecar* y, char const* dir)
+{
+    char path[MAXPDSTRING];
+    float* values;
+    FILE* fd;
+    int ok;
+
+    snprintf(path, MAXPDSTRING, "%s/%s.txt", dir, y->s_name);
+    if (!(fd = sys_fopen(path, "rb")))
+        return 0;
+    sys_fclose(fd);
+
+    snprintf(path, MAXPDSTRING, "%s/%s.f32", dir, y->s_name);
+    if (!(fd = sys_fopen(path, "rb")))
+        return 0;
+
+    /* ask for one value more than we have, so a longer file doesn't count as the same */
+    values = (float*)getbytes((y->s_n + 1) * sizeof(float));
+    ok = (int)fread(values, sizeof(float), y->s_n + 1, fd) == y->s_n
+        && !memcmp(values, y->s_values, y->s_n * sizeof(float));
+    freebytes(values, (y->s_n + 1) * sizeof(float));
+    sys_fclose(fd);
+    return ok;
+}
+
+static void sidecar_freeone(struct _sidecar* y)
+{
+    freebytes(y->s_values, y->s_size * sizeof(float));
+    freebytes(y, sizeof(struct _sidecar));
+}
+
+/* "<patch>.<array>", with everything that doesn't belong in a file name replaced */
+static void sidecar_makename(struct _sidecars* s, char* name, char const* base, t_atom* array)
+{
+    char arrayname[MAXPDSTRING], *c;
+    struct _sidecar* y;
+    int count = 1;
+
+    atom_string(array, arrayname, MAXPDSTRING);
+    for (c = arrayname; *c; c++)
+    {
+        if (!((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '-' || *c == '_'))
+            *c = '_';
+    }
+    snprintf(name, MAXPDSTRING, "%s.%s", base, arrayname);
+
+    /* pd allows multiple arrays with the same name, they still need their own file */
+    for (y = s->s_list; y;)
+    {
+        if (strcmp(y->s_name, name))
+        {
+            y = y->s_next;
+            continue;
+        }
+        snprintf(name, MAXPDSTRING, "%s.%s-%d", base, arrayname, ++count);
+        y = s->s_list;
+    }
+}
+
+/* collects the values of the data messages that start at onset, returns the number of points */
+static int sidecar_collect(t_atom const* vec, int natom, int onset, float* values, int size)
+{
+    int i = onset, n = 0;
+
+    /* every data message starts with the index of its first value */
+    while (i < natom)
+    {
+        int len = sidecar_msglength(vec, natom, i), j, index;
+        if (!sidecar_isdata(vec + i, len))
+            break;
+        index = (int)vec[i + 1].a_w.w_float;
+        for (j = 2; j < len && index >= 0 && index < size; j++, index++)
+            values[index] = vec[i + j].a_w.w_float;
+        if (index > n)
+            n = index;
+        i += len + 1;
+    }
+    return n;
+}
+
+t_libpd_sidecars* libpd_array_sidecar_prepare(t_binbuf* b, t_symbol* filename, t_symbol* dir)
+{
+    struct _sidecars* s = (struct _sidecars*)getbytes(sizeof(struct _sidecars));
+    struct _sidecar** last = &s->s_list;
+    t_binbuf* result = 0;
+    t_atom* vec = binbuf_getvec(b);
+    int natom = binbuf_getnatom(b), i = 0, copied = 0;
+    char *base = s->s_base, *ext;
+
+    snprintf(base, MAXPDSTRING, "%s", filename->s_name);
+    if ((ext = strrchr(base, '.')))
+        *ext = 0;
+
+    while (i < natom)
+    {
+        int len = sidecar_msglength(vec, natom, i), size, next;
+        struct _sidecar* y;
+        char txt[MAXPDSTRING], raw[MAXPDSTRING];
+        t_atom data[5];
+
+        /* "#X array name size type flags", bit 0 of flags means the contents are saved */
+        next = i + len + 1;
+        if (len < 6 || vec[i + 1].a_type != A_SYMBOL || vec[i + 1].a_w.w_symbol != gensym("array")
+            || vec[i + 3].a_type != A_FLOAT || vec[i + 5].a_type != A_FLOAT
+            || !((int)vec[i + 5].a_w.w_float & 1)
+            || (size = (int)vec[i + 3].a_w.w_float) < LIBPD_SIDECAR_MINSIZE
+            || next >= natom || !sidecar_isdata(vec + next, sidecar_msglength(vec, natom, next)))
+        {
+            i = next;
+            continue;
+        }
+
+        y = (struct _sidecar*)getbytes(sizeof(struct _sidecar));
+        sidecar_makename(s, y->s_name, base, vec + i + 2);
+        y->s_size = size;
+        y->s_values = (float*)getbytes(size * sizeof(float));
+        y->s_n = sidecar_collect(vec, natom, next, y->s_values, size);
+
+        /* the text file is what vanilla pd reads, and our fallback if the raw file is missing */
+        if (!sidecar_isunchanged(y, dir->s_name)
+            && (!sidecar_writefile(y, dir->s_name, 1) || !sidecar_writefile(y, dir->s_name, 0)))
+        {
+            pd_error(0, "%s/%s: couldn't write array contents, saving them in the patch instead", dir->s_name, y->s_name);
+            sidecar_freeone(y);
+            i = next;
+            continue;
+        }
+
+        *last = y;
+        last = &y->s_next;
+
+        /* copy everything up to and including the array message, then replace its data */
+        if (!result)
+            result = binbuf_new();
+        binbuf_add(result, next - copied, vec + copied);
+
+        snprintf(txt, MAXPDSTRING, "%s.txt", y->s_name);
+        snprintf(raw, MAXPDSTRING, "%s.f32", y->s_name);
+        SETSYMBOL(data, gensym("#A"));
+        SETSYMBOL(data + 1, gensym("read"));
+        SETSYMBOL(data + 2, gensym(txt));
+        SETSYMBOL(data + 3, gensym(raw));
+        SETFLOAT(data + 4, y->s_n);
+        binbuf_add(result, 5, data);
+        binbuf_addsemi(result);
+
+        for (i = next; i < natom;)
+        {
+            len = sidecar_msglength(vec, natom, i);
+            if (!sidecar_isdata(vec + i, len))
+                break;
+            i += len + 1;
+        }
+        copied = i;
+    }
+
+    if (result)
+    {
+        if (copied < natom)
+            binbuf_add(result, natom - copied, vec + copied);
+        binbuf_clear(b);
+        binbuf_add(b, binbuf_getnatom(result), binbuf_getvec(result));
+        binbuf_free(result);
+    }
+
+    /* remember which sidecars the file we are replacing used */
+    s->s_previous = binbuf_new();
+    if (binbuf_read(s->s_previous, filename->s_name, dir->s_name, 0))
+        binbuf_clear(s->s_previous);
+
+    return s;
+}
+
+static int sidecar_isused(struct _sidecars* s, t_symbol* file)
+{
+    struct _sidecar* y;
+    char name[MAXPDSTRING];
+    for (y = s->s_list; y; y = y->s_next)
+    {
+        snprintf(name, MAXPDSTRING, "%s.txt", y->s_name);
+        if (!strcmp(name, file->s_name))
+            return 1;
+        snprintf(name, MAXPDSTRING, "%s.f32", y->s_name);
+        if (!strcmp(name, file->s_name))
+            return 1;
+    }
+    return 0;
+}
+
+void libpd_array_sidecar_commit(t_libpd_sidecars* s, t_symbol* dir)
+{
+    t_atom* vec = binbuf_getvec(s->s_previous);
+    int natom = binbuf_getnatom(s->s_previous), baselen = (int)strlen(s->s_base), i, j;
+
+    for (i = 0; i < natom; i += sidecar_msglength(vec, natom, i) + 1)
+    {
+        if (!sidecar_isreference(vec + i, sidecar_msglength(vec, natom, i)))
+            continue;
+        for (j = 2; j < 4; j++)
+        {
+            char path[MAXPDSTRING];
+            t_symbol* file = vec[i + j].a_w.w_symbol;
+            /* only touch files that we named */
+            if (sidecar_isused(s, file) || strncmp(file->s_name, s->s_base, baselen) || file->s_name[baselen] != '.'
+                || strchr(file->s_name, '/') || strchr(file->s_name, '\\'))
+                continue;
+            snprintf(path, MAXPDSTRING, "%s/%s", dir->s_name, file->s_name);
+            remove(path);
+        }
+    }
+
+    libpd_array_sidecar_free(s);
+}
+
+void libpd_array_sidecar_free(t_libpd_sidecars* s)
+{
+    struct _sidecar *y, *next;
+    for (y = s->s_list; y; y = next)
+    {
+        next = y->s_next;
+        sidecar_freeone(y);
+    }
+    binbuf_free(s->s_previous);
+    freebytes(s, sizeof(struct _sidecars));
+}
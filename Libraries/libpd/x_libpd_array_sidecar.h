@@ -0,0 +1,34 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Arrays with at least this many points get their saved contents stored in a sidecar file
+#define LIBPD_SIDECAR_MINSIZE 262144
+
+typedef struct _sidecars t_libpd_sidecars;
+
+// Teaches arrays to read their contents from a sidecar file while loading
+void libpd_array_sidecar_setup(void);
+
+// Writes the contents of large arrays in a patch that is about to be saved to filename in dir to sidecar files,
+// and replaces them in the patch with a reference. Arrays whose sidecar couldn't be written keep their contents.
+// Once the patch is saved, pass the result to libpd_array_sidecar_commit, or to libpd_array_sidecar_free if saving failed
+t_libpd_sidecars* libpd_array_sidecar_prepare(t_binbuf* b, t_symbol* filename, t_symbol* dir);
+
+// Removes the sidecar files the previous version of the patch used that aren't needed anymore
+void libpd_array_sidecar_commit(t_libpd_sidecars* sidecars, t_symbol* dir);
+void libpd_array_sidecar_free(t_libpd_sidecars* sidecars);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,867 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <sys/utime.h>
+#include <s_utf8.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "x_libpd_binary_patch.h"
+#include "x_libpd_mod_utils.h"
+
+/* not exported through any of pd's headers */
+void glob_setfilename(void* dummy, t_symbol* name, t_symbol* dir);
+void pd_doloadbang(void);
+
+/* Loading a patch normally means tokenising its text, looking up every symbol and then evaluating
+   it message by message. We store the parsed atoms of every patch we read in a binary file, so the
+   next time it gets opened we can skip straight to evaluating. The file is laid out so it can be
+   mapped and read in place:
+
+   header
+   symbol table: nul-terminated strings, every distinct symbol once, padded to 8 bytes
+   atom types: one byte per atom, padded to 8 bytes
+   atom values: 8 bytes per atom, a double for floats or an index for symbols and dollars
+   object table: the atom onset of every message that creates an object or canvas
+
+   Files are named after a hash of the full path of the patch, and are regenerated when the
+   modification time (in nanoseconds where the file system has them) or size of the patch changes.
+
+   Precompiled files are only a cache, so they are written on a background thread without flushing
+   them to disk: the header carries a checksum, so a file that didn't make it to disk completely
+   just gets regenerated. The same thread keeps the cache folder below BINPATCH_MAXFILES files and
+   BINPATCH_MAXBYTES bytes, by removing the files that were used least recently. */
+
+#define BINPATCH_MAGIC 0x70644243 /* "pdBC" */
+#define BINPATCH_VERSION 2
+
+#define BINPATCH_MAXFILES 2048
+#define BINPATCH_MAXBYTES ((int64_t)256 << 20)
+#define BINPATCH_MAXEXCLUDED 8
+
+enum
+{
+    BINPATCH_FLOAT,
+    BINPATCH_SYMBOL,
+    BINPATCH_SEMI,
+    BINPATCH_COMMA,
+    BINPATCH_DOLLAR,
+    BINPATCH_DOLLSYM
+};
+
+typedef struct _binpatch_header
+{
+    uint32_t h_magic;
+    uint32_t h_version;
+    int64_t h_mtime;
+    int64_t h_size;
+    uint64_t h_checksum; /* of everything after the header */
+    uint32_t h_nsymbols;
+    uint32_t h_symbolbytes; /* including padding */
+    uint32_t h_natoms;
+    uint32_t h_nobjects;
+} t_binpatch_header;
+
+/* a file for the writer thread, or a file that was used if j_data is null */
+typedef struct _binpatch_job
+{
+    char j_file[MAXPDSTRING];
+    unsigned char* j_data;
+    size_t j_size;
+    struct _binpatch_job* j_next;
+} t_binpatch_job;
+
+/* what the writer thread knows about the cache folder */
+typedef struct _binpatch_entry
+{
+    char* e_file;
+    int64_t e_size;
+    int64_t e_used;
+} t_binpatch_entry;
+
+static char* binpatch_dir;
+static char* binpatch_excluded[BINPATCH_MAXEXCLUDED];
+static int binpatch_hits, binpatch_misses, binpatch_objects;
+static pthread_mutex_t binpatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static t_binpatch_job* binpatch_jobs;
+static t_binpatch_job** binpatch_lastjob = &binpatch_jobs;
+static pthread_cond_t binpatch_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t binpatch_idle = PTHREAD_COND_INITIALIZER;
+static int binpatch_writing, binpatch_busy;
+
+/* only used by the writer thread */
+static t_binpatch_entry* binpatch_index;
+static int binpatch_nindex, binpatch_indexsize;
+static int64_t binpatch_totalbytes;
+static char binpatch_indexdir[MAXPDSTRING];
+
+#define BINPATCH_PAD(n) (((n) + 7) & ~(size_t)7)
+
+void libpd_binary_patch_setdir(char const* dir)
+{
+    pthread_mutex_lock(&binpatch_mutex);
+    free(binpatch_dir);
+    binpatch_dir = dir ? strdup(dir) : 0;
+    pthread_mutex_unlock(&binpatch_mutex);
+}
+
+void libpd_binary_patch_exclude(char const* dir)
+{
+    int i;
+    pthread_mutex_lock(&binpatch_mutex);
+    for (i = 0; i < BINPATCH_MAXEXCLUDED; i++)
+    {
+        if (!binpatch_excluded[i])
+        {
+            binpatch_excluded[i] = strdup(dir);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&binpatch_mutex);
+}
+
+int libpd_binary_patch_stat(char const* path, int fd, int64_t* mtime, int64_t* size)
+{
+#ifdef _WIN32
+    /* the CRT only gives us seconds, file times count 100ns intervals */
+    ULARGE_INTEGER modified, length;
+    if (fd >= 0)
+    {
+        BY_HANDLE_FILE_INFORMATION info;
+        if (!GetFileInformationByHandle((HANDLE)_get_osfhandle(fd), &info))
+            return 0;
+        modified.LowPart = info.ftLastWriteTime.dwLowDateTime;
+        modified.HighPart = info.ftLastWriteTime.dwHighDateTime;
+        length.LowPart = info.nFileSizeLow;
+        length.HighPart = info.nFileSizeHigh;
+    }
+    else
+    {
+        WIN32_FILE_ATTRIBUTE_DATA info;
+        wchar_t ucs2path[MAXPDSTRING];
+        u8_utf8toucs2(ucs2path, MAXPDSTRING, path, MAXPDSTRING - 1);
+        if (!GetFileAttributesExW(ucs2path, GetFileExInfoStandard, &info))
+            return 0;
+        modified.LowPart = info.ftLastWriteTime.dwLowDateTime;
+        modified.HighPart = info.ftLastWriteTime.dwHighDateTime;
+        length.LowPart = info.nFileSizeLow;
+        length.HighPart = info.nFileSizeHigh;
+    }
+    *mtime = (int64_t)modified.QuadPart;
+    *size = (int64_t)length.QuadPart;
+#else
+    struct stat st;
+    if (fd >= 0 ? fstat(fd, &st) : stat(path, &st))
+        return 0;
+#ifdef __APPLE__
+    *mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    *size = (int64_t)st.st_size;
+#endif
+    return 1;
+}
+
+static int binpatch_isbelow(char const* path, char const* dir)
+{
+    size_t i;
+    for (i = 0; dir[i]; i++)
+    {
+        char a = path[i] == '\\' ? '/' : path[i], b = dir[i] == '\\' ? '/' : dir[i];
+#ifdef _WIN32
+        if (a >= 'A' && a <= 'Z')
+            a += 'a' - 'A';
+        if (b >= 'A' && b <= 'Z')
+            b += 'a' - 'A';
+#endif
+        if (a != b)
+            return 0;
+    }
+    return path[i] == '/' || path[i] == '\\' || (i && (dir[i - 1] == '/' || dir[i - 1] == '\\'));
+}
+
+/* returns 0 if precompiling is disabled, or the patch shouldn't be precompiled */
+static int binpatch_getpath(char const* path, char* result)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    char const* c;
+    int ok, i;
+
+    /* FNV-1a */
+    for (c = path; *c; c++)
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+
+    pthread_mutex_lock(&binpatch_mutex);
+    if ((ok = binpatch_dir != 0))
+        snprintf(result, MAXPDSTRING, "%s/%016llx.pdc", binpatch_dir, (unsigned long long)hash);
+
+    /* temporary files rarely get opened twice, they would only fill up the cache */
+    for (i = 0; ok && i < BINPATCH_MAXEXCLUDED && binpatch_excluded[i]; i++)
+        ok = !binpatch_isbelow(path, binpatch_excluded[i]);
+    pthread_mutex_unlock(&binpatch_mutex);
+    return ok;
+}
+
+static uint64_t binpatch_checksum(unsigned char const* data, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+    for (i = 0; i < length; i++)
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    return hash;
+}
+
+static int binpatch_isobject(t_atom const* vec, int n)
+{
+    t_symbol *type, *sel;
+    if (n < 2 || vec[0].a_type != A_SYMBOL || vec[1].a_type != A_SYMBOL)
+        return 0;
+    type = vec[0].a_w.w_symbol;
+    sel = vec[1].a_w.w_symbol;
+    if (type == gensym("#N"))
+        return sel == gensym("canvas");
+    return type == gensym("#X") && (sel == gensym("obj") || sel == gensym("msg") || sel == gensym("text")
+        || sel == gensym("floatatom") || sel == gensym("symbolatom") || sel == gensym("listbox"));
+}
+
+/* ------------------------- writer thread ------------------------- */
+
+static int binpatch_rename(char const* from, char const* to)
+{
+#ifdef _WIN32
+    wchar_t ucs2from[MAXPDSTRING], ucs2to[MAXPDSTRING];
+    u8_utf8toucs2(ucs2from, MAXPDSTRING, from, MAXPDSTRING - 1);
+    u8_utf8toucs2(ucs2to, MAXPDSTRING, to, MAXPDSTRING - 1);
+    return MoveFileExW(ucs2from, ucs2to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static void binpatch_touch(char const* file)
+{
+#ifdef _WIN32
+    wchar_t ucs2file[MAXPDSTRING];
+    u8_utf8toucs2(ucs2file, MAXPDSTRING, file, MAXPDSTRING - 1);
+    _wutime(ucs2file, 0);
+#else
+    utime(file, 0);
+#endif
+}
+
+static void binpatch_indexfile(char const* file, int64_t size, int64_t used)
+{
+    int i;
+    for (i = 0; i < binpatch_nindex; i++)
+    {
+        if (!strcmp(binpatch_index[i].e_file, file))
+            break;
+    }
+    if (i == binpatch_nindex)
+    {
+        if (binpatch_nindex == binpatch_indexsize)
+        {
+            binpatch_indexsize = binpatch_indexsize ? binpatch_indexsize * 2 : 64;
+            binpatch_index = (t_binpatch_entry*)realloc(binpatch_index, binpatch_indexsize * sizeof(t_binpatch_entry));
+        }
+        binpatch_index[binpatch_nindex].e_file = strdup(file);
+        binpatch_index[binpatch_nindex].e_size = 0;
+        binpatch_nindex++;
+    }
+    if (size >= 0)
+    {
+        binpatch_totalbytes += size - binpatch_index[i].e_size;
+        binpatch_index[i].e_size = size;
+    }
+    binpatch_index[i].e_used = used;
+}
+
+static int binpatch_ispdc(char const* name)
+{
+    size_t len = strlen(name);
+    return len > 4 && !strcmp(name + len - 4, ".pdc");
+}
+
+static void binpatch_scanfile(char const* dir, char const* name, int64_t size, int64_t used)
+{
+    char file[MAXPDSTRING];
+    size_t len = strlen(name);
+    snprintf(file, MAXPDSTRING, "%s/%s", dir, name);
+
+    /* left behind by a write that didn't finish */
+    if (len > 8 && !strcmp(name + len - 8, ".pdc.tmp"))
+        remove(file);
+    else if (binpatch_ispdc(name))
+        binpatch_indexfile(file, size, used);
+}
+
+/* builds the index of the cache folder the first time we write to it */
+static void binpatch_scan(char const* file)
+{
+    char dir[MAXPDSTRING], *slash;
+    int i;
+
+    snprintf(dir, MAXPDSTRING, "%s", file);
+    if ((slash = strrchr(dir, '/')))
+        *slash = 0;
+    if (!strcmp(dir, binpatch_indexdir))
+        return;
+
+    for (i = 0; i < binpatch_nindex; i++)
+        free(binpatch_index[i].e_file);
+    binpatch_nindex = 0;
+    binpatch_totalbytes = 0;
+    snprintf(binpatch_indexdir, MAXPDSTRING, "%s", dir);
+
+#ifdef _WIN32
+    {
+        char pattern[MAXPDSTRING];
+        wchar_t ucs2pattern[MAXPDSTRING];
+        WIN32_FIND_DATAW data;
+        HANDLE handle;
+
+        snprintf(pattern, MAXPDSTRING, "%s/*", dir);
+        u8_utf8toucs2(ucs2pattern, MAXPDSTRING, pattern, MAXPDSTRING - 1);
+        if ((handle = FindFirstFileW(ucs2pattern, &data)) != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                char name[MAXPDSTRING];
+                ULARGE_INTEGER modified, size;
+                u8_ucs2toutf8(name, MAXPDSTRING, data.cFileName, -1);
+                modified.LowPart = data.ftLastWriteTime.dwLowDateTime;
+                modified.HighPart = data.ftLastWriteTime.dwHighDateTime;
+                size.LowPart = data.nFileSizeLow;
+                size.HighPart = data.nFileSizeHigh;
+                /* file times count 100ns intervals since 1601 */
+                binpatch_scanfile(dir, name, (int64_t)size.QuadPart, (int64_t)(modified.QuadPart / 10000000ULL) - 11644473600LL);
+            } while (FindNextFileW(handle, &data));
+            FindClose(handle);
+        }
+    }
+#else
+    {
+        DIR* d = opendir(dir);
+        struct dirent* entry;
+        if (d)
+        {
+            while ((entry = readdir(d)))
+            {
+                char path[MAXPDSTRING];
+                struct stat st;
+                snprintf(path, MAXPDSTRING, "%s/%s", dir, entry->d_name);
+                if (!stat(path, &st))
+                    binpatch_scanfile(dir, entry->d_name, (int64_t)st.st_size, (int64_t)st.st_mtime);
+            }
+            closedir(d);
+        }
+    }
+#endif
+}
+
+/* removes the least recently used files until the cache fits its limits */
+static void binpatch_evict(void)
+{
+    while (binpatch_nindex > BINPATCH_MAXFILES || (binpatch_totalbytes > BINPATCH_MAXBYTES && binpatch_nindex > 1))
+    {
+        int i, oldest = 0;
+        for (i = 1; i < binpatch_nindex; i++)
+        {
+            if (binpatch_index[i].e_used < binpatch_index[oldest].e_used)
+                oldest = i;
+        }
+        remove(binpatch_index[oldest].e_file);
+        binpatch_totalbytes -= binpatch_index[oldest].e_size;
+        free(binpatch_index[oldest].e_file);
+        binpatch_index[oldest] = binpatch_index[--binpatch_nindex];
+    }
+}
+
+static void binpatch_write(t_binpatch_job* job)
+{
+    char tmpfile[MAXPDSTRING];
+    FILE* fd;
+    int ok;
+
+    snprintf(tmpfile, MAXPDSTRING, "%s.tmp", job->j_file);
+    if (!(fd = sys_fopen(tmpfile, "wb")))
+        return;
+    ok = fwrite(job->j_data, 1, job->j_size, fd) == job->j_size;
+    ok = !sys_fclose(fd) && ok;
+
+    if (!ok || !binpatch_rename(tmpfile, job->j_file))
+    {
+        remove(tmpfile);
+        return;
+    }
+    binpatch_indexfile(job->j_file, (int64_t)job->j_size, (int64_t)time(0));
+    binpatch_evict();
+}
+
+static void* binpatch_writer(void* arg)
+{
+    pthread_mutex_lock(&binpatch_mutex);
+    for (;;)
+    {
+        t_binpatch_job* job;
+        binpatch_busy = 0;
+        if (!binpatch_jobs)
+            pthread_cond_broadcast(&binpatch_idle);
+        while (!binpatch_jobs)
+            pthread_cond_wait(&binpatch_cond, &binpatch_mutex);
+
+        binpatch_busy = 1;
+        job = binpatch_jobs;
+        if (!(binpatch_jobs = job->j_next))
+            binpatch_lastjob = &binpatch_jobs;
+        pthread_mutex_unlock(&binpatch_mutex);
+
+        binpatch_scan(job->j_file);
+        if (job->j_data)
+        {
+            binpatch_write(job);
+            free(job->j_data);
+        }
+        else
+        {
+            binpatch_touch(job->j_file);
+            binpatch_indexfile(job->j_file, -1, (int64_t)time(0));
+        }
+        free(job);
+
+        pthread_mutex_lock(&binpatch_mutex);
+    }
+    return 0;
+}
+
+/* hands a file over to the writer thread, takes ownership of data */
+static void binpatch_post(char const* file, unsigned char* data, size_t size)
+{
+    t_binpatch_job* job = (t_binpatch_job*)malloc(sizeof(t_binpatch_job));
+    snprintf(job->j_file, MAXPDSTRING, "%s", file);
+    job->j_data = data;
+    job->j_size = size;
+    job->j_next = 0;
+
+    pthread_mutex_lock(&binpatch_mutex);
+    if (!binpatch_writing)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, binpatch_writer, 0))
+        {
+            pthread_mutex_unlock(&binpatch_mutex);
+            free(job->j_data);
+            free(job);
+            return;
+        }
+        pthread_detach(thread);
+        binpatch_writing = 1;
+    }
+    *binpatch_lastjob = job;
+    binpatch_lastjob = &job->j_next;
+    pthread_cond_signal(&binpatch_cond);
+    pthread_mutex_unlock(&binpatch_mutex);
+}
+
+void libpd_binary_patch_flush(void)
+{
+    pthread_mutex_lock(&binpatch_mutex);
+    while (binpatch_writing && (binpatch_jobs || binpatch_busy))
+        pthread_cond_wait(&binpatch_idle, &binpatch_mutex);
+    pthread_mutex_unlock(&binpatch_mutex);
+}
+
+/* ------------------------- reading and writing ------------------------- */
+
+/* reads the binbuf from a precompiled file, returns 0 if it's missing, outdated or damaged */
+static int binpatch_load(t_binbuf* b, char const* file, int64_t mtime, int64_t size)
+{
+    t_binpatch_header const* h;
+    unsigned char const *data, *types;
+    t_symbol** symbols = 0;
+    t_atom* atoms = 0;
+    double const* values;
+    size_t length, offset, expected;
+    uint32_t i;
+    int ok = 0;
+
+#ifdef _WIN32
+    FILE* fd = sys_fopen(file, "rb");
+    unsigned char* buffer;
+    if (!fd)
+        return 0;
+    fseek(fd, 0, SEEK_END);
+    length = (size_t)ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    buffer = (unsigned char*)malloc(length ? length : 1);
+    if (fread(buffer, 1, length, fd) != length)
+        length = 0;
+    sys_fclose(fd);
+    data = buffer;
+#else
+    struct stat binst;
+    void* mapped;
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &binst) || !binst.st_size)
+    {
+        close(fd);
+        return 0;
+    }
+    length = (size_t)binst.st_size;
+    mapped = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return 0;
+    data = (unsigned char const*)mapped;
+#endif
+
+    h = (t_binpatch_header const*)data;
+    if (length < sizeof(*h) || h->h_magic != BINPATCH_MAGIC || h->h_version != BINPATCH_VERSION
+        || h->h_mtime != mtime || h->h_size != size)
+        goto done;
+
+    offset = sizeof(*h);
+    expected = offset + (size_t)h->h_symbolbytes + BINPATCH_PAD((size_t)h->h_natoms)
+        + (size_t)h->h_natoms * sizeof(double) + (size_t)h->h_nobjects * sizeof(uint32_t);
+    if (expected != length || binpatch_checksum(data + offset, length - offset) != h->h_checksum)
+        goto done;
+
+    /* intern every symbol once */
+    symbols = (t_symbol**)getbytes((h->h_nsymbols + 1) * sizeof(t_symbol*));
+    for (i = 0; i < h->h_nsymbols; i++)
+    {
+        char const* name = (char const*)data + offset;
+        size_t len = strnlen(name, sizeof(*h) + h->h_symbolbytes - offset);
+        if (offset + len >= sizeof(*h) + h->h_symbolbytes)
+            goto done;
+        symbols[i] = gensym(name);
+        offset += len + 1;
+    }
+    offset = sizeof(*h) + h->h_symbolbytes;
+
+    types = data + offset;
+    values = (double const*)(data + offset + BINPATCH_PAD((size_t)h->h_natoms));
+
+    atoms = (t_atom*)getbytes((h->h_natoms + 1) * sizeof(t_atom));
+    for (i = 0; i < h->h_natoms; i++)
+    {
+        uint64_t index;
+        memcpy(&index, values + i, sizeof(index));
+        switch (types[i])
+        {
+        case BINPATCH_FLOAT:
+            SETFLOAT(atoms + i, (t_float)values[i]);
+            break;
+        case BINPATCH_SYMBOL:
+        case BINPATCH_DOLLSYM:
+            if (index >= h->h_nsymbols)
+                goto done;
+            if (types[i] == BINPATCH_SYMBOL)
+                SETSYMBOL(atoms + i, symbols[index]);
+            else
+                SETDOLLSYM(atoms + i, symbols[index]);
+            break;
+        case BINPATCH_SEMI:
+            SETSEMI(atoms + i);
+            break;
+        case BINPATCH_COMMA:
+            SETCOMMA(atoms + i);
+            break;
+        case BINPATCH_DOLLAR:
+            SETDOLLAR(atoms + i, (int)index);
+            break;
+        default:
+            goto done;
+        }
+    }
+
+    binbuf_clear(b);
+    binbuf_add(b, (int)h->h_natoms, atoms);
+    ok = 1;
+
+    pthread_mutex_lock(&binpatch_mutex);
+    binpatch_objects += (int)h->h_nobjects;
+    pthread_mutex_unlock(&binpatch_mutex);
+
+done:
+    if (atoms)
+        freebytes(atoms, (h->h_natoms + 1) * sizeof(t_atom));
+    if (symbols)
+        freebytes(symbols, (h->h_nsymbols + 1) * sizeof(t_symbol*));
+#ifdef _WIN32
+    free(buffer);
+#else
+    munmap(mapped, length);
+#endif
+    return ok;
+}
+
+typedef struct _binpatch_symbols
+{
+    t_symbol** s_table; /* open addressing, s_size is a power of two */
+    uint32_t* s_index;
+    uint32_t s_size;
+    uint32_t s_n;
+} t_binpatch_symbols;
+
+static uint32_t binpatch_symbolindex(t_binpatch_symbols* s, t_symbol* sym)
+{
+    uint32_t slot = (uint32_t)(((size_t)sym >> 4) & (s->s_size - 1));
+    while (s->s_table[slot] && s->s_table[slot] != sym)
+        slot = (slot + 1) & (s->s_size - 1);
+    if (!s->s_table[slot])
+    {
+        s->s_table[slot] = sym;
+        s->s_index[slot] = s->s_n++;
+    }
+    return s->s_index[slot];
+}
+
+/* lays out the precompiled form of a binbuf in memory and passes it on to the writer thread,
+   it's fine if this fails */
+static void binpatch_save(t_binbuf* b, char const* file, int64_t mtime, int64_t size)
+{
+    t_atom* vec = binbuf_getvec(b);
+    uint32_t natom = (uint32_t)binbuf_getnatom(b), nobjects = 0, i, start = 0;
+    t_binpatch_symbols symbols;
+    t_binpatch_header h;
+    t_symbol** ordered;
+    unsigned char *types, *data, *c;
+    double* values;
+    uint32_t* objects;
+    size_t symbolbytes = 0, length;
+    int ok = 1;
+
+    symbols.s_size = 64;
+    while (symbols.s_size < natom * 2)
+        symbols.s_size *= 2;
+    symbols.s_n = 0;
+    symbols.s_table = (t_symbol**)getbytes(symbols.s_size * sizeof(t_symbol*));
+    symbols.s_index = (uint32_t*)getbytes(symbols.s_size * sizeof(uint32_t));
+
+    types = (unsigned char*)getbytes(BINPATCH_PAD((size_t)natom) + 1);
+    values = (double*)getbytes((natom + 1) * sizeof(double));
+    objects = (uint32_t*)getbytes((natom + 1) * sizeof(uint32_t));
+
+    for (i = 0; i < natom && ok; i++)
+    {
+        uint64_t index = 0;
+        switch (vec[i].a_type)
+        {
+        case A_FLOAT:
+            types[i] = BINPATCH_FLOAT;
+            values[i] = vec[i].a_w.w_float;
+            continue;
+        case A_SYMBOL:
+            types[i] = BINPATCH_SYMBOL;
+            index = binpatch_symbolindex(&symbols, vec[i].a_w.w_symbol);
+            break;
+        case A_DOLLSYM:
+            types[i] = BINPATCH_DOLLSYM;
+            index = binpatch_symbolindex(&symbols, vec[i].a_w.w_symbol);
+            break;
+        case A_SEMI:
+            types[i] = BINPATCH_SEMI;
+            if (binpatch_isobject(vec + start, i - start))
+                objects[nobjects++] = start;
+            start = i + 1;
+            break;
+        case A_COMMA:
+            types[i] = BINPATCH_COMMA;
+            break;
+        case A_DOLLAR:
+            types[i] = BINPATCH_DOLLAR;
+            index = (uint64_t)vec[i].a_w.w_index;
+            break;
+        default:
+            ok = 0;
+            break;
+        }
+        memcpy(values + i, &index, sizeof(index));
+    }
+
+    /* symbols in the order of their index */
+    ordered = (t_symbol**)getbytes((symbols.s_n + 1) * sizeof(t_symbol*));
+    for (i = 0; i < symbols.s_size; i++)
+    {
+        if (symbols.s_table[i])
+        {
+            ordered[symbols.s_index[i]] = symbols.s_table[i];
+            symbolbytes += strlen(symbols.s_table[i]->s_name) + 1;
+        }
+    }
+
+    memset(&h, 0, sizeof(h));
+    h.h_magic = BINPATCH_MAGIC;
+    h.h_version = BINPATCH_VERSION;
+    h.h_mtime = mtime;
+    h.h_size = size;
+    h.h_nsymbols = symbols.s_n;
+    h.h_symbolbytes = (uint32_t)BINPATCH_PAD(symbolbytes);
+    h.h_natoms = natom;
+    h.h_nobjects = nobjects;
+
+    /* the whole file in one block, so the writer thread doesn't need anything else */
+    length = sizeof(h) + h.h_symbolbytes + BINPATCH_PAD((size_t)natom) + natom * sizeof(double) + nobjects * sizeof(uint32_t);
+    if (ok && (data = (unsigned char*)calloc(length, 1)))
+    {
+        c = data + sizeof(h);
+        for (i = 0; i < symbols.s_n; i++)
+        {
+            size_t len = strlen(ordered[i]->s_name) + 1;
+            memcpy(c, ordered[i]->s_name, len);
+            c += len;
+        }
+        c = data + sizeof(h) + h.h_symbolbytes;
+        memcpy(c, types, natom);
+        c += BINPATCH_PAD((size_t)natom);
+        memcpy(c, values, natom * sizeof(double));
+        c += natom * sizeof(double);
+        memcpy(c, objects, nobjects * sizeof(uint32_t));
+
+        h.h_checksum = binpatch_checksum(data + sizeof(h), length - sizeof(h));
+        memcpy(data, &h, sizeof(h));
+        binpatch_post(file, data, length);
+    }
+
+    freebytes(ordered, (symbols.s_n + 1) * sizeof(t_symbol*));
+    freebytes(symbols.s_table, symbols.s_size * sizeof(t_symbol*));
+    freebytes(symbols.s_index, symbols.s_size * sizeof(uint32_t));
+    freebytes(types, BINPATCH_PAD((size_t)natom) + 1);
+    freebytes(values, (natom + 1) * sizeof(double));
+    freebytes(objects, (natom + 1) * sizeof(uint32_t));
+}
+
+int libpd_binary_patch_read(t_binbuf* b, char const* path)
+{
+    char binfile[MAXPDSTRING];
+    int64_t mtime, size;
+
+    if (!binpatch_getpath(path, binfile) || !libpd_binary_patch_stat(path, -1, &mtime, &size))
+        return binbuf_read(b, (char*)path, "", 0);
+
+    if (binpatch_load(b, binfile, mtime, size))
+    {
+        pthread_mutex_lock(&binpatch_mutex);
+        binpatch_hits++;
+        pthread_mutex_unlock(&binpatch_mutex);
+
+        /* keeps it from being evicted */
+        binpatch_post(binfile, 0, 0);
+        return 0;
+    }
+
+    if (binbuf_read(b, (char*)path, "", 0))
+        return 1;
+
+    pthread_mutex_lock(&binpatch_mutex);
+    binpatch_misses++;
+    pthread_mutex_unlock(&binpatch_mutex);
+
+    binpatch_save(b, binfile, mtime, size);
+    return 0;
+}
+
+void libpd_binary_patch_invalidate(char const* path)
+{
+    char binfile[MAXPDSTRING];
+    if (binpatch_getpath(path, binfile))
+        remove(binfile);
+}
+void* libpd_binary_patch_open(char const* name, char const* dir)
+{
+    char path[MAXPDSTRING];
+    t_binbuf* b = binbuf_new();
+    t_pd *x = 0, *boundx, *bounda, *boundn;
+    int dspstate;
+
+    snprintf(path, MAXPDSTRING, "%s/%s", dir, name);
+
+    sys_lock();
+    pd_globallock();
+
+    if (libpd_binary_patch_read(b, path))
+    {
+        pd_error(0, "%s: can't open", path);
+        pd_globalunlock();
+        sys_unlock();
+        binbuf_free(b);
+        return 0;
+    }
+
+    /* same as glob_evalfile(), but evaluates the binbuf we already have */
+    dspstate = canvas_suspend_dsp();
+    boundx = s__X.s_thing;
+    bounda = gensym("#A")->s_thing;
+    boundn = s__N.s_thing;
+    s__X.s_thing = 0;
+
+    glob_setfilename(0, gensym(name), gensym(dir));
+    gensym("#A")->s_thing = 0;
+    s__N.s_thing = &pd_canvasmaker;
+    binbuf_eval(b, 0, 0, 0);
+    gensym("#A")->s_thing = bounda;
+    s__N.s_thing = boundn;
+    glob_setfilename(0, &s_, &s_);
+
+    /* pop the toplevel canvas, which is the last one left */
+    while ((x != s__X.s_thing) && s__X.s_thing)
+    {
+        x = s__X.s_thing;
+        vmess(x, gensym("pop"), "i", 1);
+    }
+    if (!sys_noloadbang)
+        pd_doloadbang();
+    canvas_resume_dsp(dspstate);
+    s__X.s_thing = boundx;
+
+    pd_globalunlock();
+    sys_unlock();
+
+    binbuf_free(b);
+    return x;
+}
+
+void libpd_binary_patch_get_stats(int* hits, int* misses, int* objects)
+{
+    pthread_mutex_lock(&binpatch_mutex);
+    *hits = binpatch_hits;
+    *misses = binpatch_misses;
+    *objects = binpatch_objects;
+    pthread_mutex_unlock(&binpatch_mutex);
+}
+
+void libpd_binary_patch_reset_stats(void)
+{
+    pthread_mutex_lock(&binpatch_mutex);
+    binpatch_hits = binpatch_misses = binpatch_objects = 0;
+    pthread_mutex_unlock(&binpatch_mutex);
+}
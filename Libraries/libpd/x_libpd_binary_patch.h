@@ -0,0 +1,46 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+#include <stdint.h>
+
+// Sets the directory where precompiled patches are stored, null disables precompiling
+void libpd_binary_patch_setdir(char const* dir);
+
+// Patches inside this directory are never precompiled, meant for temporary folders
+void libpd_binary_patch_exclude(char const* dir);
+
+// Gets the modification stamp and size of a file, through fd if it's not negative, otherwise through path
+// The stamp has the best resolution the file system offers, so rewriting a file within the same second still changes it
+int libpd_binary_patch_stat(char const* path, int fd, int64_t* mtime, int64_t* size);
+
+// Reads a patch file into a binbuf from its precompiled form, if that is still up to date with the file
+// Otherwise parses the file as text and regenerates the precompiled form. Returns nonzero on failure, like binbuf_read()
+int libpd_binary_patch_read(t_binbuf* b, char const* path);
+
+// Waits until all precompiled files that are being written in the background are written
+void libpd_binary_patch_flush(void);
+
+// Removes the precompiled form of a patch, for when it may have changed without its stamp changing
+void libpd_binary_patch_invalidate(char const* path);
+
+// Same as libpd_openfile(), but reads the patch with libpd_binary_patch_read()
+void* libpd_binary_patch_open(char const* name, char const* dir);
+
+// Counters for benchmarking: files read from their precompiled form, files that had to be parsed, and objects read
+void libpd_binary_patch_get_stats(int* hits, int* misses, int* objects);
+void libpd_binary_patch_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -14,6 +14,7 @@
 #include <m_imp.h>
 #include <g_all_guis.h>
 #include "x_libpd_multi.h"
+#include "x_libpd_binary_patch.h"
 
 // False GARRAY
 typedef struct _fake_garray {
@@ -32,7 +33,7 @@ typedef struct _fake_garray {
 
 void* libpd_create_canvas(char const* name, char const* path)
 {
-    t_canvas* cnv = (t_canvas*)libpd_openfile(name, path);
+    t_canvas* cnv = (t_canvas*)libpd_binary_patch_open(name, path);
     if (cnv) {
         canvas_vis(cnv, 1.f);
         canvas_rename(cnv, gensym(name), gensym(path));
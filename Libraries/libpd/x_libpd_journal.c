@@ -0,0 +1,172 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <m_pd.h>
+#include <g_canvas.h>
+
+#include <pthread.h>
+
+#include "x_libpd_journal.h"
+
+/* Every pd instance has a ring buffer with the most recent changes made through the libpd
+   editing functions. The GUI remembers up to which sequence number it has seen the journal,
+   and only needs to look at the patch again if events were dropped or a RESYNC was recorded.
+
+   Events are only added while holding the lock of the instance, so there is one producer at a
+   time. The producer publishes an event by advancing the head after writing it, and readers
+   check that the slot wasn't overwritten while they copied it. That way, neither side takes a
+   lock, which matters because pd can make edits from the audio thread. */
+
+#define JOURNAL_SIZE 4096
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define journal_load_acquire(p) ((unsigned int)_InterlockedOr((long volatile*)(p), 0))
+#define journal_store_release(p, v) _InterlockedExchange((long volatile*)(p), (long)(v))
+#define journal_load_pointer(p) _InterlockedCompareExchangePointer((void* volatile*)(p), 0, 0)
+#define journal_store_pointer(p, v) _InterlockedExchangePointer((void* volatile*)(p), (void*)(v))
+/* the interlocked functions are full barriers already */
+#define journal_fence() _ReadWriteBarrier()
+#else
+#define journal_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define journal_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define journal_load_pointer(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define journal_store_pointer(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define journal_fence() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+typedef struct _journal
+{
+    t_pdinstance* j_instance;
+    t_libpd_journal_event j_events[JOURNAL_SIZE];
+    unsigned int j_head;
+    int j_depth;
+    struct _journal* j_next;
+} t_journal;
+
+/* Journals are never freed, only handed to a new instance once their instance is gone.
+   That way the list can be walked without taking a lock. */
+static t_journal* journal_list;
+
+/* only serialises adding journals to the list, and claiming unused ones */
+static pthread_mutex_t journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static t_journal* journal_find(t_pdinstance* instance)
+{
+    t_journal* j;
+    for (j = journal_load_pointer(&journal_list); j; j = j->j_next)
+    {
+        if (journal_load_pointer(&j->j_instance) == instance)
+            return j;
+    }
+    return 0;
+}
+
+static t_journal* journal_get(void)
+{
+    t_journal* j = journal_find(pd_this);
+    if (j)
+        return j;
+
+    /* first use by this instance */
+    pthread_mutex_lock(&journal_mutex);
+    if (!(j = journal_find(pd_this)))
+    {
+        if ((j = journal_find(0)))
+            j->j_depth = 0;
+        else
+        {
+            j = (t_journal*)getbytes(sizeof(t_journal));
+            j->j_next = journal_list;
+            journal_store_pointer(&journal_list, j);
+        }
+        journal_store_pointer(&j->j_instance, pd_this);
+    }
+    pthread_mutex_unlock(&journal_mutex);
+
+    return j;
+}
+
+static void journal_push(t_libpd_journal_event const* e)
+{
+    t_journal* j = journal_get();
+    unsigned int head = j->j_head;
+    j->j_events[head % JOURNAL_SIZE] = *e;
+    journal_store_release(&j->j_head, head + 1);
+}
+
+unsigned int libpd_journal_head(void)
+{
+    return journal_load_acquire(&journal_get()->j_head);
+}
+
+int libpd_journal_get(unsigned int seq, t_libpd_journal_event* event)
+{
+    t_journal* j = journal_get();
+
+    /* unsigned arithmetic, so this also works when the sequence number wraps around */
+    if (journal_load_acquire(&j->j_head) - seq - 1 >= JOURNAL_SIZE)
+        return 0;
+
+    *event = j->j_events[seq % JOURNAL_SIZE];
+
+    /* the slot gets reused for event seq + JOURNAL_SIZE, which may have been written while we were copying */
+    journal_fence();
+    if (journal_load_acquire(&j->j_head) - seq >= JOURNAL_SIZE)
+        return 0;
+
+    return 1;
+}
+
+void libpd_journal_resync(t_canvas* cnv)
+{
+    if (!journal_get()->j_depth)
+        libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
+}
+
+void libpd_journal_begin(void)
+{
+    journal_get()->j_depth++;
+}
+
+void libpd_journal_end(void)
+{
+    journal_get()->j_depth--;
+}
+
+void libpd_journal_add(t_libpd_journal_type type, t_canvas* cnv, void* object, void* replacement)
+{
+    t_libpd_journal_event e = { type, cnv, object, replacement, 0, 0, 0, 0 };
+    journal_push(&e);
+}
+
+void libpd_journal_connection(t_libpd_journal_type type, t_canvas* cnv, t_outconnect* oc, t_object* src, int nout, t_object* sink, int nin)
+{
+    t_libpd_journal_event e = { type, cnv, oc, 0, src, nout, sink, nin };
+    journal_push(&e);
+}
+
+void libpd_journal_object_connections(t_libpd_journal_type type, t_canvas* cnv, t_object* obj)
+{
+    t_linetraverser t;
+    t_outconnect* oc;
+
+    linetraverser_start(&t, cnv);
+    while ((oc = linetraverser_next(&t)))
+    {
+        if (t.tr_ob == obj || t.tr_ob2 == obj)
+            libpd_journal_connection(type, cnv, oc, t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+    }
+}
+
+void libpd_journal_free(void)
+{
+    t_journal* j = journal_find(pd_this);
+
+    /* keep the journal around for the next instance, someone may still be walking the list */
+    if (j)
+        journal_store_pointer(&j->j_instance, 0);
+}
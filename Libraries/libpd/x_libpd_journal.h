@@ -0,0 +1,66 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+#include <g_canvas.h>
+
+typedef enum _libpd_journal_type
+{
+    LIBPD_JOURNAL_CREATE,
+    LIBPD_JOURNAL_DELETE,
+    LIBPD_JOURNAL_MOVE,
+    LIBPD_JOURNAL_CONNECT,
+    LIBPD_JOURNAL_DISCONNECT,
+    LIBPD_JOURNAL_RETEXT,
+    LIBPD_JOURNAL_RESYNC
+} t_libpd_journal_type;
+
+// One change to a canvas. For connections, "object" is the t_outconnect
+// For RETEXT, "replacement" is the object that took the place of "object", which may be the same object
+// RESYNC means the canvas changed in a way that isn't journaled, a null canvas means all canvases
+typedef struct _libpd_journal_event
+{
+    t_libpd_journal_type type;
+    t_canvas* canvas;
+    void* object;
+    void* replacement;
+    t_object* src;
+    int nout;
+    t_object* sink;
+    int nin;
+} t_libpd_journal_event;
+
+// Returns the sequence number that the next event will get
+unsigned int libpd_journal_head(void);
+
+// Copies the event with the given sequence number, returns 0 if it's not in the journal (anymore)
+int libpd_journal_get(unsigned int seq, t_libpd_journal_event* event);
+
+// Records that a canvas changed in a way that can't be described by the journal
+// Ignored while one of the journaled libpd functions is running, since those record their own changes
+void libpd_journal_resync(t_canvas* cnv);
+
+// Used by the journaled libpd functions
+void libpd_journal_begin(void);
+void libpd_journal_end(void);
+void libpd_journal_add(t_libpd_journal_type type, t_canvas* cnv, void* object, void* replacement);
+void libpd_journal_connection(t_libpd_journal_type type, t_canvas* cnv, t_outconnect* oc, t_object* src, int nout, t_object* sink, int nin);
+
+// Records all connections from or to an object
+void libpd_journal_object_connections(t_libpd_journal_type type, t_canvas* cnv, t_object* obj);
+
+// Frees the journal of the current pd instance
+void libpd_journal_free(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,121 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include <pthread.h>
+
+#include "x_libpd_lua_gc.h"
+
+/* pdlua runs lua on the audio thread. Left alone, lua's collector does its work whenever an allocation
+   pushes it over its debt, which can mean a large amount of marking and sweeping inside one tick.
+   pdlua.c is compiled with luaL_newstate defined to libpd_lua_newstate, so we get to configure the
+   state it creates: we push lua's own collector far back, and step it ourselves with whatever time is
+   left at the end of an audio block. The automatic collector stays as a safety net for when DSP is off. */
+
+/* lua starts its own cycle once memory grows this many percent over what was left after the last one */
+#define LUAGC_PAUSE 400
+
+/* we start a cycle once memory grows by a quarter, or by this many kilobytes when the heap is small */
+#define LUAGC_MINGROWTH 256
+
+static lua_State* luagc_state;
+static int luagc_incycle;
+static int luagc_lastkb;
+static int luagc_cycles;
+
+/* lua takes this lock whenever it touches a state, see x_libpd_onelua.c. It has to be recursive,
+   because we hold it around our own calls into lua */
+static pthread_mutex_t luagc_mutex;
+static pthread_once_t luagc_once = PTHREAD_ONCE_INIT;
+
+static void luagc_initmutex(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&luagc_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void libpd_lua_lock(void)
+{
+    pthread_once(&luagc_once, luagc_initmutex);
+    pthread_mutex_lock(&luagc_mutex);
+}
+
+void libpd_lua_unlock(void)
+{
+    pthread_mutex_unlock(&luagc_mutex);
+}
+
+static int luagc_trylock(void)
+{
+    pthread_once(&luagc_once, luagc_initmutex);
+    return !pthread_mutex_trylock(&luagc_mutex);
+}
+
+lua_State* libpd_lua_newstate(void)
+{
+    lua_State* L = luaL_newstate();
+    if (L)
+    {
+        lua_gc(L, LUA_GCINC, LUAGC_PAUSE, 0, 0);
+        luagc_state = L;
+        luagc_lastkb = lua_gc(L, LUA_GCCOUNT);
+    }
+    return L;
+}
+
+int libpd_lua_gc_active(void)
+{
+    return luagc_state != 0;
+}
+
+int libpd_lua_gc_step(void)
+{
+    lua_State* L = luagc_state;
+    int didwork = 0;
+
+    /* if another instance is running lua code, we'll try again next block rather than wait for it */
+    if (!L || !luagc_trylock())
+        return 0;
+
+    if (!luagc_incycle)
+    {
+        int kb = lua_gc(L, LUA_GCCOUNT);
+        luagc_incycle = kb >= luagc_lastkb + (luagc_lastkb / 4 > LUAGC_MINGROWTH ? luagc_lastkb / 4 : LUAGC_MINGROWTH);
+    }
+
+    if (luagc_incycle)
+    {
+        /* a step of size 0 does a single basic step, which is small enough to keep to a time budget */
+        if (lua_gc(L, LUA_GCSTEP, 0))
+        {
+            luagc_incycle = 0;
+            luagc_lastkb = lua_gc(L, LUA_GCCOUNT);
+            luagc_cycles++;
+        }
+        didwork = 1;
+    }
+
+    libpd_lua_unlock();
+    return didwork;
+}
+
+void libpd_lua_gc_get_stats(size_t* bytes, int* cycles)
+{
+    lua_State* L = luagc_state;
+    *bytes = 0;
+
+    libpd_lua_lock();
+    if (L)
+        *bytes = (size_t)lua_gc(L, LUA_GCCOUNT) * 1024 + lua_gc(L, LUA_GCCOUNTB);
+    *cycles = luagc_cycles;
+    libpd_lua_unlock();
+}
+
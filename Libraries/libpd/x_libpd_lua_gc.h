@@ -0,0 +1,33 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+// Returns whether pdlua has created its lua state, and its collector is waiting for us to step it
+int libpd_lua_gc_active(void);
+
+// Does a single incremental step of lua's garbage collector
+// Returns 0 if there was nothing worth collecting, or if another thread is running lua code,
+// so the caller can stop stepping for this block
+int libpd_lua_gc_step(void);
+
+// Returns how many bytes lua currently has allocated, and how many collection cycles we completed
+// Waits for the lua lock, so don't call this from an audio thread
+void libpd_lua_gc_get_stats(size_t* bytes, int* cycles);
+
+// Process-wide lock around pdlua's lua state, which lua takes on every call into it
+void libpd_lua_lock(void);
+void libpd_lua_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,11 +12,25 @@
 
 
 #include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <s_utf8.h>
+#else
+#include <unistd.h>
+#endif
 
 #include <stdlib.h>
 #include <string.h>
 #include "x_libpd_mod_utils.h"
 #include "x_libpd_extra_utils.h"
+#include "x_libpd_journal.h"
+#include "x_libpd_path_cache.h"
+#include "x_libpd_array_sidecar.h"
+#include "x_libpd_undo_budget.h"
 
 struct _instanceeditor
 {
@@ -82,6 +96,7 @@ void libpd_moveselection(t_canvas* cnv, int dx, int dy)
 
         t_class* cl = pd_class(&y->sel_what->g_pd);
         gobj_displace(y->sel_what, cnv, dx, dy);
+        libpd_journal_add(LIBPD_JOURNAL_MOVE, cnv, y->sel_what, 0);
         if (cl == vinlet_class)
             resortin = 1;
         else if (cl == voutlet_class)
@@ -95,6 +110,8 @@ void libpd_moveselection(t_canvas* cnv, int dx, int dy)
 
     if (cnv->gl_editor->e_selection)
         canvas_dirty(cnv, 1);
+
+    libpd_undo_budget_apply(cnv);
 }
 
 t_pd* libpd_newest(t_canvas* cnv)
@@ -113,6 +130,36 @@ t_pd* libpd_newest(t_canvas* cnv)
     return 0;
 }
 
+/* journal everything after "last", which was added by a paste or duplicate */
+static void libpd_journal_added(t_canvas* cnv, t_gobj* last)
+{
+    t_gobj* y;
+    int i;
+
+    for (y = last ? last->g_next : cnv->gl_list; y; y = y->g_next)
+        libpd_journal_add(LIBPD_JOURNAL_CREATE, cnv, y, 0);
+
+    /* pasted connections are always between pasted objects, so we only need to look at their outlets */
+    for (y = last ? last->g_next : cnv->gl_list; y; y = y->g_next) {
+        t_object* ob = pd_checkobject(&y->g_pd);
+        if (!ob)
+            continue;
+
+        for (i = 0; i < obj_noutlets(ob); i++) {
+            t_outlet* out;
+            t_outconnect* oc = obj_starttraverseoutlet(ob, &out, i);
+            while (oc) {
+                t_object* sink;
+                t_inlet* in;
+                int nin;
+                t_outconnect* next = obj_nexttraverseoutlet(oc, &sink, &in, &nin);
+                libpd_journal_connection(LIBPD_JOURNAL_CONNECT, cnv, oc, ob, i, sink, nin);
+                oc = next;
+            }
+        }
+    }
+}
+
 static void libpd_canvas_doclear(t_canvas* cnv)
 {
 
@@ -120,11 +167,15 @@ static void libpd_canvas_doclear(t_canvas* cnv)
     int dspstate;
 
     dspstate = canvas_suspend_dsp();
+    libpd_journal_begin();
 
     /* if text is selected, deselecting it might remake the
      object. So we deselect it and hunt for a "new" object on
      the glist to reselect. */
     if (cnv->gl_editor->e_textedfor) {
+        // Deselecting may recreate the object, which we can't journal
+        libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
+
         // t_gobj *selwas = x->gl_editor->e_selection->sel_what;
         pd_this->pd_newest = 0;
         glist_noselect(cnv);
@@ -134,11 +185,24 @@ static void libpd_canvas_doclear(t_canvas* cnv)
                     glist_select(cnv, y);
         }
     }
+
+    // Deleting objects also deletes their connections
+    {
+        t_linetraverser t;
+        t_outconnect* oc;
+        linetraverser_start(&t, cnv);
+        while ((oc = linetraverser_next(&t))) {
+            if (glist_isselected(cnv, &t.tr_ob->ob_g) || glist_isselected(cnv, &t.tr_ob2->ob_g))
+                libpd_journal_connection(LIBPD_JOURNAL_DISCONNECT, cnv, oc, t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+        }
+    }
+
     while (1) /* this is pretty weird...  should rewrite it */
     {
         for (y = cnv->gl_list; y; y = y2) {
             y2 = y->g_next;
             if (glist_isselected(cnv, y)) {
+                libpd_journal_add(LIBPD_JOURNAL_DELETE, cnv, y, 0);
                 glist_delete(cnv, y);
                 goto next;
             }
@@ -147,6 +211,7 @@ static void libpd_canvas_doclear(t_canvas* cnv)
     next:;
     }
 restore:
+    libpd_journal_end();
     canvas_resume_dsp(dspstate);
     canvas_dirty(cnv, 1);
 }
@@ -154,6 +219,7 @@ restore:
 void libpd_finishremove(t_canvas* cnv)
 {
     canvas_undo_add(cnv, UNDO_SEQUENCE_END, "clear", 0);
+    libpd_undo_budget_apply(cnv);
 }
 void libpd_removeselection(t_canvas* cnv)
 {
@@ -176,6 +242,7 @@ void libpd_start_undo_sequence(t_canvas* cnv, char const* name)
 void libpd_end_undo_sequence(t_canvas* cnv, char const* name)
 {
     canvas_undo_add(cnv, UNDO_SEQUENCE_END, name, 0);
+    libpd_undo_budget_apply(cnv);
 }
 
 static int binbuf_nextmess(int argc, t_atom const* argv)
@@ -211,6 +278,7 @@ void* libpd_setconnectionpath(t_canvas* cnv, t_object* src, int nout, t_object*
     
     t_outconnect* oc = obj_connect(src, nout, sink, nin);
     if (oc) {
+        libpd_journal_connection(LIBPD_JOURNAL_CONNECT, cnv, oc, src, nout, sink, nin);
         outconnect_set_path_data(oc, new_connection_path);
         
         canvas_undo_add(cnv, UNDO_CONNECT, "connect", canvas_undo_set_connect(cnv, canvas_getindex(cnv, &src->ob_g), nout, canvas_getindex(cnv, &sink->ob_g), nin, new_connection_path));
@@ -227,7 +295,7 @@ void* libpd_tryconnect(t_canvas* cnv, t_object* src, int nout, t_object* sink, i
     if (libpd_canconnect(cnv, src, nout, sink, nin)) {
         t_outconnect* oc = obj_connect(src, nout, sink, nin);
         if (oc) {
-            
+            libpd_journal_connection(LIBPD_JOURNAL_CONNECT, cnv, oc, src, nout, sink, nin);
             canvas_undo_add(cnv, UNDO_CONNECT, "connect", canvas_undo_set_connect(cnv, canvas_getindex(cnv, &src->ob_g), nout, canvas_getindex(cnv, &sink->ob_g), nin, gensym("empty")));
             
             canvas_dirty(cnv, 1);
@@ -336,19 +404,28 @@ void libpd_paste(t_canvas* cnv, char const* buf)
     binbuf_text(pd_this->pd_gui->i_editor->copy_binbuf, buf, len);
     
     sys_lock();
+    libpd_journal_begin();
+    t_gobj* last = (t_gobj*)libpd_newest(cnv);
     canvas_setcurrent(cnv);
     pd_typedmess((t_pd*)cnv, gensym("paste"), 0, NULL);
     canvas_unsetcurrent(cnv);
+    libpd_journal_added(cnv, last);
+    libpd_journal_end();
+
+    libpd_undo_budget_apply(cnv);
     sys_unlock();
 }
 
 void libpd_undo(t_canvas* cnv)
 {
     sys_lock();
+    libpd_journal_begin();
     canvas_setcurrent(cnv);
     pd_typedmess((t_pd*)cnv, gensym("undo"), 0, NULL);
     glist_noselect(cnv);
     canvas_unsetcurrent(cnv);
+    libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
+    libpd_journal_end();
     sys_unlock();
 }
 
@@ -360,10 +437,13 @@ void libpd_redo(t_canvas* cnv)
         return;
     
     sys_lock();
+    libpd_journal_begin();
     canvas_setcurrent(cnv);
     pd_typedmess((t_pd*)cnv, gensym("redo"), 0, NULL);
     glist_noselect(cnv);
     canvas_unsetcurrent(cnv);
+    libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
+    libpd_journal_end();
     sys_unlock();
 }
 
@@ -510,45 +590,94 @@ static void libpd_arrange(t_canvas* cnv, t_gobj* obj, int to_front)
 void libpd_tofront(t_canvas* cnv, t_gobj* obj)
 {
     libpd_arrange(cnv, obj, 1);
+    libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
 }
 
 void libpd_move_forward(t_canvas* cnv, t_gobj* obj)
 {
     libpd_arrange_single_step(cnv, obj, 1);
+    libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
 }
 
 void libpd_move_backward(t_canvas* cnv, t_gobj* obj)
 {
     libpd_arrange_single_step(cnv, obj, 0);
+    libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
 }
 
 void libpd_toback(t_canvas* cnv, t_gobj* obj)
 {
     libpd_arrange(cnv, obj, 0);
+    libpd_journal_add(LIBPD_JOURNAL_RESYNC, cnv, 0, 0);
 }
 
 void libpd_duplicate(t_canvas* cnv)
 {
     sys_lock();
+    libpd_journal_begin();
+    t_gobj* last = (t_gobj*)libpd_newest(cnv);
     canvas_setcurrent(cnv);
     pd_typedmess((t_pd*)cnv, gensym("duplicate"), 0, NULL);
     canvas_unsetcurrent(cnv);
+    libpd_journal_added(cnv, last);
+    libpd_journal_end();
+
+    libpd_undo_budget_apply(cnv);
     sys_unlock();
 }
 
 /* save a "root" canvas to a file; cf. canvas_saveto() which saves the
  body (and which is called recursively.) */
+/* flush a file to disk and move it over the target, so that the target will
+   always contain either the old or the new file, never a partially written one */
+int libpd_commitfile(char const* from, char const* to)
+{
+    int fd = sys_open(from, O_RDWR);
+    if (fd < 0)
+        return 0;
+#ifdef _WIN32
+    _commit(fd);
+#else
+    fsync(fd);
+#endif
+    sys_close(fd);
+
+#ifdef _WIN32
+    wchar_t ucs2from[MAXPDSTRING], ucs2to[MAXPDSTRING];
+    u8_utf8toucs2(ucs2from, MAXPDSTRING, from, MAXPDSTRING - 1);
+    u8_utf8toucs2(ucs2to, MAXPDSTRING, to, MAXPDSTRING - 1);
+    return MoveFileExW(ucs2from, ucs2to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
 void libpd_savetofile(t_canvas* cnv, t_symbol* filename, t_symbol* dir)
 {
+    char tmpname[MAXPDSTRING], tmppath[MAXPDSTRING], path[MAXPDSTRING];
     t_binbuf *b = binbuf_new();
+    t_libpd_sidecars* sidecars;
     canvas_savetemplatesto(cnv, b, 1);
     canvas_saveto(cnv, b);
+    sidecars = libpd_array_sidecar_prepare(b, filename, dir);
+
+    /* write to a hidden file next to the target first, then swap it in */
+    snprintf(tmpname, MAXPDSTRING, ".%s.tmp", filename->s_name);
+    snprintf(tmppath, MAXPDSTRING, "%s/%s", dir->s_name, tmpname);
+    snprintf(path, MAXPDSTRING, "%s/%s", dir->s_name, filename->s_name);
+
     errno = 0;
-    if (binbuf_write(b, filename->s_name, dir->s_name, 0))
+    if (binbuf_write(b, tmpname, dir->s_name, 0) || !libpd_commitfile(tmppath, path))
+    {
         post("%s/%s: %s", dir->s_name, filename->s_name,
             (errno ? strerror(errno) : "write failed"));
+        remove(tmppath);
+        libpd_array_sidecar_free(sidecars);
+    }
     else
     {
+        libpd_array_sidecar_commit(sidecars, dir);
+
             /* if not an abstraction, reset title bar and directory */
         if (!cnv->gl_owner)
         {
@@ -558,6 +687,9 @@ void libpd_savetofile(t_canvas* cnv, t_symbol* filename, t_symbol* dir)
         }
         post("saved to: %s/%s", dir->s_name, filename->s_name);
         canvas_dirty(cnv, 0);
+
+        /* the file watcher may not have noticed the new file yet */
+        libpd_path_cache_invalidate();
     }
     binbuf_free(b);
 }
@@ -592,15 +724,18 @@ t_pd* libpd_creategraphonparent(t_canvas* cnv, int x, int y)
     SETFLOAT(argv + 8, py2);
 
     sys_lock();
+    libpd_journal_begin();
     canvas_setcurrent(cnv);
     pd_typedmess((t_pd*)cnv, gensym("graph"), argc, argv);
     pd_popsym(s__X.s_thing);
     canvas_unsetcurrent(cnv);
+    libpd_journal_end();
     sys_unlock();
 
     glist_noselect(cnv);
 
     t_pd* result = libpd_newest(cnv);
+    libpd_journal_add(LIBPD_JOURNAL_CREATE, cnv, result, 0);
     ((t_glist*)result)->gl_hidetext = 1;
     ((t_glist*)result)->gl_loading = 0;
 
@@ -620,14 +755,17 @@ t_pd* libpd_creategraph(t_canvas* cnv, char const* name, int size, int x, int y,
     SETFLOAT(argv + 3, 0);
     
     sys_lock();
+    libpd_journal_begin();
     canvas_setcurrent(cnv);
     pd_typedmess((t_pd*)cnv, gensym("arraydialog"), 4, argv);
     canvas_unsetcurrent(cnv);
+    libpd_journal_end();
     sys_unlock();
 
     glist_noselect(cnv);
 
     t_pd* arr = libpd_newest(cnv);
+    libpd_journal_add(LIBPD_JOURNAL_CREATE, cnv, arr, 0);
 
     libpd_moveobj(cnv, pd_checkobject(arr), x, y);
     
@@ -643,13 +781,17 @@ t_pd* libpd_creategraph(t_canvas* cnv, char const* name, int size, int x, int y,
 t_pd* libpd_createobj(t_canvas* cnv, t_symbol* s, int argc, t_atom* argv)
 {
     sys_lock();
+    libpd_journal_begin();
     canvas_setcurrent(cnv);
     pd_typedmess((t_pd*)cnv, s, argc, argv);
     
     canvas_undo_add(cnv, UNDO_CREATE, "create",
         (void*)canvas_undo_set_create(cnv));
+    libpd_undo_budget_apply(cnv);
     
     t_pd* new_object = libpd_newest(cnv);
+    libpd_journal_add(LIBPD_JOURNAL_CREATE, cnv, new_object, 0);
+    libpd_journal_end();
 
     if (new_object) {
         if (pd_class(new_object) == canvas_class)
@@ -698,6 +840,11 @@ void libpd_renameobj(t_canvas* cnv, t_gobj* obj, char const* buf, size_t bufsize
     };
     
     sys_lock();
+    libpd_journal_begin();
+
+    // Renaming may recreate the object, and its connections with it
+    libpd_journal_object_connections(LIBPD_JOURNAL_DISCONNECT, cnv, pd_checkobject(&obj->g_pd));
+
     canvas_editmode(cnv, 1);
 
     glist_noselect(cnv);
@@ -719,8 +866,23 @@ void libpd_renameobj(t_canvas* cnv, t_gobj* obj, char const* buf, size_t bufsize
     cnv->gl_editor->e_textdirty = 0;
 
     canvas_editmode(cnv, 0);
-    
+
+    // If the object was recreated, the new one has been added to the end
+    t_gobj *replacement = (t_gobj*)libpd_newest(cnv), *y;
+    for (y = cnv->gl_list; y; y = y->g_next) {
+        if (y == obj) {
+            replacement = obj;
+            break;
+        }
+    }
+
+    libpd_journal_add(LIBPD_JOURNAL_RETEXT, cnv, obj, replacement);
+    if (replacement)
+        libpd_journal_object_connections(LIBPD_JOURNAL_CONNECT, cnv, pd_checkobject(&replacement->g_pd));
+
     canvas_dirty(cnv, 1);
+    libpd_journal_end();
+    libpd_undo_budget_apply(cnv);
     sys_unlock();
 }
 
@@ -753,6 +915,7 @@ void libpd_undo_apply(t_canvas* cnv, t_gobj* obj)
 {
     canvas_undo_add(cnv, UNDO_APPLY, "props",
         canvas_undo_set_apply(cnv, glist_getindex(cnv, obj)));
+    libpd_undo_budget_apply(cnv);
 }
 
 void libpd_moveobj(t_canvas* cnv, t_gobj* obj, int x, int y)
@@ -764,6 +927,7 @@ void libpd_moveobj(t_canvas* cnv, t_gobj* obj, int x, int y)
         (*obj->g_pd->c_wb->w_getrectfn)(obj, cnv, &x1, &y1, &x2, &y2);
 
         (*obj->g_pd->c_wb->w_displacefn)(obj, cnv, x - x1, y - y1);
+        libpd_journal_add(LIBPD_JOURNAL_MOVE, cnv, obj, 0);
     }
 }
 
@@ -771,6 +935,7 @@ void* libpd_createconnection(t_canvas* cnv, t_object* src, int nout, t_object* s
 {
     void* oc = libpd_tryconnect(cnv, src, nout, sink, nin);
     glist_noselect(cnv);
+    libpd_undo_budget_apply(cnv);
     return oc;
 }
 
@@ -787,6 +952,20 @@ void libpd_removeconnection(t_canvas* cnv, t_object* src, int nout, t_object* si
         return;
     }
 
+    {
+        t_outlet* out;
+        t_outconnect* oc = obj_starttraverseoutlet(src, &out, nout);
+        while (oc) {
+            t_object* dest;
+            t_inlet* in;
+            int which;
+            t_outconnect* next = obj_nexttraverseoutlet(oc, &dest, &in, &which);
+            if (dest == sink && which == nin)
+                libpd_journal_connection(LIBPD_JOURNAL_DISCONNECT, cnv, oc, src, nout, sink, nin);
+            oc = next;
+        }
+    }
+
     obj_disconnect(src, nout, sink, nin);
 
     int dest_i = canvas_getindex(cnv, &(sink->te_g));
@@ -796,6 +975,7 @@ void libpd_removeconnection(t_canvas* cnv, t_object* src, int nout, t_object* si
     glist_noselect(cnv);
     
     canvas_dirty(cnv, 1);
+    libpd_undo_budget_apply(cnv);
 }
 
 void libpd_getcontent(t_canvas* cnv, char** buf, int* bufsize)
@@ -954,3 +1134,677 @@ void* libpd_get_class_methods(t_class* o) {
     return o->c_methods;
 #endif
 }
+
+/* ------------------- incremental abstraction reload ------------------- */
+
+/* Instead of recreating every instance of an abstraction when its file changes, compare
+   each instance against the new file content and only apply the difference: objects that
+   weren't touched keep their state, and the work scales with the size of the edit. When
+   the edit can't be applied like this (subpatches, arrays, changed iolets, etc.) we return
+   0 and the caller falls back to canvas_reload(). */
+
+t_glist* clone_get_instance(t_gobj*, int);
+int clone_get_n(t_gobj*);
+
+typedef struct _reload_msg
+{
+    int m_onset; /* first atom of the message */
+    int m_n;     /* number of atoms, without the semicolon */
+} t_reload_msg;
+
+typedef struct _reload_content
+{
+    t_binbuf* c_binbuf;
+    t_reload_msg* c_objects; /* messages that create one gobj each */
+    int c_nobjects;
+    t_reload_msg* c_connections;
+    int c_nconnections;
+    t_reload_msg c_coords;
+} t_reload_content;
+
+#define RELOAD_MAXDIFF (2048 * 2048)
+
+static void reload_content_free(t_reload_content* c)
+{
+    freebytes(c->c_objects, (c->c_nobjects + 1) * sizeof(t_reload_msg));
+    freebytes(c->c_connections, (c->c_nconnections + 1) * sizeof(t_reload_msg));
+    c->c_objects = c->c_connections = 0;
+}
+
+/* pd writes the templates a patch uses in front of its "#N canvas" line, returns the onset of the
+   first message after them */
+static int reload_skipstructs(t_atom const* vec, int natom)
+{
+    int i, onset = 0;
+    while (onset + 1 < natom && vec[onset].a_type == A_SYMBOL && vec[onset].a_w.w_symbol == gensym("#N")
+        && vec[onset + 1].a_type == A_SYMBOL && vec[onset + 1].a_w.w_symbol == gensym("struct"))
+    {
+        for (i = onset; i < natom && vec[i].a_type != A_SEMI; i++)
+            ;
+        onset = i + 1;
+    }
+    return onset;
+}
+
+/* creates or conforms the templates in front of the content, the same way loading the file does */
+static void reload_evalstructs(t_binbuf* b)
+{
+    int n = reload_skipstructs(binbuf_getvec(b), binbuf_getnatom(b));
+    t_pd* boundn = s__N.s_thing;
+    t_binbuf* structs;
+
+    if (!n)
+        return;
+
+    structs = binbuf_new();
+    binbuf_add(structs, n, binbuf_getvec(b));
+    s__N.s_thing = &pd_canvasmaker;
+    binbuf_eval(structs, 0, 0, 0);
+    s__N.s_thing = boundn;
+    binbuf_free(structs);
+}
+
+/* split content into object and connection messages, returns 0 if it contains anything we can't patch */
+static int reload_content_parse(t_reload_content* c, t_binbuf* b)
+{
+    int natom = binbuf_getnatom(b), i, start, header = 1;
+    t_atom* vec = binbuf_getvec(b);
+
+    c->c_binbuf = b;
+    c->c_nobjects = c->c_nconnections = 0;
+    c->c_objects = (t_reload_msg*)getbytes(sizeof(t_reload_msg));
+    c->c_connections = (t_reload_msg*)getbytes(sizeof(t_reload_msg));
+    c->c_coords.m_onset = c->c_coords.m_n = 0;
+
+    /* templates are created before anything else, see reload_evalstructs() */
+    for (i = start = reload_skipstructs(vec, natom); i < natom; i++)
+    {
+        t_symbol *type, *sel;
+        t_reload_msg msg;
+        if (vec[i].a_type != A_SEMI)
+            continue;
+
+        msg.m_onset = start;
+        msg.m_n = i - start;
+        start = i + 1;
+
+        if (msg.m_n < 2 || vec[msg.m_onset].a_type != A_SYMBOL || vec[msg.m_onset + 1].a_type != A_SYMBOL)
+            return 0;
+
+        type = vec[msg.m_onset].a_w.w_symbol;
+        sel = vec[msg.m_onset + 1].a_w.w_symbol;
+
+        /* the first "#N canvas" line is the abstraction itself, any other one is a subpatch */
+        if (header && type == gensym("#N") && sel == gensym("canvas"))
+        {
+            header = 0;
+            continue;
+        }
+        if (header || type != gensym("#X"))
+            return 0;
+
+        if (sel == gensym("obj") || sel == gensym("msg") || sel == gensym("text")
+            || sel == gensym("floatatom") || sel == gensym("symbolatom") || sel == gensym("listbox"))
+        {
+            if (msg.m_n < 4 || vec[msg.m_onset + 2].a_type != A_FLOAT || vec[msg.m_onset + 3].a_type != A_FLOAT)
+                return 0;
+            c->c_objects = (t_reload_msg*)resizebytes(c->c_objects,
+                (c->c_nobjects + 1) * sizeof(t_reload_msg), (c->c_nobjects + 2) * sizeof(t_reload_msg));
+            c->c_objects[c->c_nobjects++] = msg;
+        }
+        else if (sel == gensym("f") && c->c_nobjects && c->c_objects[c->c_nobjects - 1].m_onset + c->c_objects[c->c_nobjects - 1].m_n + 1 == msg.m_onset)
+        {
+            /* object width, belongs to the object before it */
+            c->c_objects[c->c_nobjects - 1].m_n += msg.m_n + 1;
+        }
+        else if (sel == gensym("connect") && msg.m_n == 6)
+        {
+            c->c_connections = (t_reload_msg*)resizebytes(c->c_connections,
+                (c->c_nconnections + 1) * sizeof(t_reload_msg), (c->c_nconnections + 2) * sizeof(t_reload_msg));
+            c->c_connections[c->c_nconnections++] = msg;
+        }
+        else if (sel == gensym("coords"))
+            c->c_coords = msg;
+        else
+            return 0;
+    }
+    return 1;
+}
+
+static int reload_atoms_equal(t_atom const* a, t_atom const* b, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        if (a[i].a_type != b[i].a_type)
+            return 0;
+        if (a[i].a_type == A_FLOAT && a[i].a_w.w_float != b[i].a_w.w_float)
+            return 0;
+        if (a[i].a_type == A_SYMBOL && a[i].a_w.w_symbol != b[i].a_w.w_symbol)
+            return 0;
+        if (a[i].a_type == A_DOLLAR && a[i].a_w.w_index != b[i].a_w.w_index)
+            return 0;
+    }
+    return 1;
+}
+
+/* compares two object messages, ignoring their position */
+static int reload_objects_equal(t_reload_content* a, int i, t_reload_content* b, int j)
+{
+    t_reload_msg ma = a->c_objects[i], mb = b->c_objects[j];
+    t_atom *va = binbuf_getvec(a->c_binbuf) + ma.m_onset, *vb = binbuf_getvec(b->c_binbuf) + mb.m_onset;
+    return ma.m_n == mb.m_n && reload_atoms_equal(va, vb, 2)
+        && reload_atoms_equal(va + 4, vb + 4, ma.m_n - 4);
+}
+
+static int reload_msgs_equal(t_reload_content* a, t_reload_msg ma, t_reload_content* b, t_reload_msg mb)
+{
+    return ma.m_n == mb.m_n && reload_atoms_equal(binbuf_getvec(a->c_binbuf) + ma.m_onset,
+        binbuf_getvec(b->c_binbuf) + mb.m_onset, ma.m_n);
+}
+
+static int reload_isiolet(t_reload_content* c, int i)
+{
+    t_reload_msg m = c->c_objects[i];
+    t_atom* v = binbuf_getvec(c->c_binbuf) + m.m_onset;
+    t_symbol* s;
+    if (m.m_n < 5 || v[1].a_w.w_symbol != gensym("obj") || v[4].a_type != A_SYMBOL)
+        return 0;
+    s = v[4].a_w.w_symbol;
+    return s == gensym("inlet") || s == gensym("inlet~") || s == gensym("outlet") || s == gensym("outlet~");
+}
+
+/* match old objects to new ones with a longest common subsequence, after trimming the common
+   prefix and suffix. match[i] gets the index of the new object for old object i, or -1 */
+static int reload_match(t_reload_content* o, t_reload_content* n, int* match)
+{
+    int no = o->c_nobjects, nn = n->c_nobjects, pre = 0, suf = 0, i, j, w, h;
+    int* table;
+
+    for (i = 0; i < no; i++)
+        match[i] = -1;
+
+    while (pre < no && pre < nn && reload_objects_equal(o, pre, n, pre))
+        match[pre] = pre, pre++;
+    while (suf < no - pre && suf < nn - pre && reload_objects_equal(o, no - 1 - suf, n, nn - 1 - suf))
+        match[no - 1 - suf] = nn - 1 - suf, suf++;
+
+    w = nn - pre - suf + 1;
+    h = no - pre - suf + 1;
+    if ((double)w * h > RELOAD_MAXDIFF)
+        return 0;
+
+    table = (int*)getbytes(w * h * sizeof(int));
+    for (i = h - 2; i >= 0; i--)
+        for (j = w - 2; j >= 0; j--)
+            table[i * w + j] = reload_objects_equal(o, pre + i, n, pre + j)
+                ? table[(i + 1) * w + j + 1] + 1
+                : (table[(i + 1) * w + j] > table[i * w + j + 1] ? table[(i + 1) * w + j] : table[i * w + j + 1]);
+
+    for (i = 0, j = 0; i < h - 1 && j < w - 1;)
+    {
+        if (reload_objects_equal(o, pre + i, n, pre + j))
+            match[pre + i] = pre + j, i++, j++;
+        else if (table[(i + 1) * w + j] >= table[i * w + j + 1])
+            i++;
+        else
+            j++;
+    }
+    freebytes(table, w * h * sizeof(int));
+    return 1;
+}
+
+static t_object* reload_connection_object(t_reload_content* c, int i, int which, t_gobj** objects, int* port)
+{
+    t_atom* v = binbuf_getvec(c->c_binbuf) + c->c_connections[i].m_onset + 2 + which * 2;
+    int index = (int)atom_getfloat(v);
+    *port = (int)atom_getfloat(v + 1);
+    if (index < 0 || index >= c->c_nobjects || !objects[index])
+        return 0;
+    return pd_checkobject(&objects[index]->g_pd);
+}
+
+static int reload_has_connection(t_reload_content* c, t_gobj** objects, t_object* src, int outno, t_object* sink, int inno)
+{
+    int i, o, n;
+    for (i = 0; i < c->c_nconnections; i++)
+    {
+        if (reload_connection_object(c, i, 0, objects, &o) == src && o == outno
+            && reload_connection_object(c, i, 1, objects, &n) == sink && n == inno)
+            return 1;
+    }
+    return 0;
+}
+
+/* works out the changes for one instance, returns 0 if this instance needs a full reload */
+static int reload_instance_check(t_canvas* x, t_reload_content* n, t_reload_content* o, int** match)
+{
+    t_binbuf* b = binbuf_new();
+    t_gobj* y;
+    int i, count = 0;
+
+    canvas_saveto(x, b);
+    if (!reload_content_parse(o, b))
+        return 0;
+
+    /* every object message must correspond to exactly one gobj */
+    for (y = x->gl_list; y; y = y->g_next)
+        count++;
+    if (count != o->c_nobjects)
+        return 0;
+
+    if (!reload_msgs_equal(o, o->c_coords, n, n->c_coords))
+        return 0;
+
+    *match = (int*)getbytes((o->c_nobjects + 1) * sizeof(int));
+    if (!reload_match(o, n, *match))
+        return 0;
+
+    /* adding, removing or moving iolets changes the instance's own iolets, we can't patch that */
+    for (i = 0; i < o->c_nobjects; i++)
+    {
+        if (!reload_isiolet(o, i))
+            continue;
+        if ((*match)[i] < 0 || !reload_msgs_equal(o, o->c_objects[i], n, n->c_objects[(*match)[i]]))
+            return 0;
+        count--;
+    }
+    for (i = 0; i < n->c_nobjects; i++)
+        count += reload_isiolet(n, i);
+
+    /* all old iolets were matched, so every new one was too if there are as many as before */
+    return count == o->c_nobjects;
+}
+
+static void reload_instance_apply(t_canvas* x, t_reload_content* n, t_reload_content* o, int* match)
+{
+    t_gobj **oldobjects, **newobjects, *y, *last;
+    t_atom* nvec = binbuf_getvec(n->c_binbuf);
+    t_pd* boundx = s__X.s_thing;
+    int i, j, outno, inno, count;
+
+    oldobjects = (t_gobj**)getbytes((o->c_nobjects + 1) * sizeof(t_gobj*));
+    newobjects = (t_gobj**)getbytes((n->c_nobjects + 1) * sizeof(t_gobj*));
+
+    for (y = x->gl_list, i = 0; y; y = y->g_next, i++)
+        oldobjects[i] = y;
+
+    /* keep matched objects, and move them if their position changed */
+    for (i = 0; i < o->c_nobjects; i++)
+    {
+        t_object* ob;
+        if ((j = match[i]) < 0)
+            continue;
+        newobjects[j] = oldobjects[i];
+        if ((ob = pd_checkobject(&oldobjects[i]->g_pd)))
+        {
+            ob->te_xpix = (int)atom_getfloat(nvec + n->c_objects[j].m_onset + 2);
+            ob->te_ypix = (int)atom_getfloat(nvec + n->c_objects[j].m_onset + 3);
+        }
+    }
+
+    /* removing an object also removes its connections */
+    for (i = 0; i < o->c_nobjects; i++)
+    {
+        if (match[i] < 0)
+        {
+            glist_delete(x, oldobjects[i]);
+            oldobjects[i] = 0;
+        }
+    }
+
+    /* create new objects by evaluating their message, just like when the file gets loaded */
+    for (last = x->gl_list; last && last->g_next; last = last->g_next)
+        ;
+    for (j = 0; j < n->c_nobjects; j++)
+    {
+        t_binbuf* msg;
+        if (newobjects[j])
+            continue;
+
+        msg = binbuf_new();
+        binbuf_add(msg, n->c_objects[j].m_n + 1, nvec + n->c_objects[j].m_onset);
+        s__X.s_thing = &x->gl_pd;
+        binbuf_eval(msg, 0, 0, 0);
+        binbuf_free(msg);
+
+        /* new objects are appended to the canvas */
+        y = last ? last->g_next : x->gl_list;
+        if (y)
+        {
+            for (last = y; last->g_next; last = last->g_next)
+                ;
+            newobjects[j] = y;
+        }
+    }
+    s__X.s_thing = boundx;
+
+    /* pd appended the new objects, put them where they are in the file, so that loadbang
+       and dsp sort order are the same as after a full reload. Matched objects are already
+       in file order, since the match keeps their order */
+    for (y = x->gl_list, count = 0; y; y = y->g_next)
+        count++;
+    for (j = 0; j < n->c_nobjects; j++)
+        count -= newobjects[j] != 0;
+    if (!count)
+    {
+        last = 0;
+        for (j = 0; j < n->c_nobjects; j++)
+        {
+            if (!newobjects[j])
+                continue;
+            if (last)
+                last->g_next = newobjects[j];
+            else
+                x->gl_list = newobjects[j];
+            last = newobjects[j];
+        }
+        if (last)
+            last->g_next = 0;
+    }
+
+    /* remove connections between surviving objects that are gone */
+    for (i = 0; i < o->c_nconnections; i++)
+    {
+        t_object* src = reload_connection_object(o, i, 0, oldobjects, &outno);
+        t_object* sink = reload_connection_object(o, i, 1, oldobjects, &inno);
+        if (src && sink && !reload_has_connection(n, newobjects, src, outno, sink, inno))
+            obj_disconnect(src, outno, sink, inno);
+    }
+
+    /* add connections that are new */
+    for (i = 0; i < n->c_nconnections; i++)
+    {
+        t_object* src = reload_connection_object(n, i, 0, newobjects, &outno);
+        t_object* sink = reload_connection_object(n, i, 1, newobjects, &inno);
+        if (src && sink && !canvas_isconnected(x, src, outno, sink, inno)
+            && outno < obj_noutlets(src) && inno < obj_ninlets(sink))
+            obj_connect(src, outno, sink, inno);
+    }
+
+    freebytes(oldobjects, (o->c_nobjects + 1) * sizeof(t_gobj*));
+    freebytes(newobjects, (n->c_nobjects + 1) * sizeof(t_gobj*));
+}
+
+typedef struct _reload_instances
+{
+    t_canvas** r_vec;
+    int r_n;
+} t_reload_instances;
+
+static void reload_collect(t_glist* gl, t_symbol* name, t_symbol* dir, t_glist* except, t_reload_instances* r)
+{
+    t_gobj* g;
+    for (g = gl->gl_list; g; g = g->g_next)
+    {
+        t_glist* sub = 0;
+        if (pd_class(&g->g_pd) == canvas_class)
+            sub = (t_glist*)g;
+        else if (pd_class(&g->g_pd)->c_name == gensym("clone"))
+        {
+            int i;
+            for (i = 0; i < clone_get_n(g); i++)
+            {
+                t_glist* c = clone_get_instance(g, i);
+                if (c != except && c->gl_name == name && canvas_getdir(c) == dir)
+                {
+                    r->r_vec = (t_canvas**)resizebytes(r->r_vec, (r->r_n + 1) * sizeof(t_canvas*), (r->r_n + 2) * sizeof(t_canvas*));
+                    r->r_vec[r->r_n++] = c;
+                }
+                else
+                    reload_collect(c, name, dir, except, r);
+            }
+            continue;
+        }
+        if (!sub)
+            continue;
+
+        if (sub != except && canvas_isabstraction(sub) && sub->gl_name == name && canvas_getdir(sub) == dir)
+        {
+            r->r_vec = (t_canvas**)resizebytes(r->r_vec, (r->r_n + 1) * sizeof(t_canvas*), (r->r_n + 2) * sizeof(t_canvas*));
+            r->r_vec[r->r_n++] = sub;
+        }
+        else
+            reload_collect(sub, name, dir, except, r);
+    }
+}
+
+int libpd_reload_abstraction(t_symbol* name, t_symbol* dir, t_glist* except)
+{
+    t_reload_content newcontent, *oldcontent;
+    t_reload_instances instances = { 0, 0 };
+    t_binbuf* b = binbuf_new();
+    t_canvas* root;
+    int** matches;
+    int i, ok = 1;
+
+    if (binbuf_read(b, name->s_name, dir->s_name, 0))
+    {
+        binbuf_free(b);
+        return 0;
+    }
+    if (!reload_content_parse(&newcontent, b))
+    {
+        reload_content_free(&newcontent);
+        binbuf_free(b);
+        return 0;
+    }
+
+    instances.r_vec = (t_canvas**)getbytes(sizeof(t_canvas*));
+    for (root = pd_getcanvaslist(); root; root = root->gl_next)
+        reload_collect(root, name, dir, except, &instances);
+
+    /* first check every instance, we only start modifying once we know we don't need a full reload */
+    oldcontent = (t_reload_content*)getbytes((instances.r_n + 1) * sizeof(t_reload_content));
+    matches = (int**)getbytes((instances.r_n + 1) * sizeof(int*));
+    for (i = 0; i < instances.r_n && ok; i++)
+        ok = reload_instance_check(instances.r_vec[i], &newcontent, &oldcontent[i], &matches[i]);
+
+    /* resuming dsp rebuilds the dsp chain once for all instances */
+    if (ok && instances.r_n)
+    {
+        int dspstate = canvas_suspend_dsp();
+        reload_evalstructs(b);
+        for (i = 0; i < instances.r_n; i++) {
+            reload_instance_apply(instances.r_vec[i], &newcontent, &oldcontent[i], matches[i]);
+            libpd_journal_add(LIBPD_JOURNAL_RESYNC, instances.r_vec[i], 0, 0);
+        }
+        canvas_resume_dsp(dspstate);
+    }
+
+    for (i = 0; i < instances.r_n; i++)
+    {
+        if (oldcontent[i].c_binbuf)
+            binbuf_free(oldcontent[i].c_binbuf);
+        if (oldcontent[i].c_objects)
+            reload_content_free(&oldcontent[i]);
+        if (matches[i])
+            freebytes(matches[i], (oldcontent[i].c_nobjects + 1) * sizeof(int));
+    }
+    freebytes(oldcontent, (instances.r_n + 1) * sizeof(t_reload_content));
+    freebytes(matches, (instances.r_n + 1) * sizeof(int*));
+    freebytes(instances.r_vec, (instances.r_n + 1) * sizeof(t_canvas*));
+    reload_content_free(&newcontent);
+    binbuf_free(b);
+    return ok;
+}
+
+/* ------------------- in-place patch updates ------------------- */
+
+/* Brings an open patch up to date with new content while it keeps running, so switching presets
+   doesn't have to close and reopen it. If only array data differs, the new values are written into
+   the existing arrays. If objects changed, we try to apply the difference like we do for abstractions,
+   so the objects that weren't touched keep their state. Only when that isn't possible do we replace
+   everything inside the canvas, which still keeps the canvas itself and its editor around. */
+
+/* returns the number of atoms in the message that starts at onset, without the semicolon */
+static int update_msglength(t_atom const* vec, int natom, int onset)
+{
+    int i;
+    for (i = onset; i < natom && vec[i].a_type != A_SEMI; i++)
+        ;
+    return i - onset;
+}
+
+static int update_isdata(t_atom const* msg, int n)
+{
+    return n && msg[0].a_type == A_SYMBOL && msg[0].a_w.w_symbol == gensym("#A");
+}
+
+/* returns 0 if the content differs in anything other than array data, writes the new data if apply is set */
+static int update_arrays(t_canvas* x, t_binbuf* newb, t_binbuf* oldb, int apply)
+{
+    t_atom *nvec = binbuf_getvec(newb), *ovec = binbuf_getvec(oldb);
+    int nnatom = binbuf_getnatom(newb), onatom = binbuf_getnatom(oldb);
+    int ni = reload_skipstructs(nvec, nnatom), oi = reload_skipstructs(ovec, onatom);
+    t_pd* array = 0;
+
+    while (ni < nnatom && oi < onatom)
+    {
+        int nn = update_msglength(nvec, nnatom, ni), on = update_msglength(ovec, onatom, oi);
+        int changed = nn != on || !reload_atoms_equal(nvec + ni, ovec + oi, nn);
+
+        if (update_isdata(nvec + ni, nn) && update_isdata(ovec + oi, on))
+        {
+            if (!array)
+                return 0;
+            /* same as while loading: the first value is the onset of the values that follow */
+            if (changed && apply)
+                pd_list(array, &s_list, nn - 1, nvec + ni + 1);
+        }
+        else if (changed)
+            return 0;
+        else if (nn > 2 && nvec[ni + 1].a_type == A_SYMBOL && nvec[ni + 1].a_w.w_symbol == gensym("array")
+            && (nvec[ni + 2].a_type == A_SYMBOL || nvec[ni + 2].a_type == A_DOLLSYM))
+        {
+            t_symbol* name = canvas_realizedollar(x, nvec[ni + 2].a_w.w_symbol);
+            array = pd_findbyclass(name, garray_class);
+        }
+
+        ni += nn + 1;
+        oi += on + 1;
+    }
+
+    return ni >= nnatom && oi >= onatom;
+}
+
+/* replaces everything inside the canvas, the same way it gets created when its file is loaded */
+static void update_replace(t_canvas* x, t_binbuf* b)
+{
+    t_pd *bounda = gensym("#A")->s_thing, *boundn = s__N.s_thing, *boundx = s__X.s_thing;
+    t_atom* vec = binbuf_getvec(b);
+    int natom = binbuf_getnatom(b), start = reload_skipstructs(vec, natom);
+    t_binbuf* body = binbuf_new();
+
+    /* the templates were already created, and the "#N canvas" message after them creates the
+       canvas itself, which we already have */
+    start += update_msglength(vec, natom, start) + 1;
+    if (start < natom)
+        binbuf_add(body, natom - start, vec + start);
+
+    glist_noselect(x);
+    glist_clear(x);
+
+    x->gl_loading = 1;
+    canvas_setcurrent(x);
+    gensym("#A")->s_thing = 0;
+    s__N.s_thing = &pd_canvasmaker;
+    s__X.s_thing = &x->gl_pd;
+    binbuf_eval(body, 0, 0, 0);
+    gensym("#A")->s_thing = bounda;
+    s__N.s_thing = boundn;
+    s__X.s_thing = boundx;
+    canvas_unsetcurrent(x);
+    x->gl_loading = 0;
+
+    binbuf_free(body);
+    canvas_loadbang(x);
+}
+
+struct _libpd_patch_update
+{
+    t_binbuf* u_binbuf;
+    t_reload_content u_content;
+    int u_parsed; /* whether u_content can be used for an incremental update */
+};
+
+t_libpd_patch_update* libpd_update_patch_prepare(char const* content, int size)
+{
+    t_libpd_patch_update* u;
+    t_binbuf* b = binbuf_new();
+    t_atom* vec;
+    int natom, onset;
+
+    binbuf_text(b, content, size);
+    vec = binbuf_getvec(b);
+    natom = binbuf_getnatom(b);
+    onset = reload_skipstructs(vec, natom);
+
+    /* the same check pd does while loading: after the templates there has to be a canvas */
+    if (onset + 1 >= natom || vec[onset].a_type != A_SYMBOL || vec[onset].a_w.w_symbol != gensym("#N")
+        || vec[onset + 1].a_type != A_SYMBOL || vec[onset + 1].a_w.w_symbol != gensym("canvas"))
+    {
+        binbuf_free(b);
+        return 0;
+    }
+
+    u = (t_libpd_patch_update*)getbytes(sizeof(t_libpd_patch_update));
+    u->u_binbuf = b;
+    u->u_parsed = reload_content_parse(&u->u_content, b);
+    return u;
+}
+
+void libpd_update_patch_free(t_libpd_patch_update* u)
+{
+    if (u->u_content.c_objects)
+        reload_content_free(&u->u_content);
+    binbuf_free(u->u_binbuf);
+    freebytes(u, sizeof(t_libpd_patch_update));
+}
+
+void libpd_update_patch_apply(t_canvas* x, t_libpd_patch_update* u, t_symbol* name, t_symbol* dir)
+{
+    t_binbuf *newb = u->u_binbuf, *oldb = binbuf_new();
+    t_reload_content oldcontent = { 0 };
+    int* match = 0;
+    int dspstate;
+
+    dspstate = canvas_suspend_dsp();
+    libpd_journal_begin();
+    reload_evalstructs(newb);
+
+    if (name && dir && (name != x->gl_name || dir != canvas_getdir(x)))
+    {
+        /* abstractions may resolve to different files from the new location, so start from scratch */
+        canvas_rename(x, name, dir);
+        update_replace(x, newb);
+    }
+    else
+    {
+        char* buf;
+        int bufsize;
+        libpd_getcontent(x, &buf, &bufsize);
+        binbuf_text(oldb, buf, bufsize);
+        freebytes(buf, bufsize);
+
+        if (update_arrays(x, newb, oldb, 0))
+            update_arrays(x, newb, oldb, 1);
+        else if (u->u_parsed && reload_instance_check(x, &u->u_content, &oldcontent, &match))
+            reload_instance_apply(x, &u->u_content, &oldcontent, match);
+        else
+            update_replace(x, newb);
+    }
+
+    libpd_journal_add(LIBPD_JOURNAL_RESYNC, x, 0, 0);
+    libpd_journal_end();
+    canvas_dirty(x, 0);
+    canvas_resume_dsp(dspstate);
+
+    if (match)
+        freebytes(match, (oldcontent.c_nobjects + 1) * sizeof(int));
+    if (oldcontent.c_binbuf)
+        binbuf_free(oldcontent.c_binbuf);
+    if (oldcontent.c_objects)
+        reload_content_free(&oldcontent);
+    binbuf_free(oldb);
+}
@@ -79,6 +79,9 @@ void libpd_removeconnection(t_canvas* cnv, t_object* src, int nout, t_object* si
 void* libpd_setconnectionpath(t_canvas* cnv, t_object* src, int nout, t_object* sink, int nin, t_symbol* old_connection_path, t_symbol* new_connection_path);
 
 void libpd_getcontent(t_canvas* cnv, char** buf, int* bufsize);
+
+// Flushes a file to disk and renames it over the target, returns 0 on failure
+int libpd_commitfile(char const* from, char const* to);
 void libpd_savetofile(t_canvas* cnv, t_symbol* filename, t_symbol* dir);
 
 int libpd_noutlets(t_object const* x);
@@ -106,6 +109,21 @@ void* libpd_get_class_methods(t_class* o);
 
 void set_class_prefix(t_symbol* dir);
 
+// Updates all loaded instances of an abstraction by applying the difference with the file on disk
+// Returns 0 without changing anything if the change can't be applied like that, use canvas_reload() in that case
+int libpd_reload_abstraction(t_symbol* name, t_symbol* dir, t_glist* except);
+
+typedef struct _libpd_patch_update t_libpd_patch_update;
+
+// Parses new content for libpd_update_patch_apply, this doesn't touch any canvas so it can be done without the pd lock
+// Returns null if the content doesn't start like a patch file
+t_libpd_patch_update* libpd_update_patch_prepare(char const* content, int size);
+void libpd_update_patch_free(t_libpd_patch_update* update);
+
+// Updates an open patch to new content without closing it, keeping as much of its state as possible
+// Pass a name and directory to move the patch to a different file, or null to keep its current location
+void libpd_update_patch_apply(t_canvas* x, t_libpd_patch_update* update, t_symbol* name, t_symbol* dir);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,8 @@
 #include <string.h>
 #include <assert.h>
 #include "x_libpd_multi.h"
+#include "x_libpd_abstraction_cache.h"
+#include "x_libpd_array_sidecar.h"
 
 
 static t_class* libpd_multi_receiver_class;
@@ -1320,6 +1322,8 @@ void libpd_multi_init(void)
         libpd_multi_midi_setup();
         libpd_multi_print_setup();
         libpd_defaultfont_init();
+        libpd_abstraction_cache_setup();
+        libpd_array_sidecar_setup();
         libpd_set_verbose(4);
 
         socket_init();
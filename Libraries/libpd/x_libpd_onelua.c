@@ -0,0 +1,17 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+/* pdlua has a single lua state that is shared by all pd instances, and those may run on different
+   audio threads. Lua brackets everything that touches a state with lua_lock and lua_unlock, and
+   releases the lock while it calls into C, so building it with those mapped to one process-wide
+   mutex means pdlua's calls and our collector steps never run at the same time. */
+
+#include "x_libpd_lua_gc.h"
+
+#define lua_lock(L) libpd_lua_lock()
+#define lua_unlock(L) libpd_lua_unlock()
+
+#include "onelua.c"
@@ -0,0 +1,414 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <s_utf8.h>
+#define pathcache_strcmp _stricmp
+#define pathcache_strncmp _strnicmp
+#else
+#include <dirent.h>
+#include <strings.h>
+#ifdef __APPLE__
+#define pathcache_strcmp strcasecmp
+#define pathcache_strncmp strncasecmp
+#else
+#define pathcache_strcmp strcmp
+#define pathcache_strncmp strncmp
+#endif
+#endif
+
+#include "x_libpd_path_cache.h"
+#include "x_libpd_abstraction_cache.h"
+
+/* not exported through any of pd's headers */
+struct _canvasenvironment
+{
+    t_symbol* ce_dir;    /* directory patch lives in */
+    int ce_argc;         /* number of "$" arguments */
+    t_atom* ce_argv;     /* array of "$" arguments */
+    int ce_dollarzero;   /* value of "$0" */
+    t_namelist* ce_path; /* search path */
+};
+
+/* Resolving a class that pd doesn't know yet makes it try every extension it knows in every search path,
+   which adds up to thousands of failing open() calls for a single patch. Instead, we keep a sorted listing
+   of every directory we've searched. Listings are dropped when the file watcher reports a change, and are
+   checked against the modification time of their directory once they're older than PATHCACHE_MAXAGE.
+
+   Pd's loaders only try files named after the class: "name" with one of their extensions, and
+   "name/name" with one of their extensions. So when no listing has an entry called "name" or starting
+   with "name.", none of those open() calls can succeed and we fail right away. When one directory has
+   just an abstraction with that name and nothing else that could provide the class, we load that, like
+   pd would. Anything else goes to pd's loaders, so they keep their search order. */
+
+#define PATHCACHE_MAXAGE 2.0
+
+typedef struct _pathcache_dir
+{
+    char* d_path;
+    char** d_entries; /* sorted with pathcache_strcmp */
+    int d_n;
+    time_t d_mtime;
+    double d_checktime;
+    unsigned int d_generation;
+    struct _pathcache_dir* d_next;
+} t_pathcache_dir;
+
+typedef enum
+{
+    PATHCACHE_NONE,        /* nothing with this name */
+    PATHCACHE_ABSTRACTION, /* only name.pd */
+    PATHCACHE_OTHER        /* externals, lua objects, subdirectories, etc. */
+} t_pathcache_match;
+
+static t_pathcache_dir* pathcache_dirs;
+static unsigned int pathcache_generation = 0;
+static int pathcache_lookups, pathcache_hits, pathcache_diskaccesses;
+
+/* the listings are shared between all instances, which may run on different threads */
+static pthread_mutex_t pathcache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int pathcache_compare(void const* a, void const* b)
+{
+    return pathcache_strcmp(*(char const**)a, *(char const**)b);
+}
+
+static void pathcache_clear(t_pathcache_dir* d)
+{
+    int i;
+    for (i = 0; i < d->d_n; i++)
+        free(d->d_entries[i]);
+    free(d->d_entries);
+    d->d_entries = 0;
+    d->d_n = 0;
+}
+
+static void pathcache_addentry(t_pathcache_dir* d, char const* name, int* allocated)
+{
+    if (!strcmp(name, ".") || !strcmp(name, ".."))
+        return;
+    if (d->d_n == *allocated)
+    {
+        *allocated = *allocated ? *allocated * 2 : 64;
+        d->d_entries = (char**)realloc(d->d_entries, *allocated * sizeof(char*));
+    }
+    d->d_entries[d->d_n++] = strdup(name);
+}
+
+static int pathcache_stat(char const* path, time_t* mtime)
+{
+#ifdef _WIN32
+    struct _stat st;
+    wchar_t ucs2path[MAXPDSTRING];
+    u8_utf8toucs2(ucs2path, MAXPDSTRING, path, MAXPDSTRING - 1);
+    if (_wstat(ucs2path, &st))
+        return 0;
+#else
+    struct stat st;
+    if (stat(path, &st))
+        return 0;
+#endif
+    *mtime = st.st_mtime;
+    return 1;
+}
+
+static void pathcache_list(t_pathcache_dir* d)
+{
+    int allocated = 0;
+
+    pathcache_clear(d);
+    pathcache_diskaccesses++;
+
+    /* a directory that doesn't exist simply has no entries */
+    if (!pathcache_stat(d->d_path, &d->d_mtime))
+        d->d_mtime = 0;
+
+#ifdef _WIN32
+    {
+        char pattern[MAXPDSTRING];
+        wchar_t ucs2pattern[MAXPDSTRING];
+        WIN32_FIND_DATAW data;
+        HANDLE handle;
+
+        snprintf(pattern, MAXPDSTRING, "%s/*", d->d_path);
+        u8_utf8toucs2(ucs2pattern, MAXPDSTRING, pattern, MAXPDSTRING - 1);
+        if ((handle = FindFirstFileW(ucs2pattern, &data)) != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                char name[MAXPDSTRING];
+                u8_ucs2toutf8(name, MAXPDSTRING, data.cFileName, -1);
+                pathcache_addentry(d, name, &allocated);
+            } while (FindNextFileW(handle, &data));
+            FindClose(handle);
+        }
+    }
+#else
+    {
+        DIR* dir = opendir(d->d_path);
+        struct dirent* entry;
+        if (dir)
+        {
+            while ((entry = readdir(dir)))
+                pathcache_addentry(d, entry->d_name, &allocated);
+            closedir(dir);
+        }
+    }
+#endif
+
+    if (d->d_n)
+        qsort(d->d_entries, d->d_n, sizeof(char*), pathcache_compare);
+}
+
+/* call with pathcache_mutex held */
+static t_pathcache_dir* pathcache_getdir(char const* path)
+{
+    t_pathcache_dir* d;
+    double now = sys_getrealtime();
+
+    for (d = pathcache_dirs; d; d = d->d_next)
+    {
+        if (!strcmp(d->d_path, path))
+            break;
+    }
+
+    if (!d)
+    {
+        d = (t_pathcache_dir*)calloc(1, sizeof(t_pathcache_dir));
+        d->d_path = strdup(path);
+        d->d_next = pathcache_dirs;
+        pathcache_dirs = d;
+    }
+    else if (d->d_generation == pathcache_generation)
+    {
+        time_t mtime;
+        if (now - d->d_checktime < PATHCACHE_MAXAGE)
+            return d;
+
+        /* only read the directory again if something was added or removed */
+        pathcache_diskaccesses++;
+        if ((pathcache_stat(d->d_path, &mtime) ? mtime : 0) == d->d_mtime)
+        {
+            d->d_checktime = now;
+            return d;
+        }
+    }
+
+    pathcache_list(d);
+    d->d_generation = pathcache_generation;
+    d->d_checktime = now;
+    return d;
+}
+
+/* call with pathcache_mutex held */
+static t_pathcache_match pathcache_match(char const* path, char const* name, char const* ext)
+{
+    t_pathcache_dir* d = pathcache_getdir(path);
+    t_pathcache_match match = PATHCACHE_NONE;
+    size_t len = strlen(name);
+    int lo = 0, hi = d->d_n;
+
+    /* find the first entry that starts with the name */
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (pathcache_strcmp(d->d_entries[mid], name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < d->d_n && !pathcache_strncmp(d->d_entries[lo], name, len); lo++)
+    {
+        char const* rest = d->d_entries[lo] + len;
+        if (*rest && *rest != '.')
+            continue;
+        if (!pathcache_strcmp(rest, ext))
+        {
+            if (match == PATHCACHE_NONE)
+                match = PATHCACHE_ABSTRACTION;
+        }
+        else
+            match = PATHCACHE_OTHER;
+    }
+
+    return match;
+}
+
+typedef struct _pathcache_search
+{
+    char const* s_name;
+    char const* s_ext;
+    int s_ignoreother; /* only look for name + ext */
+    int s_nfound;
+    int s_other;
+    char s_dir[MAXPDSTRING];
+} t_pathcache_search;
+
+static void pathcache_search_dir(t_pathcache_search* s, char const* path)
+{
+    t_pathcache_match match = pathcache_match(path, s->s_name, s->s_ext);
+
+    if (match == PATHCACHE_OTHER && !s->s_ignoreother)
+        s->s_other = 1;
+    else if (match != PATHCACHE_NONE)
+    {
+        /* the same directory can be in the search path more than once */
+        if (!s->s_nfound || strcmp(s->s_dir, path))
+            s->s_nfound++;
+        strncpy(s->s_dir, path, MAXPDSTRING - 1);
+        s->s_dir[MAXPDSTRING - 1] = 0;
+    }
+}
+
+static void pathcache_search_namelist(t_pathcache_search* s, t_namelist* nl)
+{
+    for (; nl; nl = nl->nl_next)
+        pathcache_search_dir(s, nl->nl_string);
+}
+
+/* searches the directories that pd would search, in the same order as canvas_open() */
+static void pathcache_search(t_pathcache_search* s, t_canvas* canvas)
+{
+    pthread_mutex_lock(&pathcache_mutex);
+
+    if (canvas)
+    {
+        /* only the paths declared in the root canvas of this patch or abstraction,
+           pd resolves relative ones against the directory of the toplevel patch */
+        t_canvas* root = canvas_getrootfor(canvas);
+        t_canvas* toplevel = canvas;
+        t_namelist* nl;
+
+        while (toplevel->gl_owner)
+            toplevel = toplevel->gl_owner;
+
+        if (root->gl_env)
+        {
+            for (nl = root->gl_env->ce_path; nl; nl = nl->nl_next)
+            {
+                char realname[MAXPDSTRING];
+                if (sys_isabsolutepath(nl->nl_string))
+                    snprintf(realname, MAXPDSTRING, "%s", nl->nl_string);
+                else
+                    snprintf(realname, MAXPDSTRING, "%s/%s", canvas_getdir(toplevel)->s_name, nl->nl_string);
+                pathcache_search_dir(s, realname);
+            }
+        }
+
+        pathcache_search_dir(s, canvas_getdir(canvas)->s_name);
+    }
+
+    pathcache_search_namelist(s, STUFF->st_temppath);
+    pathcache_search_namelist(s, STUFF->st_searchpath);
+    if (sys_usestdpath)
+        pathcache_search_namelist(s, STUFF->st_staticpath);
+
+    pthread_mutex_unlock(&pathcache_mutex);
+}
+
+int libpd_path_cache_open(t_canvas* canvas, char const* name, char const* ext, char* dirresult, char** nameresult, unsigned int size)
+{
+    t_pathcache_search s = { name, ext, 1, 0, 0, "" };
+    char filename[MAXPDSTRING];
+    int fd;
+
+    if (strchr(name, '/') || strchr(name, '\\'))
+        return canvas_open(canvas, name, ext, dirresult, nameresult, size, 0);
+
+    pathcache_search(&s, canvas);
+
+    /* not in the cache, or in more than one place: leave it to pd to pick the right one */
+    if (s.s_nfound != 1)
+        return canvas_open(canvas, name, ext, dirresult, nameresult, size, 0);
+
+    snprintf(filename, MAXPDSTRING, "%s%s", name, ext);
+    if ((fd = sys_trytoopenone(s.s_dir, filename, "", dirresult, nameresult, size, 0)) >= 0)
+        return fd;
+
+    /* the listing was outdated */
+    return canvas_open(canvas, name, ext, dirresult, nameresult, size, 0);
+}
+
+/* pd's objectmaker method for unknown classes, which we call when the cache can't help */
+static t_anymethod pathcache_anything_was;
+
+static void pathcache_anything(t_pd* dummy, t_symbol* s, int argc, t_atom* argv)
+{
+    t_pathcache_search search = { s->s_name, ".pd", 0, 0, 0, "" };
+
+    if (!strchr(s->s_name, '/') && !strchr(s->s_name, '\\'))
+    {
+        pathcache_search(&search, canvas_getcurrent());
+
+        pthread_mutex_lock(&pathcache_mutex);
+        pathcache_lookups++;
+        if (!search.s_other && search.s_nfound == 1)
+            pathcache_hits++;
+        pthread_mutex_unlock(&pathcache_mutex);
+
+        if (!search.s_other && search.s_nfound == 1)
+        {
+            libpd_abstraction_cache_addcreator(s);
+            typedmess(dummy, s, argc, argv);
+            return;
+        }
+
+        /* nothing to load in any directory, this is how pd's objectmaker fails after searching them all */
+        if (!search.s_other && !search.s_nfound)
+        {
+            pd_this->pd_newest = 0;
+            return;
+        }
+    }
+
+    pathcache_anything_was(dummy, s, argc, argv);
+}
+
+void libpd_path_cache_setup(void)
+{
+    /* every instance has its own objectmaker */
+    if (pd_objectmaker->c_anymethod != (t_anymethod)pathcache_anything)
+    {
+        pathcache_anything_was = pd_objectmaker->c_anymethod;
+        pd_objectmaker->c_anymethod = (t_anymethod)pathcache_anything;
+    }
+}
+
+void libpd_path_cache_invalidate(void)
+{
+    pthread_mutex_lock(&pathcache_mutex);
+    pathcache_generation++;
+    pthread_mutex_unlock(&pathcache_mutex);
+}
+
+void libpd_path_cache_get_stats(int* lookups, int* hits, int* diskaccesses)
+{
+    pthread_mutex_lock(&pathcache_mutex);
+    *lookups = pathcache_lookups;
+    *hits = pathcache_hits;
+    *diskaccesses = pathcache_diskaccesses;
+    pthread_mutex_unlock(&pathcache_mutex);
+}
+
+void libpd_path_cache_reset_stats(void)
+{
+    pthread_mutex_lock(&pathcache_mutex);
+    pathcache_lookups = pathcache_hits = pathcache_diskaccesses = 0;
+    pthread_mutex_unlock(&pathcache_mutex);
+}
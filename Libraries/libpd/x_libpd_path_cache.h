@@ -0,0 +1,32 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Makes the current pd instance consult cached directory listings of its search paths before resolving
+// unknown class names on disk. Abstractions that only exist in one place are loaded without asking pd's loaders,
+// and names that no file in the search path could provide fail without asking them
+void libpd_path_cache_setup(void);
+
+// Marks all cached directory listings as outdated, safe to call from any thread
+void libpd_path_cache_invalidate(void);
+
+// Same as canvas_open(), but finds the file in the cached listings when it only exists in one place
+int libpd_path_cache_open(t_canvas* canvas, char const* name, char const* ext, char* dirresult, char** nameresult, unsigned int size);
+
+// Counters for benchmarking: class lookups, lookups answered from the cache, and directories read or checked on disk
+void libpd_path_cache_get_stats(int* lookups, int* hits, int* diskaccesses);
+void libpd_path_cache_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
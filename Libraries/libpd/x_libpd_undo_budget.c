@@ -0,0 +1,311 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+#include <g_undo.h>
+
+#include <pthread.h>
+
+#include "x_libpd_undo_budget.h"
+
+/* Pd keeps every undo step until the canvas is closed. Cut, paste, create, recreate and apply steps
+   keep copies of the objects involved as binbufs, which is where nearly all of the memory goes. We
+   measure those copies, and count every other step as a small fixed size. When the history of a canvas
+   is over budget, we drop its oldest steps through the same free functions pd uses, keeping undo
+   sequences together.
+
+   We only have to do that when the history changed. Every step is a separate allocation, so we
+   notice that by comparing pd's position in the history with the one we saw last time. */
+
+/* rough size of the data of a step that doesn't hold any objects */
+#define UNDO_SMALLRECORD 64
+
+/* The data of these steps is what canvas_undo_set_cut(), canvas_undo_set_paste(), canvas_undo_set_create(),
+   canvas_undo_set_recreate() and canvas_undo_set_apply() return. Their structs are private to g_editor.c,
+   these are the parts of them that we read and must stay in sync with it */
+typedef struct _undo_cut_head
+{
+    t_binbuf* u_objectbuf;
+    t_binbuf* u_reconnectbuf;
+    t_binbuf* u_redotextbuf;
+} t_undo_cut_head;
+
+typedef struct _undo_paste_head
+{
+    int u_index;
+    int u_sel_index;
+    int u_offset;
+    t_binbuf* u_objectbuf;
+} t_undo_paste_head;
+
+typedef struct _undo_create_head /* also used for recreate */
+{
+    int u_index;
+    t_binbuf* u_objectbuf;
+    t_binbuf* u_reconnectbuf;
+} t_undo_create_head;
+
+typedef struct _undo_apply_head
+{
+    t_binbuf* u_objectbuf;
+    t_binbuf* u_reconnectbuf;
+} t_undo_apply_head;
+
+typedef struct _undo_canvas
+{
+    t_pdinstance* c_instance;
+    t_canvas* c_canvas;
+    t_undo_action* c_last; /* position in the history when we last looked at it */
+    size_t c_bytes;
+    int c_steps;
+    struct _undo_canvas* c_next;
+} t_undo_canvas;
+
+static size_t undo_budget = 0;
+static t_undo_canvas* undo_canvases;
+
+/* the list is shared between all instances, which may run on different threads */
+static pthread_mutex_t undo_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void libpd_undo_budget_set(size_t bytes)
+{
+    undo_budget = bytes;
+}
+
+/* call with undo_mutex held */
+static t_undo_canvas* undo_getcanvas(t_canvas* x, int create)
+{
+    t_undo_canvas* c;
+    for (c = undo_canvases; c; c = c->c_next)
+    {
+        if (c->c_canvas == x && c->c_instance == pd_this)
+            return c;
+    }
+    if (!create)
+        return 0;
+
+    c = (t_undo_canvas*)getbytes(sizeof(t_undo_canvas));
+    c->c_instance = pd_this;
+    c->c_canvas = x;
+    c->c_next = undo_canvases;
+    undo_canvases = c;
+    return c;
+}
+
+static void undo_freecanvas(t_undo_canvas* c)
+{
+    freebytes(c, sizeof(t_undo_canvas));
+}
+
+static size_t undo_binbufsize(t_binbuf* b)
+{
+    return b ? binbuf_getnatom(b) * sizeof(t_atom) : 0;
+}
+
+static size_t undo_stepsize(t_undo_action* a)
+{
+    size_t size = sizeof(t_undo_action) + UNDO_SMALLRECORD;
+
+    if (!a->data)
+        return size;
+
+    switch (a->type)
+    {
+    case UNDO_CUT:
+    {
+        t_undo_cut_head* u = (t_undo_cut_head*)a->data;
+        size += undo_binbufsize(u->u_objectbuf) + undo_binbufsize(u->u_reconnectbuf) + undo_binbufsize(u->u_redotextbuf);
+        break;
+    }
+    case UNDO_PASTE:
+        size += undo_binbufsize(((t_undo_paste_head*)a->data)->u_objectbuf);
+        break;
+    case UNDO_CREATE:
+    case UNDO_RECREATE:
+    {
+        t_undo_create_head* u = (t_undo_create_head*)a->data;
+        size += undo_binbufsize(u->u_objectbuf) + undo_binbufsize(u->u_reconnectbuf);
+        break;
+    }
+    case UNDO_APPLY:
+    {
+        t_undo_apply_head* u = (t_undo_apply_head*)a->data;
+        size += undo_binbufsize(u->u_objectbuf) + undo_binbufsize(u->u_reconnectbuf);
+        break;
+    }
+    default: break;
+    }
+    return size;
+}
+
+/* frees a step the same way canvas_undo_free() does */
+static void undo_freestep(t_canvas* x, t_undo_action* a)
+{
+    switch (a->type)
+    {
+    case UNDO_CONNECT: canvas_undo_connect(x, a->data, UNDO_FREE); break;
+    case UNDO_DISCONNECT: canvas_undo_disconnect(x, a->data, UNDO_FREE); break;
+    case UNDO_CUT: canvas_undo_cut(x, a->data, UNDO_FREE); break;
+    case UNDO_MOTION: canvas_undo_move(x, a->data, UNDO_FREE); break;
+    case UNDO_PASTE: canvas_undo_paste(x, a->data, UNDO_FREE); break;
+    case UNDO_APPLY: canvas_undo_apply(x, a->data, UNDO_FREE); break;
+    case UNDO_ARRANGE: canvas_undo_arrange(x, a->data, UNDO_FREE); break;
+    case UNDO_CANVAS_APPLY: canvas_undo_canvas_apply(x, a->data, UNDO_FREE); break;
+    case UNDO_CREATE: canvas_undo_create(x, a->data, UNDO_FREE); break;
+    case UNDO_RECREATE: canvas_undo_recreate(x, a->data, UNDO_FREE); break;
+    case UNDO_FONT: canvas_undo_font(x, a->data, UNDO_FREE); break;
+    default: break;
+    }
+    freebytes(a, sizeof(*a));
+}
+
+/* returns the last step of the group that starts with a, or 0 if the group isn't complete yet */
+static t_undo_action* undo_groupend(t_undo_action* a)
+{
+    int depth = 0;
+    for (; a; a = a->next)
+    {
+        if (a->type == UNDO_SEQUENCE_START)
+            depth++;
+        else if (a->type == UNDO_SEQUENCE_END)
+            depth--;
+        if (depth <= 0)
+            return a;
+    }
+    return 0;
+}
+
+/* call with undo_mutex held, updates the totals */
+static void undo_measure(t_undo_canvas* c, t_undo* udo)
+{
+    t_undo_action* a;
+
+    c->c_bytes = 0;
+    c->c_steps = 0;
+    for (a = udo->u_queue->next; a; a = a->next)
+    {
+        c->c_bytes += undo_stepsize(a);
+        c->c_steps++;
+    }
+}
+
+/* call with undo_mutex held, drops the oldest steps until the history fits in the budget */
+static void undo_evict(t_canvas* x, t_undo_canvas* c, t_undo* udo)
+{
+    /* the first step is a placeholder that can't be undone, never drop the current step's redo side */
+    while (undo_budget && c->c_bytes > undo_budget && udo->u_last != udo->u_queue)
+    {
+        t_undo_action *first = udo->u_queue->next, *last = first ? undo_groupend(first) : 0, *a, *next;
+        int reachescurrent = 0, reachesclean = 0;
+
+        if (!last)
+            break;
+        for (a = first; a != last->next; a = a->next)
+        {
+            if (a == udo->u_last && a != last)
+                break;
+            reachescurrent = reachescurrent || a == udo->u_last;
+            reachesclean = reachesclean || a == udo->u_cleanstate;
+        }
+        if (a != last->next)
+            break;
+
+        udo->u_queue->next = last->next;
+        if (last->next)
+            last->next->prev = udo->u_queue;
+        if (reachescurrent)
+            udo->u_last = udo->u_queue;
+
+        /* the saved state is gone from the history, unless it was where we are now */
+        if (reachesclean)
+            udo->u_cleanstate = (reachescurrent && udo->u_cleanstate == last) ? udo->u_queue : 0;
+
+        for (a = first; a; a = next)
+        {
+            next = a->next;
+            c->c_bytes -= undo_stepsize(a);
+            c->c_steps--;
+            undo_freestep(x, a);
+            if (a == last)
+                break;
+        }
+    }
+}
+
+/* call with undo_mutex held, only does any work if the history changed since the last time */
+static t_undo_canvas* undo_update(t_canvas* x)
+{
+    t_undo* udo = canvas_undo_get(x);
+    t_undo_canvas* c;
+
+    if (!udo || !udo->u_queue)
+        return 0;
+
+    c = undo_getcanvas(x, 1);
+    if (c->c_last == udo->u_last)
+        return c;
+
+    undo_measure(c, udo);
+    undo_evict(x, c, udo);
+    c->c_last = udo->u_last;
+    return c;
+}
+
+void libpd_undo_budget_apply(t_canvas* x)
+{
+    pthread_mutex_lock(&undo_mutex);
+    undo_update(x);
+    pthread_mutex_unlock(&undo_mutex);
+}
+
+void libpd_undo_budget_getusage(t_canvas* x, size_t* bytes, int* steps)
+{
+    t_undo_canvas* c;
+
+    pthread_mutex_lock(&undo_mutex);
+    c = undo_update(x);
+    *bytes = c ? c->c_bytes : 0;
+    *steps = c ? c->c_steps : 0;
+    pthread_mutex_unlock(&undo_mutex);
+}
+
+void libpd_undo_budget_forget(t_canvas* x)
+{
+    t_undo_canvas** c = &undo_canvases;
+    pthread_mutex_lock(&undo_mutex);
+    while (*c)
+    {
+        if ((*c)->c_canvas == x && (*c)->c_instance == pd_this)
+        {
+            t_undo_canvas* next = (*c)->c_next;
+            undo_freecanvas(*c);
+            *c = next;
+        }
+        else
+            c = &(*c)->c_next;
+    }
+    pthread_mutex_unlock(&undo_mutex);
+}
+
+void libpd_undo_budget_free(void)
+{
+    t_undo_canvas** c = &undo_canvases;
+    pthread_mutex_lock(&undo_mutex);
+    while (*c)
+    {
+        if ((*c)->c_instance == pd_this)
+        {
+            t_undo_canvas* next = (*c)->c_next;
+            undo_freecanvas(*c);
+            *c = next;
+        }
+        else
+            c = &(*c)->c_next;
+    }
+    pthread_mutex_unlock(&undo_mutex);
+}
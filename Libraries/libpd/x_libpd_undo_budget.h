@@ -0,0 +1,34 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+#include <stddef.h>
+
+// Sets how much memory the undo history of a single canvas may use, 0 means unlimited
+void libpd_undo_budget_set(size_t bytes);
+
+// Drops the oldest steps until the history of this canvas fits in the budget
+// Call this after undo steps were added, it returns right away if the history didn't change
+void libpd_undo_budget_apply(t_canvas* cnv);
+
+// Returns the (estimated) memory used by the undo history of a canvas, and the number of steps
+void libpd_undo_budget_getusage(t_canvas* cnv, size_t* bytes, int* steps);
+
+// Forgets what we know about the history of a canvas that is about to be closed
+void libpd_undo_budget_forget(t_canvas* cnv);
+
+// Forgets the histories of all canvases of the current pd instance
+void libpd_undo_budget_free(void);
+
+#ifdef __cplusplus
+}
+#endif
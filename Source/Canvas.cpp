@@ -4,6 +4,7 @@
  // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
  */
 #include <juce_gui_basics/juce_gui_basics.h>
+#include <unordered_set>
 #include "Utility/Config.h"
 #include "Utility/Fonts.h"
 
@@ -24,16 +25,39 @@
 #include "Dialogs/Dialogs.h"
 #include "Utility/GraphArea.h"
 #include "Utility/RateReducer.h"
+#include "Utility/ConnectionRouter.h"
 
 extern "C" {
+#include "x_libpd_journal.h"
+
 void canvas_setgraph(t_glist* x, int flag, int nogoprect);
 }
 
+// Removes all matching elements in a single pass, instead of shifting the array once for every element that gets removed
+// The removed elements are deleted after the array no longer contains them
+template<typename ElementType, typename Predicate>
+static void removeMatching(OwnedArray<ElementType>& array, Predicate shouldRemove)
+{
+    OwnedArray<ElementType> removed;
+    int numKept = 0;
+
+    for (auto* element : array) {
+        if (shouldRemove(element)) {
+            removed.add(element);
+        } else {
+            array.begin()[numKept++] = element;
+        }
+    }
+
+    array.removeLast(array.size() - numKept, false);
+}
+
 Canvas::Canvas(PluginEditor* parent, pd::Patch::Ptr p, Component* parentGraph)
     : editor(parent)
     , pd(parent->pd)
     , refCountedPatch(p)
     , patch(*p)
+    , connectionLayer(std::make_unique<ConnectionLayer>(this))
     , pathUpdater(new ConnectionPathUpdater(this))
     , graphArea(nullptr)
     , canvasOrigin(Point<int>(infiniteCanvasSize / 2, infiniteCanvasSize / 2))
@@ -65,6 +89,9 @@ Canvas::Canvas(PluginEditor* parent, pd::Patch::Ptr p, Component* parentGraph)
         parentGraph->addAndMakeVisible(this);
         setInterceptsMouseClicks(false, true);
         isGraph = true;
+
+        if (auto* graphObject = dynamic_cast<ObjectBase*>(parentGraph))
+            parentCanvas = graphObject->cnv;
     } else {
         isGraph = false;
     }
@@ -81,6 +108,7 @@ Canvas::Canvas(PluginEditor* parent, pd::Patch::Ptr p, Component* parentGraph)
             if (graphArea) {
                 graphArea->updateBounds();
             }
+            updateOnScreenObjects();
         };
 
         canvasViewport->setScrollBarsShown(true, true, true, true);
@@ -112,6 +140,7 @@ Canvas::Canvas(PluginEditor* parent, pd::Patch::Ptr p, Component* parentGraph)
     auto defaultZoom = SettingsFile::getInstance()->getPropertyAsValue("default_zoom");
     zoomScale.setValue(getValue<float>(defaultZoom)/100.0f);
     zoomScale.addListener(this);
+    updateDetailLevel();
 
     // Add lasso component
     addAndMakeVisible(&lasso);
@@ -124,6 +153,11 @@ Canvas::Canvas(PluginEditor* parent, pd::Patch::Ptr p, Component* parentGraph)
     } else {
         presentationMode = false;
     }
+
+    addAndMakeVisible(*connectionLayer);
+    connectionLayer->setAlwaysOnTop(true);
+
+    patch.addView(this);
     performSynchronise();
 
     // Start in unlocked mode if the patch is empty
@@ -152,9 +186,15 @@ Canvas::~Canvas()
     zoomScale.removeListener(this);
     editor->removeModifierKeyListener(this);
     pd->unregisterMessageListener(patch.getPointer().get(), this);
+    patch.removeView(this);
 
     Desktop::getInstance().removeFocusChangeListener(this);
 
+    // Detach from the viewport while our members are still alive, destroying it would notify us of the hierarchy change
+    if (viewport) {
+        viewport->setViewedComponent(nullptr, false);
+    }
+
     delete suggestor;
 }
 
@@ -203,12 +243,85 @@ int Canvas::getOverlays() const
     return overlayState;
 }
 
+Canvas::DetailLevel Canvas::getDetailLevel() const
+{
+    return detailLevel;
+}
+
+void Canvas::updateDetailLevel()
+{
+    // A graph is drawn at the zoom level of the canvas it's on, not its own
+    auto scale = getValue<float>(zoomScale);
+    auto newDetailLevel = DetailLevel::Full;
+
+    if (parentCanvas) {
+        newDetailLevel = parentCanvas->getDetailLevel();
+    } else if (scale < minimalDetailScale) {
+        newDetailLevel = DetailLevel::Minimal;
+    } else if (scale < reducedDetailScale) {
+        newDetailLevel = DetailLevel::Reduced;
+    }
+
+    if (newDetailLevel == detailLevel)
+        return;
+
+    detailLevel = newDetailLevel;
+
+    for (auto* object : objects) {
+        object->detailLevelChanged();
+
+        if (auto* graph = object->gui ? object->gui->getCanvas() : nullptr; graph && graph->isGraph)
+            graph->updateDetailLevel();
+    }
+
+    connectionLayer->repaint();
+}
+
+void Canvas::updateOnScreenObjects()
+{
+    // Objects inside a graph are visible when the graph is
+    if (isGraph) {
+        auto* graphObject = findParentComponentOfClass<Object>();
+        bool graphIsOnScreen = graphObject && graphObject->isOnScreen();
+
+        for (auto* object : objects) {
+            object->setOnScreen(graphIsOnScreen);
+        }
+        return;
+    }
+
+    std::unordered_set<Object*> visibleObjects;
+    if (viewport && isShowing()) {
+        auto viewArea = viewport->getViewArea().transformedBy(getTransform().inverted());
+        for (auto* object : objectIndex.query(viewArea)) {
+            visibleObjects.insert(object);
+        }
+    }
+
+    for (auto* object : objects) {
+        object->setOnScreen(visibleObjects.count(object));
+    }
+}
+
+void Canvas::parentHierarchyChanged()
+{
+    // Called when we move to another tab or split
+    updateOnScreenObjects();
+}
+
+void Canvas::visibilityChanged()
+{
+    // Tabs get added before they're made visible, so the hierarchy change above can be too early
+    updateOnScreenObjects();
+}
+
 void Canvas::moved()
 {
 }
 
 void Canvas::resized()
 {
+    connectionLayer->setBounds(getLocalBounds());
 }
 
 void Canvas::updateOverlays()
@@ -286,12 +399,16 @@ void Canvas::paint(Graphics& g)
     if (isGraph)
         return;
 
-    g.fillAll(findColour(PlugDataColour::canvasBackgroundColourId));
-
     if (viewport)
         g.reduceClipRegion(viewport->getViewArea().transformedBy(getTransform().inverted()));
     auto clipBounds = g.getClipBounds();
 
+    if (getValue<bool>(locked)) {
+        g.fillAll(findColour(PlugDataColour::canvasBackgroundColourId));
+    } else {
+        paintGrid(g, clipBounds);
+    }
+
     // Clip bounds so that we have the smallest lines that fit the viewport, but also
     // compensate for line start, so the dashes don't stay fixed in place if they are drawn from
     // the top of the viewport
@@ -306,32 +423,16 @@ void Canvas::paint(Graphics& g)
     clippedOrigin.x += fmod(originDiff.x, 10.0f) - 0.5f;
     clippedOrigin.y += fmod(originDiff.y, 10.0f) - 0.5f;
 
-    if (!getValue<bool>(locked)) {
-
-        auto startX = (canvasOrigin.x % objectGrid.gridSize);
-        startX += ((clipBounds.getX() / objectGrid.gridSize) * objectGrid.gridSize);
-
-        auto startY = (canvasOrigin.y % objectGrid.gridSize);
-        startY += ((clipBounds.getY() / objectGrid.gridSize) * objectGrid.gridSize);
-
-        g.setColour(findColour(PlugDataColour::canvasDotsColourId));
-
-        for (int x = startX; x < clipBounds.getRight(); x += objectGrid.gridSize) {
-            for (int y = startY; y < clipBounds.getBottom(); y += objectGrid.gridSize) {
-
-                // Don't draw over origin line
-                if (showBorder || showOrigin) {
-                    if ((x == canvasOrigin.x && y >= canvasOrigin.y && y <= patchHeightCanvas) || (y == canvasOrigin.y && x >= canvasOrigin.x && x <= patchWidthCanvas))
-                        continue;
-                }
-                g.fillRect(static_cast<float>(x) - 0.5f, static_cast<float>(y) - 0.5f, 1.0, 1.0);
-            }
-        }
-    }
-
     if (!showOrigin && !showBorder)
         return;
 
+    // Don't draw dots over the origin lines
+    if (!getValue<bool>(locked)) {
+        g.setColour(findColour(PlugDataColour::canvasBackgroundColourId));
+        g.fillRect(Rectangle<float>(canvasOrigin.x - 0.5f, canvasOrigin.y - 0.5f, 1.0f, patchHeightCanvas - canvasOrigin.y + 1.0f));
+        g.fillRect(Rectangle<float>(canvasOrigin.x - 0.5f, canvasOrigin.y - 0.5f, patchWidthCanvas - canvasOrigin.x + 1.0f, 1.0f));
+    }
+
     /*
      ┌────────┐
      │a      b│
@@ -377,6 +478,45 @@ void Canvas::paint(Graphics& g)
     }
 }
 
+void Canvas::paintGrid(Graphics& g, Rectangle<int> area)
+{
+    auto backgroundColour = findColour(PlugDataColour::canvasBackgroundColourId);
+    auto dotsColour = findColour(PlugDataColour::canvasDotsColourId);
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    auto spacing = objectGrid.gridSize;
+
+    // Make the tile a multiple of the grid size, so the dots line up across tiles
+    auto tileSize = spacing * std::max(1, 128 / spacing);
+
+    if (gridTile.isNull() || gridTileScale != scale || gridTileSpacing != spacing || gridTileBackground != backgroundColour || gridTileDots != dotsColour) {
+        // Render at the physical resolution, so the dots stay sharp when zoomed in
+        auto imageSize = std::max(1, roundToInt(tileSize * scale));
+        gridTile = Image(Image::ARGB, imageSize, imageSize, true);
+
+        Graphics tileGraphics(gridTile);
+        tileGraphics.addTransform(AffineTransform::scale(imageSize / static_cast<float>(tileSize)));
+        tileGraphics.fillAll(backgroundColour);
+        tileGraphics.setColour(dotsColour);
+
+        // Dots on the edge of the tile are split in half, the other half is on the opposite edge
+        for (int x = 0; x <= tileSize; x += spacing) {
+            for (int y = 0; y <= tileSize; y += spacing) {
+                tileGraphics.fillRect(static_cast<float>(x) - 0.5f, static_cast<float>(y) - 0.5f, 1.0f, 1.0f);
+            }
+        }
+
+        gridTileScale = scale;
+        gridTileSpacing = spacing;
+        gridTileBackground = backgroundColour;
+        gridTileDots = dotsColour;
+    }
+
+    // Image fills repeat the image, starting at the canvas origin so the dots end up in the same place as the grid
+    auto imageScale = tileSize / static_cast<float>(gridTile.getWidth());
+    g.setFillType(FillType(gridTile, AffineTransform::scale(imageScale).translated(canvasOrigin.toFloat())));
+    g.fillRect(area);
+}
+
 TabComponent* Canvas::getTabbar()
 {
     for (auto* split : editor->splitView.splits) {
@@ -430,6 +570,12 @@ void Canvas::handleAsyncUpdate()
 }
 
 void Canvas::synchronise()
+{
+    needsFullSynchronise = true;
+    triggerAsyncUpdate();
+}
+
+void Canvas::synchroniseChanges()
 {
     triggerAsyncUpdate();
 }
@@ -452,50 +598,350 @@ void Canvas::performSynchronise()
     patch.setCurrent();
     pd->sendMessagesFromQueue();
 
+    // Find out what changed in pd since we last synchronised
+    std::vector<t_libpd_journal_event> changes;
+    bool canApplyChanges = journalPosition.has_value() && !needsFullSynchronise.exchange(false);
+
+    auto const journalHead = libpd_journal_head();
+    auto* cnv = patch.getPointer().get();
+    std::set<void*> removedObjects;
+
+    for (auto seq = journalPosition.value_or(journalHead); canApplyChanges && seq != journalHead; seq++) {
+        t_libpd_journal_event change;
+
+        // Changes were dropped, or were made in a way that we can't follow
+        if (!libpd_journal_get(seq, &change) || (change.type == LIBPD_JOURNAL_RESYNC && (!change.canvas || change.canvas == cnv))) {
+            canApplyChanges = false;
+            break;
+        }
+        if (change.canvas != cnv)
+            continue;
+
+        // An object that gets deleted and recreated at the same address can't be told apart from the old one
+        if (change.type == LIBPD_JOURNAL_DELETE || (change.type == LIBPD_JOURNAL_RETEXT && change.object != change.replacement)) {
+            removedObjects.insert(change.object);
+        }
+        if ((change.type == LIBPD_JOURNAL_CREATE && removedObjects.count(change.object)) || (change.type == LIBPD_JOURNAL_RETEXT && removedObjects.count(change.replacement))) {
+            canApplyChanges = false;
+            break;
+        }
+
+        changes.push_back(change);
+    }
+
+    journalPosition = journalHead;
+
     pd->unlockAudioThread();
 
-    // Remove deleted connections
-    for (int n = connections.size() - 1; n >= 0; n--) {
-        if (patch.connectionWasDeleted(connections[n]->getPointer())) {
-            connections.remove(n);
+    // If nothing was journaled, we were asked to synchronise because of a change that we don't know about
+    if (!canApplyChanges || changes.empty() || !applyChanges(changes)) {
+        synchroniseAll();
+    }
+
+    updateAfterSynchronise();
+}
+
+void Canvas::updateAfterSynchronise()
+{
+    if (!isGraph) {
+        setTransform(AffineTransform().scaled(getValue<float>(zoomScale)));
+    }
+
+    if (graphArea)
+        graphArea->updateBounds();
+
+    updateOnScreenObjects();
+
+    // Take the lock once, instead of once for every connection
+    pd->lockAudioThread();
+    Connection::updateCachedInfo(connections);
+    pd->unlockAudioThread();
+
+    editor->updateCommandStatus();
+    repaint();
+
+    // Graphs cache what their static objects look like, and which objects those are
+    if (auto* graphObject = isGraph ? dynamic_cast<ObjectBase*>(getParentComponent()) : nullptr)
+        graphObject->staticContentChanged();
+
+    pd->updateObjectImplementations();
+}
+
+// Applies changes from pd's journal, only touching the objects and connections that changed
+// Returns false if the journal didn't describe the changes well enough, in which case we need to compare everything
+bool Canvas::applyChanges(std::vector<t_libpd_journal_event> const& changes)
+{
+    // Look everything up through hash maps, so a batch takes linear time in the number of changes
+    std::unordered_map<void*, Object*> objectsByPointer;
+    objectsByPointer.reserve(objects.size());
+    for (auto* object : objects) {
+        if (auto* ptr = object->getPointer())
+            objectsByPointer[ptr] = object;
+    }
+
+    // Pointers to deleted objects have already been cleared, so also keep track of the pointer each object was created for
+    std::unordered_map<void*, Object*> objectsByCreatedPointer;
+    objectsByCreatedPointer.reserve(objects.size());
+    for (auto* object : objects) {
+        if (object->gui)
+            objectsByCreatedPointer[object->gui->ptr.getRawUnchecked<void>()] = object;
+    }
+
+    // Removing from the middle of our arrays shifts them, so everything that gets removed is removed in one pass at the end
+    std::unordered_set<Object*> removedObjects;
+    std::unordered_set<Connection*> removedConnections;
+
+    // Connections lose their pointer when pd deletes them, so remember which key each connection was stored under
+    std::unordered_map<void*, Connection*> connectionsByPointer;
+    std::unordered_map<Connection*, void*> connectionKeys;
+    connectionsByPointer.reserve(connections.size());
+    connectionKeys.reserve(connections.size());
+    for (auto* connection : connections) {
+        if (auto* ptr = connection->getPointer()) {
+            connectionsByPointer[ptr] = connection;
+            connectionKeys[connection] = ptr;
         }
     }
 
+    auto addConnection = [&connectionsByPointer, &connectionKeys](Connection* connection, void* ptr) {
+        connectionsByPointer[ptr] = connection;
+        connectionKeys[connection] = ptr;
+    };
+
+    auto findObject = [&objectsByPointer](void* ptr) -> Object* {
+        auto it = objectsByPointer.find(ptr);
+        return it != objectsByPointer.end() ? it->second : nullptr;
+    };
+
+    // Connections of removed objects are still around until the end, pd may have reused their pointer already
+    auto findConnection = [&connectionsByPointer, &removedObjects](void* ptr) -> Connection* {
+        auto it = connectionsByPointer.find(ptr);
+        if (it == connectionsByPointer.end() || removedObjects.count(it->second->inobj.get()) || removedObjects.count(it->second->outobj.get()))
+            return nullptr;
+
+        return it->second;
+    };
+
+    auto removeConnection = [&connectionsByPointer, &connectionKeys, &removedConnections](Connection* connection) {
+        if (auto it = connectionKeys.find(connection); it != connectionKeys.end()) {
+            connectionsByPointer.erase(it->second);
+            connectionKeys.erase(it);
+        }
+        removedConnections.insert(connection);
+    };
+
+    // Connections of removed objects are removed along with them at the end
+    auto removeObject = [this, &objectsByPointer, &objectsByCreatedPointer, &removedObjects](void* ptr) {
+        objectsByPointer.erase(ptr);
+
+        auto it = objectsByCreatedPointer.find(ptr);
+        if (it == objectsByCreatedPointer.end() || it->second->isInitialEditorShown())
+            return;
+
+        setSelected(it->second, false, false);
+        removedObjects.insert(it->second);
+        objectsByCreatedPointer.erase(it);
+    };
+
+    auto addObject = [this, &objectsByPointer, &objectsByCreatedPointer](void* ptr) {
+        auto* newBox = objects.add(new Object(ptr, this));
+        newBox->toFront(false);
+
+        if (newBox->gui && newBox->gui->getLabel())
+            newBox->gui->getLabel()->toFront(false);
+
+        objectsByPointer[ptr] = newBox;
+        objectsByCreatedPointer[ptr] = newBox;
+    };
+
+    auto updateObject = [](Object* object) {
+        object->updateIolets();
+        object->updateBounds();
+
+        if (object->gui)
+            object->gui->update();
+    };
+
+    for (auto const& change : changes) {
+        switch (change.type) {
+        case LIBPD_JOURNAL_CREATE: {
+            if (auto* object = findObject(change.object)) {
+                updateObject(object);
+            } else {
+                addObject(change.object);
+            }
+            break;
+        }
+        case LIBPD_JOURNAL_DELETE: {
+            removeObject(change.object);
+            break;
+        }
+        case LIBPD_JOURNAL_MOVE: {
+            if (auto* object = findObject(change.object)) {
+                object->updateBounds();
+            }
+            break;
+        }
+        case LIBPD_JOURNAL_RETEXT: {
+            if (auto* object = findObject(change.replacement)) {
+                updateObject(object);
+            } else if (change.replacement) {
+                removeObject(change.object);
+                addObject(change.replacement);
+            }
+            break;
+        }
+        case LIBPD_JOURNAL_CONNECT: {
+            // Connections are never shown inside a graph, so we don't create them there
+            if (isGraph)
+                break;
+
+            auto* outobj = findObject(change.src);
+            auto* inobj = findObject(change.sink);
+
+            // The journal refers to objects that we don't know about
+            if (!outobj || !inobj || !isPositiveAndBelow(outobj->numInputs + change.nout, outobj->iolets.size()) || !isPositiveAndBelow(change.nin, inobj->iolets.size())) {
+                return false;
+            }
+
+            auto* outlet = outobj->iolets[outobj->numInputs + change.nout];
+            auto* inlet = inobj->iolets[change.nin];
+
+            auto* existing = findConnection(change.object);
+
+            if (!existing) {
+                addConnection(connections.add(new Connection(this, inlet, outlet, change.object)), change.object);
+            } else if (existing->inlet != inlet || existing->outlet != outlet) {
+                int idx = connections.indexOf(existing);
+                removeConnection(existing);
+                addConnection(connections.insert(idx, new Connection(this, inlet, outlet, change.object)), change.object);
+            } else {
+                existing->popPathState();
+            }
+            break;
+        }
+        case LIBPD_JOURNAL_DISCONNECT: {
+            if (auto* existing = findConnection(change.object)) {
+                removeConnection(existing);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Connections that pd deleted without us seeing a matching event have lost their pointer
+    // Connections go first, since they refer to the iolets of the objects they connect
+    removeMatching(connections, [&removedObjects, &removedConnections](Connection* connection) {
+        return removedConnections.count(connection) || removedObjects.count(connection->inobj.get()) || removedObjects.count(connection->outobj.get()) || !connection->getPointer();
+    });
+
+    removeMatching(objects, [&removedObjects](Object* object) {
+        return removedObjects.count(object) > 0;
+    });
+
+    return true;
+}
+
+int Canvas::getNumFullSynchronisations() const
+{
+    return numFullSynchronisations;
+}
+
+void Canvas::synchroniseAll()
+{
+    auto content = patch.readContent();
+    journalPosition = content.journalPosition;
+    synchroniseWith(content);
+
+    // Other views of this patch that were about to synchronise can use what we just read
+    patch.shareContent(content, this);
+}
+
+// Called when another view of the same patch has read its content from pd
+void Canvas::synchroniseWithContent(pd::Patch::Content const& content)
+{
+    // Only take over synchronisations that were going to happen anyway
+    if (!isUpdatePending())
+        return;
+
+    // If we can follow the journal, that's cheaper than comparing everything, so we leave that to our own update
+    if (journalPosition.has_value() && !needsFullSynchronise)
+        return;
+
+    cancelPendingUpdate();
+    needsFullSynchronise = false;
+
+    // Anything that was journaled before the content was read is part of it
+    journalPosition = content.journalPosition;
+
+    synchroniseWith(content);
+    updateAfterSynchronise();
+}
+
+// Compares all objects and connections against pd
+// Everything is looked up through hash maps, so this takes linear time in the size of the patch
+void Canvas::synchroniseWith(pd::Patch::Content const& content)
+{
+    numFullSynchronisations++;
+
+    auto const& pdObjects = content.objects;
+    auto const& pdConnections = content.connections;
+
+    std::unordered_map<void*, size_t> pdObjectIndices;
+    pdObjectIndices.reserve(pdObjects.size());
+    for (size_t i = 0; i < pdObjects.size(); i++) {
+        pdObjectIndices[pdObjects[i]] = i;
+    }
+
+    std::unordered_set<void*> pdConnectionPointers;
+    pdConnectionPointers.reserve(pdConnections.size());
+    for (auto& connection : pdConnections) {
+        pdConnectionPointers.insert(std::get<0>(connection));
+    }
+
+    // Remove deleted connections
+    removeMatching(connections, [&pdConnectionPointers](Connection* connection) {
+        return !pdConnectionPointers.count(connection->getPointer());
+    });
+
     // Remove deleted objects
-    for (int n = objects.size() - 1; n >= 0; n--) {
-        auto* object = objects[n];
-        
+    removeMatching(objects, [this, &pdObjectIndices](Object* object) {
         // If the object is showing it's initial editor, meaning no object was assigned yet, allow it to exist without pointing to an object
-        if ((!object->getPointer()|| patch.objectWasDeleted(object->getPointer())) && !object->isInitialEditorShown()) {
+        if ((!object->getPointer() || !pdObjectIndices.count(object->getPointer())) && !object->isInitialEditorShown()) {
             setSelected(object, false, false);
-            objects.remove(n);
+            return true;
         }
-    }
+        return false;
+    });
 
     // Check for connections that need to be remade because of invalid iolets
-    for (int n = connections.size() - 1; n >= 0; n--) {
-        if (!connections[n]->inlet || !connections[n]->outlet) {
-            connections.remove(n);
-        }
-    }
+    removeMatching(connections, [](Connection* connection) {
+        return !connection->inlet || !connection->outlet;
+    });
 
-    auto pdObjects = patch.getObjects();
+    std::unordered_map<void*, Object*> objectsByPointer;
+    objectsByPointer.reserve(pdObjects.size());
+    for (auto* object : objects) {
+        if (auto* ptr = object->getPointer())
+            objectsByPointer[ptr] = object;
+    }
 
     for (auto* object : pdObjects) {
-        auto* it = std::find_if(objects.begin(), objects.end(), [&object](Object* b) { return b->getPointer() && b->getPointer() == object; });
-
-        if (patch.objectWasDeleted(object))
-            continue;
+        auto it = objectsByPointer.find(object);
 
-        if (it == objects.end()) {
+        if (it == objectsByPointer.end()) {
             auto* newBox = objects.add(new Object(object, this));
             newBox->toFront(false);
 
             // TODO: don't do this on Canvas!!
             if (newBox->gui && newBox->gui->getLabel())
                 newBox->gui->getLabel()->toFront(false);
+
+            objectsByPointer[object] = newBox;
         } else {
-            auto* object = *it;
+            auto* object = it->second;
 
             // Check if number of inlets/outlets is correct
             object->updateIolets();
@@ -509,16 +955,26 @@ void Canvas::performSynchronise()
         }
     }
 
-    // Make sure objects have the same order
-    std::sort(objects.begin(), objects.end(),
-        [&pdObjects](Object* first, Object* second) mutable {
-            size_t idx1 = std::find(pdObjects.begin(), pdObjects.end(), first->getPointer()) - pdObjects.begin();
-            size_t idx2 = std::find(pdObjects.begin(), pdObjects.end(), second->getPointer()) - pdObjects.begin();
+    // Make sure objects have the same order, objects that pd doesn't know about go last
+    auto getIndex = [&pdObjectIndices](Object* object) {
+        auto it = pdObjectIndices.find(object->getPointer());
+        return it != pdObjectIndices.end() ? it->second : pdObjectIndices.size();
+    };
 
-            return idx1 < idx2;
+    std::sort(objects.begin(), objects.end(),
+        [&getIndex](Object* first, Object* second) {
+            return getIndex(first) < getIndex(second);
         });
 
-    auto pdConnections = patch.getConnections();
+    // Connections are never shown inside a graph, so we don't create them there
+    if (isGraph)
+        return;
+
+    std::unordered_map<void*, Connection*> connectionsByPointer;
+    connectionsByPointer.reserve(connections.size());
+    for (auto* connection : connections) {
+        connectionsByPointer[connection->getPointer()] = connection;
+    }
 
     for (auto& connection : pdConnections) {
         auto& [ptr, inno, inobj, outno, outobj] = connection;
@@ -526,25 +982,15 @@ void Canvas::performSynchronise()
         Iolet *inlet = nullptr, *outlet = nullptr;
 
         // Find the objects that this connection is connected to
-        for (auto* obj : objects) {
-            if (outobj && outobj == obj->getPointer()) {
-
-                // Check if we have enough outlets, should never return false
-                if (isPositiveAndBelow(obj->numInputs + outno, obj->iolets.size())) {
-                    outlet = obj->iolets[obj->numInputs + outno];
-                } else {
-                    break;
-                }
-            }
-            if (inobj && inobj == obj->getPointer()) {
+        // Check if we have enough iolets, should never fail
+        auto outIt = objectsByPointer.find(outobj);
+        if (outobj && outIt != objectsByPointer.end() && isPositiveAndBelow(outIt->second->numInputs + outno, outIt->second->iolets.size())) {
+            outlet = outIt->second->iolets[outIt->second->numInputs + outno];
+        }
 
-                // Check if we have enough inlets, should never return false
-                if (isPositiveAndBelow(inno, obj->iolets.size())) {
-                    inlet = obj->iolets[inno];
-                } else {
-                    break;
-                }
-            }
+        auto inIt = objectsByPointer.find(inobj);
+        if (inobj && inIt != objectsByPointer.end() && isPositiveAndBelow(inno, inIt->second->iolets.size())) {
+            inlet = inIt->second->iolets[inno];
         }
 
         // This shouldn't be necessary, but just to be sure...
@@ -553,39 +999,24 @@ void Canvas::performSynchronise()
             continue;
         }
 
-        auto* it = std::find_if(connections.begin(), connections.end(),
-            [c_ptr = ptr](auto* c) {
-                return c_ptr == c->getPointer();
-            });
+        auto it = connectionsByPointer.find(ptr);
 
-        if (it == connections.end()) {
+        if (it == connectionsByPointer.end()) {
             connections.add(new Connection(this, inlet, outlet, ptr));
         } else {
-            auto& c = *(*it);
+            auto& c = *it->second;
 
             // This is necessary to make resorting a subpatchers iolets work
             // And it can't hurt to check if the connection is valid anyway
             if (c.inlet != inlet || c.outlet != outlet) {
-                int idx = connections.indexOf(*it);
-                connections.removeObject(*it);
+                int idx = connections.indexOf(it->second);
+                connections.removeObject(it->second);
                 connections.insert(idx, new Connection(this, inlet, outlet, ptr));
             } else {
                 c.popPathState();
             }
         }
     }
-
-    if (!isGraph) {
-        setTransform(AffineTransform().scaled(getValue<float>(zoomScale)));
-    }
-
-    if (graphArea)
-        graphArea->updateBounds();
-
-    editor->updateCommandStatus();
-    repaint();
-
-    pd->updateObjectImplementations();
 }
 
 void Canvas::updateDrawables()
@@ -695,7 +1126,7 @@ void Canvas::mouseDrag(MouseEvent const& e)
         bool hasToggled = false;
 
         // Behaviour for dragging over toggles, bang and radiogroup to toggle them
-        for (auto* object : objects) {
+        for (auto* object : objectIndex.query(e.getEventRelativeTo(this).getPosition())) {
             if (!object->getBounds().contains(e.getEventRelativeTo(this).getPosition()) || !object->gui)
                 continue;
 
@@ -1177,7 +1608,7 @@ void Canvas::removeSelection()
     deselectAll();
 
     // Load state from pd
-    synchronise();
+    synchroniseChanges();
     handleUpdateNowIfNeeded();
 
     patch.deselectAll();
@@ -1198,7 +1629,7 @@ void Canvas::removeSelectedConnections()
     patch.endUndoSequence("Remove Connections");
 
     // Load state from pd
-    synchronise();
+    synchroniseChanges();
     handleUpdateNowIfNeeded();
 
     synchroniseSplitCanvas();
@@ -1369,7 +1800,7 @@ bool Canvas::connectSelectedObjects()
         patch.createConnection(topObject, 0, bottomObject, 0);
     }
 
-    synchronise();
+    synchroniseChanges();
 
     return true;
 }
@@ -1548,7 +1979,7 @@ void Canvas::undo()
     patch.undo();
 
     // Load state from pd
-    synchronise();
+    synchroniseChanges();
     handleUpdateNowIfNeeded();
 
     patch.deselectAll();
@@ -1563,7 +1994,7 @@ void Canvas::redo()
     patch.redo();
 
     // Load state from pd
-    synchronise();
+    synchroniseChanges();
     handleUpdateNowIfNeeded();
 
     patch.deselectAll();
@@ -1595,6 +2026,8 @@ void Canvas::valueChanged(Value& v)
         auto oldPosition = getLocalPoint(nullptr, mousePosition);
         // Apply transform and make sure viewport bounds get updated
         setTransform(AffineTransform().scaled(newScaleFactor));
+        updateDetailLevel();
+        updateOnScreenObjects();
         // After zooming, get mouse position relative to canvas again
         auto newPosition = getLocalPoint(nullptr, mousePosition);
         // Calculate offset to keep our mouse position the same as before this zoom action
@@ -1630,17 +2063,12 @@ void Canvas::valueChanged(Value& v)
 
         // move all connections to back when canvas is locked
         if (locked == var(true)) {
-            // use reverse order to preserve correct connection layering
-            for (int i = connections.size() - 1; i >= 0; i--) {
-                connections[i]->setAlwaysOnTop(false);
-                connections[i]->toBack();
-            }
+            connectionLayer->setAlwaysOnTop(false);
+            connectionLayer->toBack();
         } else {
             // otherwise move all connections to front
-            for (auto connection : connections) {
-                connection->setAlwaysOnTop(true);
-                connection->toFront(false);
-            }
+            connectionLayer->setAlwaysOnTop(true);
+            connectionLayer->toFront(false);
         }
 
         repaint();
@@ -1758,26 +2186,35 @@ bool Canvas::setPanDragMode(bool shouldPan)
 
 void Canvas::findLassoItemsInArea(Array<WeakReference<Component>>& itemsFound, Rectangle<int> const& area)
 {
-    for (auto* object : objects) {
+    bool const keepSelection = ModifierKeys::getCurrentModifiers().isAnyModifierKeyDown();
+    std::unordered_set<Component*> found;
+
+    // The selectable bounds are always inside the object's bounds
+    for (auto* object : objectIndex.query(area)) {
         if (area.intersects(object->getSelectableBounds())) {
             itemsFound.add(object);
-        } else if (!ModifierKeys::getCurrentModifiers().isAnyModifierKeyDown()) {
-            setSelected(object, false, false);
+            found.insert(object);
         }
     }
 
-    for (auto& con : connections) {
-        // If total bounds don't intersect, there can't be an intersection with the line
-        // This is cheaper than checking the path intersection, so do this first
-        if (!con->getBounds().intersects(lasso.getBounds())) {
-            setSelected(con, false, false);
-            continue;
-        }
-
+    // If total bounds don't intersect, there can't be an intersection with the line
+    for (auto* con : connectionIndex.query(lasso.getBounds())) {
         // Check if path intersects with lasso
         if (con->intersects(lasso.getBounds().toFloat())) {
             itemsFound.add(con);
-        } else if (!ModifierKeys::getCurrentModifiers().isAnyModifierKeyDown()) {
+            found.insert(con);
+        }
+    }
+
+    // Only items that are already selected can need deselecting, so we don't have to look at the rest of the canvas
+    for (auto* object : getSelectionOfType<Object>()) {
+        if (!keepSelection && !found.count(object)) {
+            setSelected(object, false, false);
+        }
+    }
+
+    for (auto* con : getSelectionOfType<Connection>()) {
+        if (!found.count(con) && (!keepSelection || !con->getBounds().intersects(lasso.getBounds()))) {
             setSelected(con, false, false);
         }
     }
@@ -1820,8 +2257,14 @@ void Canvas::receiveMessage(String const& symbol, int argc, t_atom* argv)
     case hash("clear"):
     case hash("cut"):
     case hash("disconnect"): {
+        // Changes that pd makes by itself aren't journaled, so they add a resync to the journal
+        // Changes made through plugdata are journaled, so we only need to apply what changed
+        if (auto cnv = patch.getPointer()) {
+            libpd_journal_resync(cnv.get());
+        }
+
         // This will trigger an asyncupdater, so it's thread-safe to do this here
-        synchronise();
+        synchroniseChanges();
         break;
     }
     case hash("editmode"): {
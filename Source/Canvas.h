@@ -8,6 +8,7 @@
 
 #include "ObjectGrid.h"          // move to impl
 #include "Utility/RateReducer.h" // move to impl
+#include "Utility/SpatialIndex.h"
 #include "Utility/ModifierKeyListener.h"
 #include "Utility/CheckedTooltip.h"
 #include "Pd/MessageListener.h"
@@ -27,8 +28,11 @@ class Connection;
 class PluginEditor;
 class PluginProcessor;
 class ConnectionPathUpdater;
+class ConnectionRouter;
+class ConnectionLayer;
 class ConnectionBeingCreated;
 class TabComponent;
+struct _libpd_journal_event;
 
 struct ObjectDragState {
     bool wasDragDuplicated = false;
@@ -48,6 +52,7 @@ class Canvas : public Component
     , public ModifierKeyListener
     , public FocusChangeListener
     , public pd::MessageListener
+    , public pd::Patch::View
     , public AsyncUpdater {
 public:
     Canvas(PluginEditor* parent, pd::Patch::Ptr patch, Component* parentGraph = nullptr);
@@ -81,13 +86,41 @@ public:
     int getOverlays() const;
     void updateOverlays();
 
+    // How much detail objects and connections should draw, depending on the zoom level
+    // Reduced skips text and activity overlays, Minimal also hides GUIs and only draws object silhouettes
+    // Canvases inside a graph-on-parent follow the detail level of the canvas they're shown on
+    enum class DetailLevel {
+        Full,
+        Reduced,
+        Minimal
+    };
+
+    DetailLevel getDetailLevel() const;
+
     void synchroniseSplitCanvas();
+
+    // Compares everything against pd, for changes that pd's journal doesn't describe
     void synchronise();
+
+    // Only applies the changes in pd's journal, for edits that were made through pd::Patch
+    void synchroniseChanges();
+
     void performSynchronise();
+    bool applyChanges(std::vector<_libpd_journal_event> const& changes);
+    void synchroniseAll();
+    void synchroniseWithContent(pd::Patch::Content const& content) override;
+
+    // How often we had to compare everything against pd, for benchmarking
+    int getNumFullSynchronisations() const;
     void handleAsyncUpdate() override;
 
     void updateDrawables();
 
+    // Tells objects whether they're visible, based on the viewport area and whether this canvas is showing
+    void updateOnScreenObjects();
+    void parentHierarchyChanged() override;
+    void visibilityChanged() override;
+
     bool keyPressed(KeyPress const& key) override;
     void valueChanged(Value& v) override;
 
@@ -171,6 +204,18 @@ public:
     // Needs to be allocated before object and connection so they can deselect themselves in the destructor
     SelectedItemSet<WeakReference<Component>> selectedComponents;
 
+    // Bounds of all objects and connections, for looking up what's in an area of the canvas
+    // Also needs to be allocated before objects and connections, they remove themselves in the destructor
+    SpatialIndex<Object> objectIndex;
+    SpatialIndex<Connection> connectionIndex;
+
+    // Finds cable routes in the background, connections cancel their requests when they are deleted
+    // Shared between all canvases, so nested and open canvases don't each start a routing thread
+    SharedResourcePointer<ConnectionRouter> connectionRouter;
+
+    // Paints all connections and passes mouse events on to them, needs to outlive the connections
+    std::unique_ptr<ConnectionLayer> connectionLayer;
+
     OwnedArray<Object> objects;
     OwnedArray<Connection> connections;
     OwnedArray<ConnectionBeingCreated> connectionsBeingCreated;
@@ -224,8 +269,35 @@ public:
 private:
     LassoComponent<WeakReference<Component>> lasso;
 
+    // How far we've read pd's change journal, empty until the first synchronisation
+    std::optional<unsigned int> journalPosition;
+
+    // Set when we were asked to synchronise because of a change that isn't journaled
+    std::atomic<bool> needsFullSynchronise = false;
+    int numFullSynchronisations = 0;
+
     RateReducer canvasRateReducer = RateReducer(90);
 
+    void updateDetailLevel();
+
+    void synchroniseWith(pd::Patch::Content const& content);
+    void updateAfterSynchronise();
+
+    DetailLevel detailLevel = DetailLevel::Full;
+    Canvas* parentCanvas = nullptr; // Canvas that this graph is shown on
+    static inline constexpr float reducedDetailScale = 0.5f;
+    static inline constexpr float minimalDetailScale = 0.3f;
+
+    // Fills an area of the canvas with the background and grid dots
+    void paintGrid(Graphics& g, Rectangle<int> area);
+
+    // The dot grid repeats itself, so one cached tile can be used for the whole canvas
+    // It gets rendered again when the zoom level, grid size or colours change
+    Image gridTile;
+    float gridTileScale = 0.0f;
+    int gridTileSpacing = 0;
+    Colour gridTileBackground, gridTileDots;
+
     // Properties that can be shown in the inspector by right-clicking on canvas
     ObjectParameters parameters;
 
@@ -374,6 +374,12 @@ public:
         adjustScrollbarBounds();
     }
 
+    // Switching tabs shows or hides the viewport, the canvas inside it doesn't get notified of that
+    void visibilityChanged() override
+    {
+        cnv->updateOnScreenObjects();
+    }
+
     void resized() override
     {
         vbar.setVisible(isVerticalScrollBarShown());
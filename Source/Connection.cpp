@@ -17,6 +17,7 @@
 #include "LookAndFeel.h"
 #include "Pd/Patch.h"
 #include "Dialogs/ConnectionMessageDisplay.h"
+#include "Utility/ConnectionRouter.h"
 
 Connection::Connection(Canvas* parent, Iolet* s, Iolet* e, void* oc)
     : cnv(parent)
@@ -61,13 +62,6 @@ Connection::Connection(Canvas* parent, Iolet* s, Iolet* e, void* oc)
     outlet->addComponentListener(this);
     inlet->addComponentListener(this);
 
-    setInterceptsMouseClicks(true, true);
-
-    addMouseListener(cnv, true);
-
-    cnv->addAndMakeVisible(this);
-    setAlwaysOnTop(true);
-
     // Update position (TODO: don't invoke virtual functions from constructor!)
     componentMovedOrResized(*outlet, true, true);
     componentMovedOrResized(*inlet, true, true);
@@ -81,6 +75,9 @@ Connection::~Connection()
 {
     cnv->pd->unregisterMessageListener(ptr.getRawUnchecked<void>(), this);
     cnv->selectedComponents.removeChangeListener(this);
+    cnv->connectionIndex.remove(this);
+    cnv->connectionRouter->cancel(this);
+    cnv->connectionLayer->repaint(getBounds());
 
     if (outlet) {
         outlet->repaint();
@@ -109,6 +106,7 @@ void Connection::valueChanged(Value& v)
 {
     if (v.refersToSameSourceAs(presentationMode)) {
         setVisible(presentationMode != var(true) && !cnv->isGraph);
+        repaintLayer();
     }
 }
 
@@ -116,7 +114,7 @@ void Connection::lookAndFeelChanged()
 {
     updatePath();
     resizeToFit();
-    repaint();
+    repaintLayer();
 }
 
 void Connection::pushPathState()
@@ -223,7 +221,7 @@ bool Connection::hitTest(int x, int y)
     auto pend = getEndPoint();
 
     if (selectedFlag && (startReconnectHandle.contains(position) || endReconnectHandle.contains(position))) {
-        repaint();
+        repaintLayer();
         return true;
     }
 
@@ -389,14 +387,14 @@ void Connection::updateOverlays(int overlay)
     showActiveState = overlay & Overlay::ActivationState;
     updatePath();
     resizeToFit();
-    repaint();
+    repaintLayer();
 }
 
 void Connection::forceUpdate()
 {
     updatePath();
     resizeToFit();
-    repaint();
+    repaintLayer();
 }
 
 void Connection::paint(Graphics& g)
@@ -405,11 +403,11 @@ void Connection::paint(Graphics& g)
         cnv,
         toDrawLocalSpace,
         outlet != nullptr && outlet->isSignal,
-        isMouseOver(),
+        isHovering,
         showDirection,
         showConnectionOrder,
         selectedFlag,
-        getMouseXYRelative(),
+        cnv->connectionLayer->getMousePositionRelativeTo(this),
         isHovering,
         getNumberOfConnections(),
         getMultiConnectNumber(),
@@ -427,7 +425,7 @@ void Connection::paint(Graphics& g)
     /* ENABLE_CONNECTION_GRAPHICS_DEBUGGING
         g.setColour(Colours::orange);
         for (auto& point : currentPlan) {
-            auto local = getLocalPoint(cnv, point);
+            auto local = point - getPosition().toFloat();
             g.fillEllipse(local.x, local.y, 2, 2);
         }
 
@@ -446,7 +444,7 @@ void Connection::setSegmented(bool isSegmented)
     segmented = isSegmented;
     updatePath();
     resizeToFit();
-    repaint();
+    repaintLayer();
     pushPathState();
 }
 
@@ -456,7 +454,7 @@ void Connection::setSelected(bool shouldBeSelected)
         selectedFlag = shouldBeSelected;
         updatePath();
         resizeToFit();
-        repaint();
+        repaintLayer();
     }
 }
 
@@ -483,7 +481,7 @@ void Connection::mouseMove(MouseEvent const& e)
         setMouseCursor(MouseCursor::NormalCursor);
     }
 
-    repaint();
+    repaintLayer();
 }
 
 StringArray Connection::getMessageFormated()
@@ -529,15 +527,15 @@ void Connection::mouseEnter(MouseEvent const& e)
 {
     isHovering = true;
     if (!outlet->isSignal)
-        cnv->editor->connectionMessageDisplay->setConnection(this, e.getScreenPosition());
-    repaint();
+        cnv->editor->connectionMessageDisplay->setConnection(this, e.source.getScreenPosition().roundToInt());
+    repaintLayer();
 }
 
 void Connection::mouseExit(MouseEvent const& e)
 {
     cnv->editor->connectionMessageDisplay->setConnection(nullptr);
     isHovering = false;
-    repaint();
+    repaintLayer();
 }
 
 void Connection::mouseDown(MouseEvent const& e)
@@ -550,7 +548,7 @@ void Connection::mouseDown(MouseEvent const& e)
     }
 
     cnv->setSelected(this, true);
-    repaint();
+    repaintLayer();
 
     if (currentPlan.size() <= 2)
         return;
@@ -597,10 +595,9 @@ void Connection::mouseDrag(MouseEvent const& e)
             currentPlan[n].y = mouseDownPosition + delta.y;
         }
 
-        setBufferedToImage(false);
         updatePath();
         resizeToFit();
-        repaint();
+        repaintLayer();
     }
 }
 
@@ -641,7 +638,7 @@ int Connection::getClosestLineIdx(Point<float> const& position, PathPlan const&
         auto line = Line<float>(plan[n - 1], plan[n]);
         Point<float> nearest;
 
-        if (line.getDistanceFromPoint(cnv->getLocalPoint(this, position), nearest) < 3) {
+        if (line.getDistanceFromPoint(position + getPosition().toFloat(), nearest) < 3) {
             return n;
         }
     }
@@ -705,17 +702,28 @@ void Connection::resizeToFit()
         newBounds = newBounds.getUnion(toDraw.getBounds().expanded(safteyMargin).getSmallestIntegerContainer());
     }
     if (newBounds != getBounds()) {
+        // Clear the area we're leaving, the caller repaints the new area
+        repaintLayer();
         setBounds(newBounds);
     }
 
     toDrawLocalSpace = toDraw;
-    auto offset = getLocalPoint(cnv, Point<int>());
-    toDrawLocalSpace.applyTransform(AffineTransform::translation(offset));
+    toDrawLocalSpace.applyTransform(AffineTransform::translation(-getPosition()));
 
     startReconnectHandle = Rectangle<float>(5, 5).withCentre(toDrawLocalSpace.getPointAlongPath(8.5f));
     endReconnectHandle = Rectangle<float>(5, 5).withCentre(toDrawLocalSpace.getPointAlongPath(std::max(toDrawLocalSpace.getLength() - 8.5f, 9.5f)));
 }
 
+void Connection::moved()
+{
+    cnv->connectionIndex.update(this, getBounds());
+}
+
+void Connection::resized()
+{
+    cnv->connectionIndex.update(this, getBounds());
+}
+
 void Connection::componentMovedOrResized(Component& component, bool wasMoved, bool wasResized)
 {
     if (!inlet || !outlet)
@@ -734,11 +742,11 @@ void Connection::componentMovedOrResized(Component& component, bool wasMoved, bo
         if (pointOffset.isOrigin())
             return;
 
-        // as we are moving the whole component, no need to redraw
-        setBufferedToImage(true);
-
+        // as we are moving the whole connection, the path in local space stays the same
         previousPStart = pstart;
+        repaintLayer();
         setTopLeftPosition(getPosition() + pointOffset.toInt());
+        repaintLayer();
 
         for (auto& point : currentPlan) {
             point += pointOffset;
@@ -748,17 +756,10 @@ void Connection::componentMovedOrResized(Component& component, bool wasMoved, bo
     }
     previousPStart = pstart;
 
-    // if buffered to image is true here it will take longer to redraw & buffer,
-    // and cause wiggling of cables, also greatly improves performance
-    //
-    // we may need to turn it off in other parts of this class,
-    // if getCachedComponentImage() returns true setBufferedToImage is on
-    setBufferedToImage(false);
-
     if (currentPlan.size() <= 2) {
         updatePath();
         resizeToFit();
-        repaint();
+        repaintLayer();
         return;
     }
 
@@ -785,7 +786,12 @@ void Connection::componentMovedOrResized(Component& component, bool wasMoved, bo
 
     updatePath();
     resizeToFit();
-    repaint();
+    repaintLayer();
+}
+
+void Connection::repaintLayer()
+{
+    cnv->connectionLayer->repaint(getBounds());
 }
 
 Point<float> Connection::getStartPoint() const
@@ -829,39 +835,48 @@ Path Connection::getNonSegmentedPath(Point<float> start, Point<float> end)
 
 int Connection::getNumberOfConnections()
 {
-    int count = 0;
-    for (auto* connection : cnv->connections) {
-        if (outlet == connection->outlet) {
-            count++;
-        }
-    }
-    return count;
+    return numberOfConnections;
 }
 
 int Connection::getMultiConnectNumber()
 {
-    int count = 0;
-    for (auto* connection : cnv->connections) {
-        if (outlet == connection->outlet) {
-            count++;
-            if (this == connection)
-                return count;
-        }
-    }
-    return -1;
+    return multiConnectNumber;
 }
 
 int Connection::getNumSignalChannels()
 {
-    if (auto oc = ptr.get<t_outconnect>()) {
-        return outconnect_get_num_channels(oc.get());
+    return numSignalChannels;
+}
+
+void Connection::updateCachedInfo(OwnedArray<Connection> const& connections)
+{
+    std::unordered_map<Iolet*, int> connectionsPerOutlet;
+    for (auto* connection : connections) {
+        connection->multiConnectNumber = ++connectionsPerOutlet[connection->outlet.get()];
     }
 
-    if (outlet) {
-        return outlet->isSignal ? 1 : 0;
+    for (auto* connection : connections) {
+        connection->numberOfConnections = connectionsPerOutlet[connection->outlet.get()];
     }
 
-    return 0;
+    updateNumSignalChannels(connections);
+}
+
+void Connection::updateNumSignalChannels(OwnedArray<Connection> const& connections)
+{
+    for (auto* connection : connections) {
+        int numChannels;
+        if (auto oc = connection->ptr.get<t_outconnect>()) {
+            numChannels = outconnect_get_num_channels(oc.get());
+        } else {
+            numChannels = connection->outlet && connection->outlet->isSignal ? 1 : 0;
+        }
+
+        if (numChannels != connection->numSignalChannels) {
+            connection->numSignalChannels = numChannels;
+            connection->repaint();
+        }
+    }
 }
 
 void Connection::updatePath()
@@ -915,7 +930,7 @@ void Connection::applyBestPath()
     findPath();
     updatePath();
     resizeToFit();
-    repaint();
+    repaintLayer();
 }
 
 void Connection::findPath()
@@ -926,172 +941,62 @@ void Connection::findPath()
     auto pstart = getStartPoint();
     auto pend = getEndPoint();
 
-    auto pathStack = PathPlan();
-    auto bestPath = PathPlan();
-
-    pathStack.reserve(8);
-
-    auto numFound = 0;
-
-    float incrementX, incrementY;
+    // Every object around the cable is an obstacle, apart from the ones it's connected to
+    std::vector<Rectangle<float>> obstacles;
+    auto searchBounds = Rectangle<float>(pstart, pend).expanded(routingMargin);
 
-    auto distance = pstart.getDistanceFrom(pend);
-    auto distanceX = std::abs(pstart.x - pend.x);
-    auto distanceY = std::abs(pstart.y - pend.y);
-
-    int maxXResolution = std::clamp<int>(distanceX / 10, 6, 14);
-    int maxYResolution = std::clamp<int>(distanceY / 10, 6, 14);
-
-    int resolutionX = 6;
-    int resolutionY = 6;
-
-    auto obstacles = Array<Rectangle<float>>();
-    auto searchBounds = Rectangle<float>(pstart, pend);
-
-    for (auto* object : cnv->objects) {
-        if (object->getBounds().toFloat().intersects(searchBounds)) {
-            obstacles.add(object->getBounds().toFloat());
+    for (auto* object : cnv->objectIndex.query(searchBounds.getSmallestIntegerContainer())) {
+        if (object != outobj && object != inobj) {
+            obstacles.push_back(object->getBounds().toFloat().expanded(1));
         }
     }
 
-    // Look for paths at an increasing resolution
-    while (!numFound && resolutionX < maxXResolution && distance > 40) {
-
-        // Find paths on a resolution*resolution lattice ObjectGrid
-        incrementX = std::max<float>(1, distanceX / resolutionX);
-        incrementY = std::max<float>(1, distanceY / resolutionY);
-
-        numFound = findLatticePaths(bestPath, pathStack, pend, pstart, { incrementX, incrementY });
-
-        if (resolutionX < maxXResolution)
-            resolutionX++;
-        if (resolutionY < maxXResolution)
-            resolutionY++;
-
-        if (resolutionX > maxXResolution || resolutionY > maxYResolution)
-            break;
-
-        pathStack.clear();
-    }
-
-    PathPlan simplifiedPath;
-
-    bool direction;
-    if (!bestPath.empty()) {
-        simplifiedPath.push_back(bestPath.front());
-
-        direction = bestPath[0].x == bestPath[1].x;
-
-        if (!direction)
-            simplifiedPath.push_back(bestPath.front());
-
-        for (int n = 1; n < bestPath.size(); n++) {
-            if ((bestPath[n].x != bestPath[n - 1].x && direction) || (bestPath[n].y != bestPath[n - 1].y && !direction)) {
-                simplifiedPath.push_back(bestPath[n - 1]);
-                direction = !direction;
-            }
-        }
+    auto onRouteFound = [_this = SafePointer(this), pstart, pend](PathPlan const& route) {
+        // The cable was moved, deleted or unsegmented while we were searching
+        if (!_this || !_this->segmented || _this->getStartPoint() != pstart || _this->getEndPoint() != pend)
+            return;
 
-        simplifiedPath.push_back(bestPath.back());
+        _this->currentPlan = route.empty() ? getDefaultPlan(pstart, pend) : route;
+        _this->pushPathState();
+        _this->updatePath();
+        _this->resizeToFit();
+        _this->repaintLayer();
+    };
 
-        if (!direction)
-            simplifiedPath.push_back(bestPath.back());
-    } else {
-        if (pend.y < pstart.y) {
-            int xHalfDistance = (pstart.x - pend.x) / 2;
-
-            simplifiedPath.push_back(pend); // double to make it draggable
-            simplifiedPath.push_back(pend);
-            simplifiedPath.emplace_back(pend.x + xHalfDistance, pend.y);
-            simplifiedPath.emplace_back(pend.x + xHalfDistance, pstart.y);
-            simplifiedPath.push_back(pstart);
-            simplifiedPath.push_back(pstart);
-        } else {
-            int yHalfDistance = (pstart.y - pend.y) / 2;
-            simplifiedPath.push_back(pend);
-            simplifiedPath.emplace_back(pend.x, pend.y + yHalfDistance);
-            simplifiedPath.emplace_back(pstart.x, pend.y + yHalfDistance);
-            simplifiedPath.push_back(pstart);
-        }
+    PathPlan cachedRoute;
+    if (cnv->connectionRouter->findRoute(this, pstart, pend, std::move(obstacles), onRouteFound, cachedRoute)) {
+        currentPlan = cachedRoute.empty() ? getDefaultPlan(pstart, pend) : cachedRoute;
+        pushPathState();
+    } else if (currentPlan.empty()) {
+        // Show a simple path until the router is done
+        currentPlan = getDefaultPlan(pstart, pend);
     }
-    std::reverse(simplifiedPath.begin(), simplifiedPath.end());
-
-    currentPlan = simplifiedPath;
-
-    pushPathState();
 }
 
-int Connection::findLatticePaths(PathPlan& bestPath, PathPlan& pathStack, Point<float> pstart, Point<float> pend, Point<float> increment)
+PathPlan Connection::getDefaultPlan(Point<float> pstart, Point<float> pend)
 {
+    PathPlan simplifiedPath;
 
-    auto obstacles = Array<Object*>();
-    auto searchBounds = Rectangle<float>(pstart, pend);
-
-    for (auto* object : cnv->objects) {
-        if (object->getBounds().toFloat().intersects(searchBounds)) {
-            obstacles.add(object);
-        }
-    }
-
-    // Stop after we've found a path
-    if (!bestPath.empty())
-        return 0;
-
-    // Add point to path
-    pathStack.push_back(pstart);
-
-    // Check if it intersects any object
-    if (pathStack.size() > 1 && straightLineIntersectsObject(Line<float>(pathStack.back(), *(pathStack.end() - 2)), obstacles)) {
-        return 0;
-    }
-
-    bool endVertically = pathStack[0].y > pend.y;
-
-    // Check if we've reached the destination
-    if (std::abs(pstart.x - pend.x) < (increment.x * 0.5) && std::abs(pstart.y - pend.y) < (increment.y * 0.5)) {
-        bestPath = pathStack;
-        return 1;
-    }
-
-    // Count the number of found paths
-    int count = 0;
-
-    // Get current stack to revert to after each trial
-    auto pathCopy = pathStack;
-
-    auto followLine = [this, &count, &pathCopy, &bestPath, &pathStack, &increment](Point<float> currentOutlet, Point<float> currentInlet, bool isX) {
-        auto& coord1 = isX ? currentOutlet.x : currentOutlet.y;
-        auto& coord2 = isX ? currentInlet.x : currentInlet.y;
-        auto& incr = isX ? increment.x : increment.y;
-
-        if (std::abs(coord1 - coord2) >= incr) {
-            coord1 > coord2 ? coord1 -= incr : coord1 += incr;
-            count += findLatticePaths(bestPath, pathStack, currentOutlet, currentInlet, increment);
-            pathStack = pathCopy;
-        }
-    };
+    if (pend.y < pstart.y) {
+        int xHalfDistance = (pstart.x - pend.x) / 2;
 
-    // If we're halfway on the axis, change preferred direction by inverting search order
-    // This will make it do a staircase effect
-    if (endVertically) {
-        if (std::abs(pstart.y - pend.y) >= std::abs(pathStack[0].y - pend.y) * 0.5) {
-            followLine(pstart, pend, false);
-            followLine(pstart, pend, true);
-        } else {
-            followLine(pstart, pend, true);
-            followLine(pstart, pend, false);
-        }
+        simplifiedPath.push_back(pend); // double to make it draggable
+        simplifiedPath.push_back(pend);
+        simplifiedPath.emplace_back(pend.x + xHalfDistance, pend.y);
+        simplifiedPath.emplace_back(pend.x + xHalfDistance, pstart.y);
+        simplifiedPath.push_back(pstart);
+        simplifiedPath.push_back(pstart);
     } else {
-        if (std::abs(pstart.x - pend.x) >= std::abs(pathStack[0].x - pend.x) * 0.5) {
-            followLine(pstart, pend, true);
-            followLine(pstart, pend, false);
-        } else {
-            followLine(pstart, pend, false);
-            followLine(pstart, pend, true);
-        }
+        int yHalfDistance = (pstart.y - pend.y) / 2;
+        simplifiedPath.push_back(pend);
+        simplifiedPath.emplace_back(pend.x, pend.y + yHalfDistance);
+        simplifiedPath.emplace_back(pstart.x, pend.y + yHalfDistance);
+        simplifiedPath.push_back(pstart);
     }
 
-    return count;
+    std::reverse(simplifiedPath.begin(), simplifiedPath.end());
+
+    return simplifiedPath;
 }
 
 bool Connection::intersectsObject(Object* object) const
@@ -1103,47 +1008,6 @@ bool Connection::intersectsObject(Object* object) const
         || toDraw.intersectsLine({ b.getBottomRight(), b.getTopRight() });
 }
 
-bool Connection::straightLineIntersectsObject(Line<float> toCheck, Array<Object*>& objects)
-{
-
-    for (auto const& object : objects) {
-        auto bounds = object->getBounds().expanded(1);
-
-        if (object == outobj || object == inobj || !bounds.intersects(getBounds()))
-            continue;
-
-        auto intersectV = [](Line<float> first, Line<float> second) {
-            if (first.getStartY() > first.getEndY()) {
-                first = { first.getEnd(), first.getStart() };
-            }
-
-            return first.getStartX() > second.getStartX() && first.getStartX() < second.getEndX() && second.getStartY() > first.getStartY() && second.getStartY() < first.getEndY();
-        };
-
-        auto intersectH = [](Line<float> first, Line<float> second) {
-            if (first.getStartX() > first.getEndX()) {
-                first = { first.getEnd(), first.getStart() };
-            }
-
-            return first.getStartY() > second.getStartY() && first.getStartY() < second.getEndY() && second.getStartX() > first.getStartX() && second.getStartX() < first.getEndX();
-        };
-
-        bool intersectsV = toCheck.isVertical() && (intersectV(toCheck, Line<float>(bounds.getTopLeft().toFloat(), bounds.getTopRight().toFloat())) || intersectV(toCheck, Line<float>(bounds.getBottomRight().toFloat(), bounds.getBottomLeft().toFloat())));
-
-        bool intersectsH = toCheck.isHorizontal() && (intersectH(toCheck, Line<float>(bounds.getTopRight().toFloat(), bounds.getBottomRight().toFloat())) || intersectH(toCheck, Line<float>(bounds.getTopLeft().toFloat(), bounds.getBottomLeft().toFloat())));
-        if (intersectsV || intersectsH) {
-            return true;
-        }
-
-        /*
-         if(bounds.toFloat().intersects(toCheck.toFloat())) {
-         return true;
-         } TODO: benchmark these two options */
-        // TODO: possible mark areas that have already been visited?
-    }
-    return false;
-}
-
 void ConnectionPathUpdater::timerCallback()
 {
     std::pair<Component::SafePointer<Connection>, t_symbol*> currentConnection;
@@ -1219,3 +1083,211 @@ void Connection::receiveMessage(String const& name, int argc, t_atom* argv)
         connectionMessageLock.exit();
     }
 }
+
+ConnectionLayer::ConnectionLayer(Canvas* parent)
+    : cnv(parent)
+{
+    // The canvas needs to see mouse events on connections, like it would for any of its children
+    addMouseListener(cnv, false);
+}
+
+void ConnectionLayer::paint(Graphics& g)
+{
+    if (cnv->getDetailLevel() != Canvas::DetailLevel::Full) {
+        paintSimplified(g);
+        return;
+    }
+
+    bool useDashedConnections = PlugDataLook::getUseDashedConnections();
+
+    Path plainCables;
+    std::vector<Connection*> detailedConnections;
+
+    for (auto* connection : cnv->connectionIndex.query(g.getClipBounds())) {
+        if (!connection->isVisible() || !connection->inlet || !connection->outlet)
+            continue;
+
+        bool isSignal = connection->outlet->isSignal;
+        bool showsOrder = connection->showConnectionOrder && !isSignal && connection->getNumberOfConnections() > 1;
+
+        if (connection->selectedFlag || connection->isHovering || connection->showDirection || showsOrder || (useDashedConnections && isSignal)) {
+            detailedConnections.push_back(connection);
+        } else {
+            plainCables.addPath(connection->toDrawLocalSpace, AffineTransform::translation(connection->getPosition()));
+        }
+    }
+
+    // Unselected cables all look the same, so we can stroke them in one go
+    // Same strokes as renderConnectionPath uses for a cable without any highlighting
+    if (!plainCables.isEmpty()) {
+        auto baseColour = cnv->findColour(PlugDataColour::connectionColourId);
+        bool useThinConnection = PlugDataLook::getUseThinConnections();
+
+        g.setColour(baseColour.darker(1.0f));
+        g.strokePath(plainCables, PathStrokeType(useThinConnection ? 1.0f : 2.5f, PathStrokeType::mitered, PathStrokeType::rounded));
+
+        g.setColour(baseColour);
+        g.strokePath(plainCables, PathStrokeType(useThinConnection ? 1.0f : 1.5f, PathStrokeType::mitered, PathStrokeType::rounded));
+    }
+
+    // Highlighted connections go on top
+    std::stable_partition(detailedConnections.begin(), detailedConnections.end(), [](Connection* connection) {
+        return !connection->selectedFlag && !connection->isHovering;
+    });
+
+    for (auto* connection : detailedConnections) {
+        Graphics::ScopedSaveState saveState(g);
+        g.setOrigin(connection->getPosition());
+        connection->paint(g);
+    }
+}
+
+void ConnectionLayer::paintSimplified(Graphics& g)
+{
+    // When zoomed out, overlays and the outline of the cable aren't visible anyway
+    // The path is still the same one that hitTest uses, so what you see is what you can click
+    Path cables, selectedSignalCables, selectedDataCables;
+    for (auto* connection : cnv->connectionIndex.query(g.getClipBounds())) {
+        if (!connection->isVisible() || !connection->inlet || !connection->outlet)
+            continue;
+
+        auto& target = !connection->selectedFlag ? cables : connection->outlet->isSignal ? selectedSignalCables
+                                                                                           : selectedDataCables;
+        target.addPath(connection->toDrawLocalSpace, AffineTransform::translation(connection->getPosition()));
+    }
+
+    auto stroke = PathStrokeType(2.0f);
+
+    g.setColour(cnv->findColour(PlugDataColour::connectionColourId));
+    g.strokePath(cables, stroke);
+
+    // Same colours as renderConnectionPath uses for selected cables
+    g.setColour(cnv->findColour(PlugDataColour::signalColourId));
+    g.strokePath(selectedSignalCables, stroke);
+
+    g.setColour(cnv->findColour(PlugDataColour::dataColourId));
+    g.strokePath(selectedDataCables, stroke);
+}
+
+void ConnectionLayer::lookAndFeelChanged()
+{
+    // Connections aren't our children, so they won't get notified otherwise
+    for (auto* connection : cnv->connections) {
+        connection->lookAndFeelChanged();
+    }
+
+    repaint();
+}
+
+bool ConnectionLayer::hitTest(int x, int y)
+{
+    return getConnectionAt({ x, y }) != nullptr;
+}
+
+Connection* ConnectionLayer::getConnectionAt(Point<int> position) const
+{
+    Connection* result = nullptr;
+    for (auto* connection : cnv->connectionIndex.query(position)) {
+        if (!connection->isVisible() || !connection->hitTest(position.x - connection->getX(), position.y - connection->getY()))
+            continue;
+
+        // Selected connections are drawn on top, so they should get the click
+        if (connection->isSelected())
+            return connection;
+
+        if (!result)
+            result = connection;
+    }
+
+    return result;
+}
+
+Point<int> ConnectionLayer::getMousePositionRelativeTo(Connection const* connection) const
+{
+    return lastMousePosition - connection->getPosition();
+}
+
+MouseEvent ConnectionLayer::getEventRelativeTo(MouseEvent const& e, Connection* connection)
+{
+    auto offset = connection->getPosition().toFloat();
+
+    return MouseEvent(e.source, e.position - offset, e.mods, e.pressure, e.orientation, e.rotation, e.tiltX, e.tiltY,
+        connection, e.originalComponent, e.eventTime, e.mouseDownPosition - offset, e.mouseDownTime,
+        e.getNumberOfClicks(), e.mouseWasDraggedSinceMouseDown());
+}
+
+void ConnectionLayer::updateHoveredConnection(MouseEvent const& e)
+{
+    lastMousePosition = e.getPosition();
+
+    auto* connection = getConnectionAt(lastMousePosition);
+    if (connection == hoveredConnection.getComponent())
+        return;
+
+    if (auto* previous = hoveredConnection.getComponent()) {
+        previous->mouseExit(getEventRelativeTo(e, previous));
+    }
+
+    hoveredConnection = connection;
+
+    if (connection) {
+        connection->mouseEnter(getEventRelativeTo(e, connection));
+    }
+}
+
+void ConnectionLayer::mouseEnter(MouseEvent const& e)
+{
+    updateHoveredConnection(e);
+}
+
+void ConnectionLayer::mouseMove(MouseEvent const& e)
+{
+    updateHoveredConnection(e);
+
+    if (auto* connection = hoveredConnection.getComponent()) {
+        connection->mouseMove(getEventRelativeTo(e, connection));
+        setMouseCursor(connection->getMouseCursor());
+    }
+}
+
+void ConnectionLayer::mouseExit(MouseEvent const& e)
+{
+    lastMousePosition = e.getPosition();
+
+    if (auto* connection = hoveredConnection.getComponent()) {
+        connection->mouseExit(getEventRelativeTo(e, connection));
+    }
+
+    hoveredConnection = nullptr;
+    setMouseCursor(MouseCursor::NormalCursor);
+}
+
+void ConnectionLayer::mouseDown(MouseEvent const& e)
+{
+    updateHoveredConnection(e);
+    draggedConnection = hoveredConnection;
+
+    if (auto* connection = draggedConnection.getComponent()) {
+        connection->mouseDown(getEventRelativeTo(e, connection));
+    }
+}
+
+void ConnectionLayer::mouseDrag(MouseEvent const& e)
+{
+    lastMousePosition = e.getPosition();
+
+    if (auto* connection = draggedConnection.getComponent()) {
+        connection->mouseDrag(getEventRelativeTo(e, connection));
+    }
+}
+
+void ConnectionLayer::mouseUp(MouseEvent const& e)
+{
+    lastMousePosition = e.getPosition();
+
+    if (auto* connection = draggedConnection.getComponent()) {
+        connection->mouseUp(getEventRelativeTo(e, connection));
+    }
+
+    draggedConnection = nullptr;
+}
@@ -22,6 +22,8 @@ using PathPlan = std::vector<Point<float>>;
 class Canvas;
 class PathUpdater;
 
+// Connections are not part of the component hierarchy
+// They are painted and receive their mouse events through the canvas' ConnectionLayer
 class Connection : public Component
     , public ComponentListener
     , public Value::Listener
@@ -85,6 +87,9 @@ public:
     Point<float> getStartPoint() const;
     Point<float> getEndPoint() const;
 
+    // Repaints the area of the connection layer that this connection covers
+    void repaintLayer();
+
     void reconnect(Iolet* target);
 
     bool intersects(Rectangle<float> toCheck, int accuracy = 4) const;
@@ -99,15 +104,15 @@ public:
 
     void componentMovedOrResized(Component& component, bool wasMoved, bool wasResized) override;
 
-    // Pathfinding
-    int findLatticePaths(PathPlan& bestPath, PathPlan& pathStack, Point<float> start, Point<float> end, Point<float> increment);
+    void moved() override;
+    void resized() override;
 
+    // Pathfinding, the route is found in the background and applied when it's ready
     void findPath();
 
     void applyBestPath();
 
     bool intersectsObject(Object* object) const;
-    bool straightLineIntersectsObject(Line<float> toCheck, Array<Object*>& objects);
 
     void receiveMessage(String const& name, int argc, t_atom* argv) override;
 
@@ -115,9 +120,23 @@ public:
 
     StringArray getMessageFormated();
 
+    // Counts the cables that leave the same outlet, and reads the number of signal channels from pd
+    // Called after synchronising, so painting (which happens a lot while dragging) doesn't have to walk every connection or lock pd
+    static void updateCachedInfo(OwnedArray<Connection> const& connections);
+
+    // The number of signal channels only changes when pd rebuilds its DSP graph, which can happen without any change to the canvas
+    // Must be called while holding the audio lock
+    static void updateNumSignalChannels(OwnedArray<Connection> const& connections);
+
 private:
     void resizeToFit();
 
+    // Path that goes straight down, across and down again, for when we don't have a route (yet)
+    static PathPlan getDefaultPlan(Point<float> pstart, Point<float> pend);
+
+    // How far around the cable we look for objects to route around
+    static inline constexpr float routingMargin = 60.0f;
+
     int getMultiConnectNumber();
     int getNumSignalChannels();
     int getNumberOfConnections();
@@ -132,6 +151,11 @@ private:
     bool selectedFlag = false;
     bool segmented = false;
 
+    // See updateCachedInfo
+    int numberOfConnections = 1;
+    int multiConnectNumber = 1;
+    int numSignalChannels = 0;
+
     PathPlan currentPlan;
 
     Value locked;
@@ -156,6 +180,7 @@ private:
     String lastSelector;
 
     friend class ConnectionPathUpdater;
+    friend class ConnectionLayer;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Connection)
 };
 
@@ -252,3 +277,40 @@ public:
         startTimer(50);
     }
 };
+
+// Draws all connections of a canvas in a single pass, and forwards mouse events to the connection under the mouse
+// Only the connections that intersect the area being repainted are drawn, plain cables get stroked together as one path
+class ConnectionLayer : public Component {
+public:
+    explicit ConnectionLayer(Canvas* parent);
+
+    void paint(Graphics& g) override;
+    void lookAndFeelChanged() override;
+
+    bool hitTest(int x, int y) override;
+
+    void mouseEnter(MouseEvent const& e) override;
+    void mouseMove(MouseEvent const& e) override;
+    void mouseExit(MouseEvent const& e) override;
+    void mouseDown(MouseEvent const& e) override;
+    void mouseDrag(MouseEvent const& e) override;
+    void mouseUp(MouseEvent const& e) override;
+
+    Connection* getConnectionAt(Point<int> position) const;
+
+    Point<int> getMousePositionRelativeTo(Connection const* connection) const;
+
+private:
+    void paintSimplified(Graphics& g);
+    void updateHoveredConnection(MouseEvent const& e);
+
+    static MouseEvent getEventRelativeTo(MouseEvent const& e, Connection* connection);
+
+    Canvas* cnv;
+
+    Component::SafePointer<Connection> hoveredConnection;
+    Component::SafePointer<Connection> draggedConnection;
+    Point<int> lastMousePosition;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConnectionLayer)
+};
@@ -34,8 +34,7 @@ Iolet::Iolet(Object* parent, bool inlet)
     presentationMode.referTo(object->cnv->presentationMode);
     presentationMode.addListener(this);
 
-    bool isPresenting = getValue<bool>(presentationMode);
-    setVisible(!isPresenting && !insideGraph);
+    updateVisibility();
 
     // Drawing circles is more expensive than you might think, especially because there can be a lot of iolets!
     setBufferedToImage(true);
@@ -108,7 +107,11 @@ void Iolet::paint(Graphics& g)
         bounds.translate(0.0f, isInlet ? -1.0f : 0.0f);
     }
 
-    if (PlugDataLook::getUseSquareIolets()) {
+    // When zoomed out, the shape can't be seen but the iolet is still there to drag connections from
+    if (object->cnv->getDetailLevel() != Canvas::DetailLevel::Full) {
+        g.setColour(backgroundColour);
+        g.fillRect(bounds);
+    } else if (PlugDataLook::getUseSquareIolets()) {
         g.setColour(backgroundColour);
         g.fillRect(bounds);
 
@@ -366,7 +369,7 @@ void Iolet::createConnection()
 
         cnv->patch.endUndoSequence("Connecting");
 
-        cnv->synchronise(); // Load all newly created connection from pd patch!
+        cnv->synchroniseChanges(); // Load all newly created connection from pd patch!
 
     }
     // otherwise set this iolet as start of a connection
@@ -419,9 +422,9 @@ Array<Connection*> Iolet::getConnections()
 
 Iolet* Iolet::findNearestIolet(Canvas* cnv, Point<int> position, bool inlet, Object* boxToExclude)
 {
-    // Find all iolets
+    // Find all iolets of objects close enough to the position, iolets are always inside their object
     Array<Iolet*> allEdges;
-    for (auto* object : cnv->objects) {
+    for (auto* object : cnv->objectIndex.query(Rectangle<int>(position, position).expanded(51))) {
         for (auto* iolet : object->iolets) {
             if (iolet->isInlet == inlet && iolet->object != boxToExclude) {
                 allEdges.add(iolet);
@@ -446,6 +449,12 @@ Iolet* Iolet::findNearestIolet(Canvas* cnv, Point<int> position, bool inlet, Obj
     return nearestIolet;
 }
 
+String Iolet::getTooltip()
+{
+    object->updateTooltipsIfNeeded();
+    return SettableTooltipClient::getTooltip();
+}
+
 void Iolet::valueChanged(Value& v)
 {
     if (v.refersToSameSourceAs(locked)) {
@@ -455,7 +464,7 @@ void Iolet::valueChanged(Value& v)
         repaint();
     }
     if (v.refersToSameSourceAs(presentationMode)) {
-        setVisible(!getValue<bool>(presentationMode) && !insideGraph && !hideIolet);
+        updateVisibility();
         repaint();
     }
 }
@@ -463,6 +472,11 @@ void Iolet::valueChanged(Value& v)
 void Iolet::setHidden(bool hidden)
 {
     hideIolet = hidden;
-    setVisible(!getValue<bool>(presentationMode) && !insideGraph && !hideIolet);
+    updateVisibility();
     repaint();
 }
+
+void Iolet::updateVisibility()
+{
+    setVisible(!getValue<bool>(presentationMode) && !insideGraph && !hideIolet);
+}
@@ -30,11 +30,14 @@ public:
 
     void valueChanged(Value& v) override;
 
+    String getTooltip() override;
+
     static Iolet* findNearestIolet(Canvas* cnv, Point<int> position, bool inlet, Object* boxToExclude = nullptr);
 
     void createConnection();
 
     void setHidden(bool hidden);
+    void updateVisibility();
 
     void clearConnections();
     Array<Connection*> getConnections();
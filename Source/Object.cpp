@@ -83,6 +83,7 @@ Object::~Object()
     }
 
     cnv->selectedComponents.removeChangeListener(this);
+    cnv->objectIndex.remove(this);
 }
 
 Rectangle<int> Object::getObjectBounds()
@@ -190,7 +191,7 @@ void Object::valueChanged(Value& v)
     } else if (v.refersToSameSourceAs(cnv->presentationMode)) {
         // else it was a lock/unlock/presentation mode action
         // Hide certain objects in GOP
-        setVisible(!((cnv->isGraph || cnv->presentationMode == var(true)) && gui && gui->hideInGraph()));
+        updateVisibility();
     } else if (v.refersToSameSourceAs(cnv->locked) || v.refersToSameSourceAs(cnv->commandLocked)) {
         if (gui) {
             gui->lock(cnv->isGraph || locked == var(true) || commandLocked == var(true));
@@ -370,7 +371,7 @@ void Object::setType(String const& newType, void* existingObject)
             objectPtr = patch->renameObject(getPointer(), newType);
 
             // Synchronise to make sure connections are preserved correctly
-            cnv->synchronise();
+            cnv->synchroniseChanges();
         } else {
             auto rect = getObjectBounds();
             objectPtr = patch->createObject(rect.getX(), rect.getY(), newType);
@@ -386,7 +387,11 @@ void Object::setType(String const& newType, void* existingObject)
         gui->initialise();
         gui->lock(cnv->isGraph || locked == var(true) || commandLocked == var(true));
         gui->addMouseListener(this, true);
-        addAndMakeVisible(gui.get());
+        addChildComponent(gui.get());
+        gui->setVisible(cnv->getDetailLevel() != Canvas::DetailLevel::Minimal);
+
+        if (!onScreen)
+            gui->setOnScreen(false);
     }
 
     isHvccCompatible = checkIfHvccCompatible();
@@ -530,7 +535,7 @@ void Object::paintOverChildren(Graphics& g)
 
 void Object::triggerOverlayActiveState()
 {
-    if (!showActiveState)
+    if (!showActiveState || !onScreen)
         return;
 
     if (rateReducer.tooFast())
@@ -549,7 +554,18 @@ void Object::triggerOverlayActiveState()
 
 void Object::paint(Graphics& g)
 {
-    if ((showActiveState || isTimerRunning(2))) {
+    auto detailLevel = cnv->getDetailLevel();
+
+    // The GUI is hidden at this zoom level, just show where the object is
+    if (detailLevel == Canvas::DetailLevel::Minimal && gui && !newObjectEditor) {
+        g.setColour(findColour(selectedFlag ? PlugDataColour::objectSelectedOutlineColourId : PlugDataColour::objectOutlineColourId));
+        g.fillRect(getLocalBounds().reduced(margin));
+        return;
+    }
+
+    if (detailLevel == Canvas::DetailLevel::Full && (showActiveState || isTimerRunning(2))) {
+        updateActivityOverlay();
+
         g.setOpacity(activeStateAlpha);
         // show activation state glow
         g.drawImage(activityOverlayImage, getLocalBounds().toFloat());
@@ -590,9 +606,85 @@ void Object::paint(Graphics& g)
     }
 }
 
+void Object::detailLevelChanged()
+{
+    if (gui) {
+        gui->setVisible(cnv->getDetailLevel() != Canvas::DetailLevel::Minimal);
+    }
+
+    // Iolets stay visible so connections can still be made, they only paint a simpler shape
+    for (auto* iolet : iolets) {
+        iolet->repaint();
+    }
+
+    repaint();
+}
+
+void Object::setOnScreen(bool shouldBeOnScreen)
+{
+    if (onScreen == shouldBeOnScreen)
+        return;
+
+    onScreen = shouldBeOnScreen;
+
+    // Most objects never show their activity overlay again, don't hold on to it while we're not visible
+    if (!shouldBeOnScreen) {
+        activityOverlayImage = Image();
+    }
+
+    if (gui) {
+        gui->setOnScreen(shouldBeOnScreen);
+    }
+}
+
+bool Object::isOnScreen() const
+{
+    return onScreen;
+}
+
+void Object::setDrawnByGraph(bool shouldBeDrawnByGraph)
+{
+    if (drawnByGraph == shouldBeDrawnByGraph)
+        return;
+
+    drawnByGraph = shouldBeDrawnByGraph;
+    updateVisibility();
+
+    // Labels are separate components, the graph draws those too
+    if (gui && gui->getLabel())
+        gui->getLabel()->setVisible(!drawnByGraph);
+}
+
+bool Object::isDrawnByGraph() const
+{
+    return drawnByGraph;
+}
+
+void Object::updateVisibility()
+{
+    if (!gui) {
+        setVisible(true);
+        return;
+    }
+
+    auto hidden = (cnv->isGraph || cnv->presentationMode == var(true)) && gui->hideInGraph();
+
+    // The graph draws these itself, from an image it shares with identical graphs
+    hidden |= drawnByGraph;
+
+    setVisible(!hidden);
+}
+
+void Object::moved()
+{
+    cnv->objectIndex.update(this, getBounds());
+}
+
 void Object::resized()
 {
-    setVisible(!((cnv->isGraph || cnv->presentationMode == var(true)) && gui && gui->hideInGraph()));
+    cnv->objectIndex.update(this, getBounds());
+
+    updateVisibility();
 
     if (gui) {
         gui->setBounds(getLocalBounds().reduced(margin));
@@ -642,9 +734,12 @@ void Object::resized()
 
         index++;
     }
+}
 
+void Object::updateActivityOverlay()
+{
     if (!getLocalBounds().isEmpty() && activityOverlayImage.getBounds() != getLocalBounds()) {
-        // Pre-render activity state overlay here since it'll always look the same for the same object size
+        // Render the activity state overlay once, it'll always look the same for the same object size
         activityOverlayImage = Image(Image::ARGB, getWidth(), getHeight(), true);
         Graphics g(activityOverlayImage);
         g.saveState();
@@ -658,6 +753,15 @@ void Object::resized()
     }
 }
 
+void Object::updateTooltipsIfNeeded()
+{
+    if (!tooltipsOutdated)
+        return;
+
+    tooltipsOutdated = false;
+    updateTooltips();
+}
+
 void Object::updateTooltips()
 {
     if (!gui)
@@ -822,7 +926,7 @@ void Object::updateIolets()
         numOut += !input;
     }
 
-    updateTooltips();
+    tooltipsOutdated = true;
     resized();
 }
 
@@ -935,6 +1039,12 @@ void Object::mouseUp(MouseEvent const& e)
             cnv->objectGrid.clearAll();
             applyBounds();
             ds.didStartDragging = false;
+
+            // Update the position parameters and labels that we skipped while dragging
+            for (auto* obj : objects) {
+                if (obj->gui)
+                    obj->gui->objectMovedOrResized(false);
+            }
         }
 
         if (ds.objectSnappingInbetween) {
@@ -953,7 +1063,7 @@ void Object::mouseUp(MouseEvent const& e)
             ds.objectSnappingInbetween->iolets[ds.objectSnappingInbetween->numInputs]->isTargeted = false;
             ds.objectSnappingInbetween = nullptr;
 
-            cnv->synchronise();
+            cnv->synchroniseChanges();
         }
 
         if (ds.wasDragDuplicated) {
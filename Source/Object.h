@@ -40,6 +40,7 @@ public:
     void paint(Graphics&) override;
     void paintOverChildren(Graphics&) override;
     void resized() override;
+    void moved() override;
 
     void updateIolets();
 
@@ -72,6 +73,21 @@ public:
 
     void updateOverlays(int overlay);
 
+    // Hides the GUI when zoomed out too far to see it
+    void detailLevelChanged();
+
+    // Set by the canvas when the object scrolls in or out of view, or when the canvas gets hidden or shown
+    // Objects that aren't on screen skip activity overlays, and their GUI stops polling and repainting
+    void setOnScreen(bool shouldBeOnScreen);
+    bool isOnScreen() const;
+
+    // Set by the graph that this object is in, when it draws the object from its cached static content
+    void setDrawnByGraph(bool shouldBeDrawnByGraph);
+    bool isDrawnByGraph() const;
+
+    // Looking up tooltips in the object library is slow, so we only do that when they are first needed
+    void updateTooltipsIfNeeded();
+
     void textEditorReturnKeyPressed(TextEditor& ed) override;
     void textEditorTextChanged(TextEditor& ed) override;
 
@@ -115,7 +131,10 @@ public:
 private:
     void initialise();
 
+    void updateVisibility();
+
     void updateTooltips();
+    void updateActivityOverlay();
 
     void openNewObjectEditor();
 
@@ -133,8 +152,14 @@ private:
     bool showActiveState = false;
     float activeStateAlpha = 0.0f;
 
+    // Read from the audio thread when messages arrive
+    std::atomic<bool> onScreen = true;
+
     bool isObjectMouseActive = false;
+    bool tooltipsOutdated = true;
+    bool drawnByGraph = false;
 
+    // Rendered when the activity overlay is first shown, and released when the object goes offscreen
     Image activityOverlayImage;
 
     ObjectDragState& ds;
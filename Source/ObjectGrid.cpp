@@ -485,7 +485,7 @@ Array<Object*> ObjectGrid::getSnappableObjects(Object* draggedObject)
     auto scaleFactor = std::sqrt(std::abs(cnv->getTransform().getDeterminant()));
     auto viewBounds = cnv->viewport.get()->getViewArea() / scaleFactor;
 
-    for (auto* object : cnv->objects) {
+    for (auto* object : cnv->objectIndex.query(viewBounds)) {
         if (draggedObject == object || object->isSelected() || !viewBounds.intersects(object->getBounds()))
             continue; // don't look at dragged object, selected objects, or objects that are outside of view bounds
 
@@ -533,7 +533,7 @@ public:
 };
 
 class ArrayObject final : public ObjectBase
-    , public Timer {
+    , public FrameScheduler::Listener {
 public:
     // Array component
     ArrayObject(void* obj, Object* object)
@@ -562,7 +562,7 @@ public:
 
         objectParameters.addParamCombo("Draw mode", cAppearance, &drawMode, { "Points", "Polygon", "Bezier Curve" }, 2);
 
-        startTimer(20);
+        getFrameScheduler().addListener(this, 50);
     }
 
     ~ArrayObject()
@@ -572,7 +572,16 @@ public:
         }
     }
 
-    void timerCallback() override
+    void onScreenChanged(bool isOnScreen) override
+    {
+        if (isOnScreen) {
+            getFrameScheduler().addListener(this, 50);
+        } else {
+            getFrameScheduler().removeListener(this);
+        }
+    }
+
+    void frameCallback() override
     {
         pd->lockAudioThread();
 
@@ -71,8 +71,8 @@ public:
         sendSymbol = getSendSymbol();
         receiveSymbol = getReceiveSymbol();
 
-        gui->getLookAndFeel().setColour(Label::textWhenEditingColourId, object->findColour(Label::textWhenEditingColourId));
-        gui->getLookAndFeel().setColour(Label::textColourId, object->findColour(Label::textColourId));
+        gui->getObjectLookAndFeel().setColour(Label::textWhenEditingColourId, object->findColour(Label::textWhenEditingColourId));
+        gui->getObjectLookAndFeel().setColour(Label::textColourId, object->findColour(Label::textColourId));
     }
 
     int getWidthInChars()
@@ -33,6 +33,23 @@ public:
         }
     }
 
+    bool isStaticInGraph() override
+    {
+        return true;
+    }
+
+    String getAppearance() override
+    {
+        auto appearance = iemHelper.secondaryColour.toString() + " " + String(getWidth()) + " " + String(getHeight());
+
+        if (label) {
+            appearance << " " << label->getText() << " " << label->findColour(Label::textColourId).toString();
+            appearance << " " << label->getBounds().toString() << " " << String(label->getFont().getHeight());
+        }
+
+        return appearance;
+    }
+
     bool hideInlets() override
     {
         return iemHelper.hasReceiveSymbol();
@@ -46,6 +63,9 @@ public:
     void updateLabel() override
     {
         iemHelper.updateLabel(label);
+
+        if (label && object->isDrawnByGraph())
+            label->setVisible(false);
     }
 
     std::vector<hash32> getAllMessages() override
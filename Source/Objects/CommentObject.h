@@ -35,13 +35,21 @@ public:
 
     void paint(Graphics& g) override
     {
-        if (!editor) {
-            auto textArea = border.subtractedFrom(getLocalBounds());
+        if (editor)
+            return;
 
-            auto scale = getWidth() < 50 ? 0.5f : 1.0f;
+        auto textArea = border.subtractedFrom(getLocalBounds());
 
-            Fonts::drawFittedText(g, objectText, textArea, object->findColour(PlugDataColour::commentTextColourId), numLines, scale, 14.0f, Justification::centredLeft);
+        // Text is unreadable when zoomed out, a faint block still shows where the comment is
+        if (cnv->getDetailLevel() != Canvas::DetailLevel::Full) {
+            g.setColour(object->findColour(PlugDataColour::commentTextColourId).withAlpha(0.25f));
+            g.fillRect(textArea);
+            return;
         }
+
+        auto scale = getWidth() < 50 ? 0.5f : 1.0f;
+
+        Fonts::drawFittedText(g, objectText, textArea, object->findColour(PlugDataColour::commentTextColourId), numLines, scale, 14.0f, Justification::centredLeft);
     }
 
     void paintOverChildren(Graphics& g) override
@@ -201,6 +209,17 @@ public:
         return false;
     }
 
+    bool isStaticInGraph() override
+    {
+        return true;
+    }
+
+    String getAppearance() override
+    {
+        auto colour = object->findColour(PlugDataColour::commentTextColourId);
+        return colour.toString() + " " + String(numLines) + " " + objectText;
+    }
+
     // Override to cancel default behaviour
     void lock(bool isLocked) override
     {
@@ -236,8 +236,8 @@ public:
         repaint();
         updateFont();
 
-        getLookAndFeel().setColour(Label::textWhenEditingColourId, object->findColour(Label::textWhenEditingColourId));
-        getLookAndFeel().setColour(Label::textColourId, object->findColour(Label::textColourId));
+        getObjectLookAndFeel().setColour(Label::textWhenEditingColourId, object->findColour(Label::textWhenEditingColourId));
+        getObjectLookAndFeel().setColour(Label::textColourId, object->findColour(Label::textColourId));
     }
 
     void mouseDown(MouseEvent const& e) override
@@ -18,6 +18,32 @@ class GraphOnParent final : public ObjectBase {
     pd::Patch::Ptr subpatch;
     std::unique_ptr<Canvas> canvas;
 
+    // Static objects inside the graph are drawn from an image, instead of each painting itself
+    // Graphs with the same static content, like many instances of one abstraction, share the image
+    // The image goes below the other objects, so we can only do this for static objects that are below all of them
+    Array<Component::SafePointer<Object>> staticObjects;
+    // Everything that goes into the image, empty if there are no static objects
+    struct StaticContentKey {
+        int scale = 0;
+        Rectangle<int> bounds;
+        std::vector<std::pair<Rectangle<int>, String>> objects;
+        uint64 hash = 0;
+
+        bool operator==(StaticContentKey const& other) const = default;
+    };
+
+    Image staticContent;
+    StaticContentKey staticContentKey;
+    float staticContentScale = 0.0f;
+    bool staticContentDirty = true;
+
+    // The full key is kept, so a hash collision is a miss instead of somebody else's image
+    struct CachedStaticContent {
+        StaticContentKey key;
+        Image image;
+    };
+    static inline std::unordered_map<uint64, CachedStaticContent> staticContentCache;
+
 public:
     // Graph On Parent
     GraphOnParent(void* obj, Object* object)
@@ -97,6 +123,11 @@ public:
         updateDrawables();
     }
 
+    void lookAndFeelChanged() override
+    {
+        staticContentChanged();
+    }
+
     // Called by object to make sure clicks on empty parts of the graph are passed on
     bool canReceiveMouseEvent(int x, int y) override
     {
@@ -164,6 +195,9 @@ public:
     ~GraphOnParent() override
     {
         closeOpenedSubpatchers();
+
+        staticContent = Image();
+        releaseUnusedStaticContent();
     }
 
     void tabChanged() override
@@ -181,6 +215,12 @@ public:
         repaint();
     }
 
+    void onScreenChanged(bool isOnScreen) override
+    {
+        if (canvas)
+            canvas->updateOnScreenObjects();
+    }
+
     void lock(bool locked) override
     {
         setInterceptsMouseClicks(locked, locked);
@@ -211,6 +251,7 @@ public:
             return;
 
         canvas->updateDrawables();
+        staticContentChanged();
     }
 
     // override to make transparent
@@ -223,6 +264,153 @@ public:
             auto textArea = getLocalBounds().removeFromTop(16).withTrimmedLeft(5);
             Fonts::drawFittedText(g, text, textArea, object->findColour(PlugDataColour::canvasTextColourId));
         }
+
+        auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        if (staticContentDirty || scale != staticContentScale)
+            updateStaticContent(scale);
+
+        if (staticContent.isValid())
+            g.drawImage(staticContent, getLocalBounds().toFloat());
+    }
+
+    // Called when the objects in the graph were synchronised, or when a static object changed
+    void staticContentChanged() override
+    {
+        staticContentDirty = true;
+        repaint();
+
+        // Objects are stacked in the order pd has them in, so the first object that isn't static ends the static content
+        // Objects that are hidden in graphs don't cover anything
+        Array<Component::SafePointer<Object>> newStaticObjects;
+        if (canvas) {
+            for (auto* obj : canvas->objects) {
+                if (!obj->gui || !obj->gui->isStaticInGraph()) {
+                    if (obj->gui && obj->gui->hideInGraph())
+                        continue;
+                    break;
+                }
+
+                newStaticObjects.add(obj);
+            }
+        }
+
+        for (auto& obj : staticObjects) {
+            if (obj && !newStaticObjects.contains(obj))
+                obj->setDrawnByGraph(false);
+        }
+
+        for (auto& obj : newStaticObjects)
+            obj->setDrawnByGraph(true);
+
+        staticObjects = newStaticObjects;
+    }
+
+    // Identifies the static content as it would be drawn at this scale
+    StaticContentKey getStaticContentKey(float scale)
+    {
+        StaticContentKey key;
+
+        for (auto& obj : staticObjects) {
+            if (!obj || !obj->gui)
+                continue;
+
+            key.objects.emplace_back(getLocalArea(obj->gui.get(), obj->gui->getLocalBounds()), obj->gui->getAppearance());
+        }
+
+        if (key.objects.empty())
+            return key;
+
+        key.scale = roundToInt(scale * 100.0f);
+        key.bounds = getLocalBounds();
+
+        auto hash = static_cast<uint64>(0xcbf29ce484222325ull);
+        auto add = [&hash](int64 value) {
+            hash ^= static_cast<uint64>(value);
+            hash *= 0x100000001b3ull;
+        };
+
+        add(key.scale);
+        add(key.bounds.getWidth());
+        add(key.bounds.getHeight());
+
+        for (auto const& [bounds, appearance] : key.objects) {
+            add(bounds.getX());
+            add(bounds.getY());
+            add(bounds.getWidth());
+            add(bounds.getHeight());
+            add(appearance.hashCode64());
+        }
+
+        key.hash = hash;
+        return key;
+    }
+
+    // Only called when something changed, the key tells us if we can keep using the image we have
+    void updateStaticContent(float scale)
+    {
+        staticContentDirty = false;
+        staticContentScale = scale;
+
+        auto key = getStaticContentKey(scale);
+        if (key == staticContentKey)
+            return;
+
+        staticContentKey = key;
+
+        if (!key.objects.empty()) {
+            auto& cached = staticContentCache[key.hash];
+            if (cached.image.isNull() || cached.key != key) {
+                // Another graph may still be drawing a colliding image, it keeps its own reference
+                cached.key = key;
+                cached.image = renderStaticContent(scale);
+            }
+
+            staticContent = cached.image;
+        } else {
+            staticContent = Image();
+        }
+
+        releaseUnusedStaticContent();
+    }
+
+    Image renderStaticContent(float scale)
+    {
+        auto image = Image(Image::ARGB, std::max(1, roundToInt(getWidth() * scale)), std::max(1, roundToInt(getHeight() * scale)), true);
+
+        Graphics g(image);
+        g.addTransform(AffineTransform::scale(scale));
+
+        for (auto& obj : staticObjects) {
+            if (!obj || !obj->gui)
+                continue;
+
+            paintStaticComponent(g, obj->gui.get());
+
+            if (auto* label = obj->gui->getLabel())
+                paintStaticComponent(g, label);
+        }
+
+        return image;
+    }
+
+    void paintStaticComponent(Graphics& g, Component* component)
+    {
+        Graphics::ScopedSaveState saveState(g);
+        g.setOrigin(getLocalPoint(component, Point<int>()));
+        g.reduceClipRegion(component->getLocalBounds());
+        component->paintEntireComponent(g, true);
+    }
+
+    static void releaseUnusedStaticContent()
+    {
+        for (auto it = staticContentCache.begin(); it != staticContentCache.end();) {
+            // Only the cache is still holding on to this image
+            if (it->second.image.getReferenceCount() <= 1) {
+                it = staticContentCache.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 
     void paintOverChildren(Graphics& g) override
@@ -193,7 +193,7 @@ public:
 };
 // ELSE keyboard
 class KeyboardObject final : public ObjectBase
-    , public Timer {
+    , public FrameScheduler::Listener {
 
     Value lowC = SynchronousValue();
     Value octaves = SynchronousValue();
@@ -251,7 +251,7 @@ public:
         objectParameters.addParamReceiveSymbol(&receiveSymbol);
         objectParameters.addParamSendSymbol(&sendSymbol);
 
-        startTimer(150);
+        getFrameScheduler().addListener(this, 7);
     }
 
     void update() override
@@ -495,7 +495,17 @@ public:
         }
     }
 
-    void timerCallback() override
+    void onScreenChanged(bool isOnScreen) override
+    {
+        if (isOnScreen) {
+            updateValue();
+            getFrameScheduler().addListener(this, 7);
+        } else {
+            getFrameScheduler().removeListener(this);
+        }
+    }
+
+    void frameCallback() override
     {
         updateValue();
     }
@@ -108,7 +108,7 @@ public:
         g.restoreState();
 
         // Draw text
-        if (!editor) {
+        if (!editor && cnv->getDetailLevel() == Canvas::DetailLevel::Full) {
             auto textArea = border.subtractedFrom(getLocalBounds().withTrimmedRight(5));
             auto scale = getWidth() < 50 ? 0.5f : 1.0f;
 
@@ -7,7 +7,7 @@
 #include "Utility/DraggableNumber.h"
 
 class NumboxTildeObject final : public ObjectBase
-    , public Timer {
+    , public FrameScheduler::Listener {
 
     DraggableNumber input;
 
@@ -53,7 +53,7 @@ public:
             }
         };
 
-        startTimer(nextInterval);
+        startPolling();
         repaint();
 
         objectParameters.addParamSize(&sizeProperty);
@@ -84,9 +84,9 @@ public:
         }
 
         auto fg = Colour::fromString(primaryColour.toString());
-        getLookAndFeel().setColour(Label::textColourId, fg);
-        getLookAndFeel().setColour(Label::textWhenEditingColourId, fg);
-        getLookAndFeel().setColour(TextEditor::textColourId, fg);
+        getObjectLookAndFeel().setColour(Label::textColourId, fg);
+        getObjectLookAndFeel().setColour(Label::textWhenEditingColourId, fg);
+        getObjectLookAndFeel().setColour(TextEditor::textColourId, fg);
     }
 
     Rectangle<int> getPdBounds() override
@@ -231,9 +231,9 @@ public:
         ptr.get<t_fake_numbox>()->x_fg = pd->generateSymbol("#" + colour.substring(2));
 
         auto col = Colour::fromString(colour);
-        getLookAndFeel().setColour(Label::textColourId, col);
-        getLookAndFeel().setColour(Label::textWhenEditingColourId, col);
-        getLookAndFeel().setColour(TextEditor::textColourId, col);
+        getObjectLookAndFeel().setColour(Label::textColourId, col);
+        getObjectLookAndFeel().setColour(Label::textWhenEditingColourId, col);
+        getObjectLookAndFeel().setColour(TextEditor::textColourId, col);
 
         repaint();
     }
@@ -262,7 +262,22 @@ public:
         g.drawRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), Corners::objectCornerRadius, 1.0f);
     }
 
-    void timerCallback() override
+    void onScreenChanged(bool isOnScreen) override
+    {
+        if (isOnScreen) {
+            frameCallback();
+        } else {
+            getFrameScheduler().removeListener(this);
+        }
+    }
+
+    // Follows the refresh interval that is set on the pd object
+    void startPolling()
+    {
+        getFrameScheduler().addListener(this, std::max(1, 1000 / std::max(nextInterval, 1)));
+    }
+
+    void frameCallback() override
     {
         auto val = getValue();
 
@@ -270,7 +285,7 @@ public:
             input.setText(input.formatNumber(val), dontSendNotification);
         }
 
-        startTimer(nextInterval);
+        startPolling();
     }
 
     float getValue()
@@ -138,8 +138,6 @@ ObjectBase::ObjectBase(void* obj, Object* parent)
 
     setWantsKeyboardFocus(true);
 
-    setLookAndFeel(new PlugDataLook());
-
     auto objectBounds = object->getObjectBounds();
     positionParameter = Array<var> { var(objectBounds.getX()), var(objectBounds.getY()) };
 
@@ -165,9 +163,7 @@ ObjectBase::~ObjectBase()
     pd->unregisterMessageListener(ptr.getRawUnchecked<void>(), this);
     object->removeComponentListener(&objectSizeListener);
 
-    auto* lnf = &getLookAndFeel();
     setLookAndFeel(nullptr);
-    delete lnf;
 }
 
 void ObjectBase::initialise()
@@ -187,9 +183,24 @@ void ObjectBase::initialise()
 
 void ObjectBase::objectMovedOrResized(bool resized)
 {
+    // The first call comes from the first synchronisation, when the object gets its bounds from pd
+    auto moveDistance = lastObjectPosition ? object->getPosition() - *lastObjectPosition : Point<int>();
+    lastObjectPosition = object->getPosition();
+
+    // While the selection is being dragged, objects are only moved on screen
+    // Everything that needs pd gets updated once the drag ends, see Object::mouseUp
+    if (!resized && cnv->dragState.didStartDragging) {
+        if (label)
+            label->setTopLeftPosition(label->getPosition() + moveDistance);
+        return;
+    }
+
     auto objectBounds = object->getObjectBounds();
 
+    // Moves are already recorded in pd's undo history, this shouldn't create a property undo step
+    positionParameter.removeListener(&propertyUndoListener);
     setParameterExcludingListener(positionParameter, Array<var> { var(objectBounds.getX()), var(objectBounds.getY()) }, &objectSizeListener);
+    positionParameter.addListener(&propertyUndoListener);
 
     if (resized)
         updateSizeProperty();
@@ -661,10 +672,27 @@ bool ObjectBase::canReceiveMouseEvent(int x, int y)
 
 void ObjectBase::receiveMessage(String const& symbol, int argc, t_atom* argv)
 {
-    object->triggerOverlayActiveState();
-
     auto sym = hash(symbol);
 
+    // Nobody can see value changes of an object that isn't on screen, so we only keep the latest one until it's visible again
+    if (!object->isOnScreen()) {
+        switch (sym) {
+        case hash("float"):
+        case hash("symbol"):
+        case hash("list"):
+        case hash("bang"):
+        case hash("set"): {
+            std::lock_guard<std::mutex> lock(pendingValueMutex);
+            pendingValue = { symbol, pd::Atom::fromAtoms(argc, argv) };
+            return;
+        }
+        default:
+            break;
+        }
+    }
+
+    object->triggerOverlayActiveState();
+
     switch (sym) {
     case hash("size"):
     case hash("delta"):
@@ -673,8 +701,10 @@ void ObjectBase::receiveMessage(String const& symbol, int argc, t_atom* argv)
     case hash("width"):
     case hash("height"): {
         MessageManager::callAsync([_this = SafePointer(this)]() {
-            if (_this)
+            if (_this) {
                 _this->object->updateBounds();
+                _this->repaintStaticContent();
+            }
         });
         break;
     }
@@ -688,12 +718,68 @@ void ObjectBase::receiveMessage(String const& symbol, int argc, t_atom* argv)
         auto atoms = pd::Atom::fromAtoms(argc, argv);
 
         MessageManager::callAsync([_this = SafePointer(this), symbol, atoms]() mutable {
-            if (_this)
+            if (_this) {
                 _this->receiveObjectMessage(symbol, atoms);
+                _this->repaintStaticContent();
+            }
         });
     }
 }
 
+void ObjectBase::setOnScreen(bool isOnScreen)
+{
+    if (isOnScreen) {
+        std::optional<PendingValue> value;
+        {
+            std::lock_guard<std::mutex> lock(pendingValueMutex);
+            value.swap(pendingValue);
+        }
+
+        auto messages = getAllMessages();
+        if (value && (std::find(messages.begin(), messages.end(), hash("anything")) != messages.end() || std::find(messages.begin(), messages.end(), hash(value->symbol)) != messages.end())) {
+            receiveObjectMessage(value->symbol, value->atoms);
+            repaintStaticContent();
+        }
+    }
+
+    onScreenChanged(isOnScreen);
+}
+
+String ObjectBase::getTooltip()
+{
+    object->updateTooltipsIfNeeded();
+    return SettableTooltipClient::getTooltip();
+}
+
+LookAndFeel& ObjectBase::getObjectLookAndFeel()
+{
+    if (!objectLookAndFeel) {
+        objectLookAndFeel = std::make_unique<PlugDataLook>();
+        setLookAndFeel(objectLookAndFeel.get());
+    }
+
+    return *objectLookAndFeel;
+}
+
+FrameScheduler& ObjectBase::getFrameScheduler()
+{
+    return cnv->editor->frameScheduler;
+}
+
+void ObjectBase::repaintOnNextFrame()
+{
+    getFrameScheduler().repaintOnNextFrame(this);
+}
+
+void ObjectBase::repaintStaticContent()
+{
+    if (!cnv->isGraph || !isStaticInGraph())
+        return;
+
+    if (auto* graph = dynamic_cast<ObjectBase*>(cnv->getParentComponent()))
+        graph->staticContentChanged();
+}
+
 void ObjectBase::setParameterExcludingListener(Value& parameter, var const& value)
 {
     parameter.removeListener(&propertyUndoListener);
@@ -14,6 +14,7 @@
 
 class PluginProcessor;
 class Canvas;
+class FrameScheduler;
 
 namespace pd {
 class Patch;
@@ -113,6 +114,16 @@ public:
     // Flag to make object visible or hidden inside a GraphOnParent
     virtual bool hideInGraph();
 
+    // Static objects only change when the patch is edited or when they receive a message
+    // A GraphOnParent draws them from a cached image instead of as components
+    virtual bool isStaticInGraph() { return false; }
+
+    // Describes what a static object looks like, graphs with the same static content share their image
+    virtual String getAppearance() { return {}; }
+
+    // Called on graphs when the objects inside them were synchronised, or when one of their static objects changed
+    virtual void staticContentChanged() { }
+
     // Most objects ignore mouseclicks when locked
     // Objects can override this to do custom locking behaviour
     virtual void lock(bool isLocked);
@@ -168,6 +179,13 @@ public:
     // Global flag to find out if any GUI object is currently being interacted with
     static bool isBeingEdited();
 
+    // Called when the object scrolls in or out of view, or when its canvas gets hidden or shown
+    // Only the latest value update that arrives while we're not on screen is kept, and shown when we become visible again
+    void setOnScreen(bool isOnScreen);
+
+    // Iolet and object tooltips are only looked up once someone hovers over the object
+    String getTooltip() override;
+
     ComponentBoundsConstrainer* getConstrainer();
 
     ObjectParameters objectParameters;
@@ -186,6 +204,21 @@ protected:
     // Called whenever one of the inspector parameters changes
     void valueChanged(Value& value) override {};
 
+    // Objects that poll pd or animate should stop doing that while they're not on screen
+    virtual void onScreenChanged(bool isOnScreen) {};
+
+    // Objects that poll pd should listen to the frame scheduler instead of running their own timer
+    FrameScheduler& getFrameScheduler();
+
+    // Repaints at the end of the next frame, for objects that may receive more updates than we can draw
+    void repaintOnNextFrame();
+
+    // Static objects in a graph are drawn by the graph, so that is what needs to update when they change
+    void repaintStaticContent();
+
+    // Objects that set their own colours get their own LookAndFeel, all others share the default one
+    LookAndFeel& getObjectLookAndFeel();
+
     // Send a float value to Pd
     void sendFloatValue(float value);
 
@@ -243,6 +276,18 @@ protected:
 
     ObjectSizeListener objectSizeListener;
     Value positionParameter = SynchronousValue();
+    std::optional<Point<int>> lastObjectPosition;
+
+    // Latest value that pd sent while we weren't on screen, shown once we're visible again
+    // Messages arrive on the audio thread, so it's guarded by a mutex
+    struct PendingValue {
+        String symbol;
+        std::vector<pd::Atom> atoms;
+    };
+    std::optional<PendingValue> pendingValue;
+    std::mutex pendingValueMutex;
+
+    std::unique_ptr<LookAndFeel> objectLookAndFeel;
 
     friend class IEMHelper;
     friend class AtomHelper;
@@ -6,7 +6,7 @@
 
 template<typename S>
 class ScopeBase : public ObjectBase
-    , public Timer {
+    , public FrameScheduler::Listener {
 
     std::vector<float> x_buffer;
     std::vector<float> y_buffer;
@@ -39,7 +39,7 @@ public:
         objectParameters.addParamInt("Delay", cGeneral, &delay, 0);
         objectParameters.addParamReceiveSymbol(&receiveSymbol);
 
-        startTimerHz(25);
+        getFrameScheduler().addListener(this, 25);
     }
 
     void updateSizeProperty() override
@@ -157,7 +157,16 @@ public:
         g.drawRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), Corners::objectCornerRadius, 1.0f);
     }
 
-    void timerCallback() override
+    void onScreenChanged(bool isOnScreen) override
+    {
+        if (isOnScreen) {
+            getFrameScheduler().addListener(this, 25);
+        } else {
+            getFrameScheduler().removeListener(this);
+        }
+    }
+
+    void frameCallback() override
     {
         int bufsize, mode;
         float min, max;
@@ -130,16 +130,56 @@ struct TextObjectHelper {
         return text;
     }
 
-    static int getIdealWidthForText(String const& text, int fontHeight)
+    struct TextMeasurements {
+        int idealWidth;
+        Array<float> glyphOffsets;
+    };
+
+    // Large patches tend to contain the same text many times, so objects with the same text share their measurements
+    // That way, opening a patch only measures every distinct text once
+    // The cache keeps the most recently used texts, the returned reference is only valid until the next call
+    static TextMeasurements const& measureText(String const& text, int fontHeight)
     {
-        auto lines = StringArray::fromLines(text);
-        int w = minWidth;
+        static constexpr size_t maxCacheSize = 8192;
+
+        using Entry = std::pair<String, TextMeasurements>;
+        static std::list<Entry> recentlyUsed; // Most recently used first
+        static std::unordered_map<String, std::list<Entry>::iterator> cache;
+
+        // Include the font, since the user can change it
+        auto key = Fonts::getCurrentFont().getTypefaceName() + ":" + String(fontHeight) + ":" + text;
+
+        auto existing = cache.find(key);
+        if (existing != cache.end()) {
+            recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, existing->second);
+            return existing->second->second;
+        }
+
+        // Don't let the cache grow forever while editing, forget the texts we haven't seen in the longest time
+        if (cache.size() >= maxCacheSize) {
+            cache.erase(recentlyUsed.back().first);
+            recentlyUsed.pop_back();
+        }
+
+        auto font = Font(fontHeight);
 
-        for (auto& line : lines) {
-            w = std::max<int>(Font(fontHeight).getStringWidthFloat(line) + 14.0f, w);
+        TextMeasurements measurements;
+        measurements.idealWidth = minWidth;
+        for (auto& line : StringArray::fromLines(text)) {
+            measurements.idealWidth = std::max<int>(font.getStringWidthFloat(line) + 14.0f, measurements.idealWidth);
         }
 
-        return w;
+        Array<int> glyphs;
+        font.getGlyphPositions(text.trimCharactersAtEnd(";\n"), glyphs, measurements.glyphOffsets);
+
+        recentlyUsed.emplace_front(key, std::move(measurements));
+        cache[key] = recentlyUsed.begin();
+        return recentlyUsed.front().second;
+    }
+
+    static int getIdealWidthForText(String const& text, int fontHeight)
+    {
+        return measureText(text, fontHeight).idealWidth;
     }
 
     // Used by text objects for estimating best text height for a set width
@@ -147,11 +187,7 @@ struct TextObjectHelper {
     {
         int numLines = 1;
 
-        Array<int> glyphs;
-        Array<float> xOffsets;
-
-        auto font = Font(fontSize);
-        font.getGlyphPositions(text.trimCharactersAtEnd(";\n"), glyphs, xOffsets);
+        auto xOffsets = measureText(text, fontSize).glyphOffsets;
 
         wchar_t lastChar;
         for (int i = 0; i < xOffsets.size(); i++) {
@@ -237,7 +273,7 @@ public:
             g.fillRect(getLocalBounds().removeFromBottom(3));
         }
 
-        if (!editor) {
+        if (!editor && cnv->getDetailLevel() == Canvas::DetailLevel::Full) {
             auto textArea = border.subtractedFrom(getLocalBounds());
 
             auto scale = getWidth() < 40 ? 0.9f : 1.0f;
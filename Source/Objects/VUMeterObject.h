@@ -169,7 +169,7 @@ public:
     {
         switch (hash(symbol)) {
         case hash("float"): {
-            repaint();
+            repaintOnNextFrame();
             break;
         }
         default: {
@@ -24,6 +24,11 @@ extern "C" {
 #include "x_libpd_extra_utils.h"
 #include "x_libpd_mod_utils.h"
 #include "x_libpd_multi.h"
+#include "x_libpd_abstraction_cache.h"
+#include "x_libpd_path_cache.h"
+#include "x_libpd_journal.h"
+#include "x_libpd_undo_budget.h"
+#include "x_libpd_lua_gc.h"
 #include "z_print_util.h"
 
 int sys_load_lib(t_canvas* canvas, char const* classname);
@@ -60,6 +65,13 @@ struct pd::Instance::internal {
 
     static void instance_multi_message(pd::Instance* ptr, char const* recv, char const* msg, int argc, t_atom* argv)
     {
+        if (!strcmp(recv, "pd") && !strcmp(msg, "dsp")) {
+            if (ptr->ignoreDSPStateMessages)
+                return;
+
+            ptr->dspStateRequested();
+        }
+
         Message mess { msg, String::fromUTF8(recv), std::vector<Atom>(argc) };
         for (int i = 0; i < argc; ++i) {
             if (argv[i].a_type == A_FLOAT)
@@ -123,6 +135,9 @@ Instance::Instance(String const& symbol)
 
 Instance::~Instance()
 {
+    dspUpdateFallback.stopTimer();
+    dspGraphChangeNotifier.cancelPendingUpdate();
+
     pd_free(static_cast<t_pd*>(m_message_receiver));
     pd_free(static_cast<t_pd*>(m_midi_receiver));
     pd_free(static_cast<t_pd*>(m_print_receiver));
@@ -133,6 +148,9 @@ Instance::~Instance()
     pd_free(static_cast<t_pd*>(m_databuffer_receiver));
 
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+    libpd_abstraction_cache_free();
+    libpd_journal_free();
+    libpd_undo_budget_free();
     libpd_free_instance(static_cast<t_pdinstance*>(m_instance));
 }
 
@@ -143,6 +161,9 @@ void Instance::initialisePd(String& pdlua_version)
 
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
 
+    // Every instance has its own object maker, which needs to look up unknown classes through the path cache
+    libpd_path_cache_setup();
+
     set_instance_lock(
         static_cast<void const*>(&audioLock),
         [](void* lock) {
@@ -312,6 +333,8 @@ void Instance::prepareDSP(int const nins, int const nouts, double const samplera
 {
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
     libpd_init_audio(nins, nouts, static_cast<int>(samplerate));
+
+    blockDurationTicks = Time::secondsToHighResolutionTicks(getBlockSize() / samplerate);
 }
 
 void Instance::startDSP()
@@ -325,14 +348,107 @@ void Instance::releaseDSP()
 {
     t_atom av;
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+
+    // DSP is being turned off, so a pending rebuild shouldn't turn it back on
+    dspUpdatePending = false;
+
     libpd_set_float(&av, 0.f);
     libpd_message("pd", "dsp", 1, &av);
 }
 
+void Instance::deferDSPUpdate()
+{
+    if (dspUpdatePending)
+        return;
+
+    // While DSP is suspended, pd skips all graph rebuilds. We resume it once, right before the next block is processed
+    ignoreDSPStateMessages = true;
+    deferredDSPState = canvas_suspend_dsp();
+    ignoreDSPStateMessages = false;
+
+    dspUpdatePending = deferredDSPState != 0;
+
+    if (dspUpdatePending)
+        dspUpdateFallback.startTimer(dspUpdateFallbackInterval);
+}
+
+void Instance::flushDSPUpdate()
+{
+    if (!dspUpdatePending.exchange(false))
+        return;
+
+    ignoreDSPStateMessages = true;
+    canvas_resume_dsp(deferredDSPState);
+    ignoreDSPStateMessages = false;
+
+    dspGraphChangeNotifier.triggerAsyncUpdate();
+}
+
+void Instance::dspStateRequested()
+{
+    dspUpdatePending = false;
+
+    // pd handles the message right after this, so the graph is rebuilt by the time the notifier runs
+    dspGraphChangeNotifier.triggerAsyncUpdate();
+}
+
 void Instance::performDSP(float const* inputs, float* outputs)
 {
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+
+    if (dspUpdatePending) {
+        lockAudioThread();
+        flushDSPUpdate();
+        unlockAudioThread();
+    }
+
+    auto const blockStart = Time::getHighResolutionTicks();
     libpd_process_raw(inputs, outputs);
+
+    // Lua only collects garbage when we step its collector, which we do with the time that's left in this block
+    // If the message thread is busy with pd, we'll try again next block
+    if (libpd_lua_gc_active() && tryLockAudioThread()) {
+        stepLuaGC(blockStart);
+        unlockAudioThread();
+    }
+}
+
+void Instance::stepLuaGC(int64 const blockStart)
+{
+    // Stay within the budget, and never let pd and the collector together take more than half a block
+    auto const start = Time::getHighResolutionTicks();
+    auto const deadline = std::min(start + Time::secondsToHighResolutionTicks(luaGCBudget / 1e6), blockStart + blockDurationTicks / 2);
+
+    auto now = start;
+    int64 steps = 0;
+    while (now < deadline && libpd_lua_gc_step()) {
+        steps++;
+        now = Time::getHighResolutionTicks();
+    }
+
+    if (!steps)
+        return;
+
+    luaGCTicks += now - start;
+    luaGCSteps += steps;
+    if (now - start > luaGCMaxBlockTicks)
+        luaGCMaxBlockTicks = now - start;
+}
+
+void Instance::setLuaGCBudget(int const microseconds)
+{
+    luaGCBudget = microseconds;
+}
+
+Instance::LuaGCStats Instance::getLuaGCStats() const
+{
+    LuaGCStats stats;
+    libpd_lua_gc_get_stats(&stats.memoryUsage, &stats.cycles);
+
+    stats.totalTime = Time::highResolutionTicksToSeconds(luaGCTicks) * 1000.0;
+    stats.maxBlockTime = Time::highResolutionTicksToSeconds(luaGCMaxBlockTicks) * 1000.0;
+    stats.steps = luaGCSteps;
+    return stats;
 }
 
 void Instance::sendNoteOn(int const channel, int const pitch, int const velocity) const
@@ -801,6 +917,7 @@ bool Instance::loadLibrary(String const& libraryToLoad)
 void Instance::lockAudioThread()
 {
     audioLock.enter();
+    numAudioThreadLocks++;
 }
 
 bool Instance::tryLockAudioThread()
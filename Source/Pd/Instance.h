@@ -177,6 +177,24 @@ public:
     void performDSP(float const* inputs, float* outputs);
     int getBlockSize() const;
 
+    // Postpones rebuilding the DSP graph until the start of the next audio block, so a batch of edits only rebuilds it once
+    // Must be called while holding the audio lock
+    void deferDSPUpdate();
+
+    struct LuaGCStats {
+        double totalTime = 0.0;    // Time this instance spent collecting lua garbage, in milliseconds
+        double maxBlockTime = 0.0; // Longest time spent collecting during a single block, in milliseconds
+        int64 steps = 0;
+        int cycles = 0;         // Completed collection cycles, shared between all instances
+        size_t memoryUsage = 0; // Bytes allocated by lua, shared between all instances
+    };
+
+    // Sets how much time per block may be spent stepping lua's garbage collector, in microseconds
+    void setLuaGCBudget(int microseconds);
+
+    // Don't call this from the audio thread, it waits for other instances to finish running lua code
+    LuaGCStats getLuaGCStats() const;
+
     void sendNoteOn(int channel, int const pitch, int velocity) const;
     void sendControlChange(int channel, int const controller, int value) const;
     void sendProgramChange(int channel, int value) const;
@@ -250,6 +268,9 @@ public:
 
     virtual void receiveDSPState(bool dsp) {};
 
+    // Called on the message thread after pd has rebuilt its DSP graph, or DSP was turned on or off
+    virtual void dspGraphChanged() {};
+
     virtual void updateConsole() {};
 
     virtual void titleChanged() {};
@@ -303,6 +324,9 @@ public:
     bool tryLockAudioThread();
     void unlockAudioThread();
 
+    // How many times lockAudioThread was called, for checking that something doesn't wait for pd
+    int64 getNumAudioThreadLocks() const { return numAudioThreadLocks; }
+
     bool loadLibrary(String const& library);
 
     void* m_instance = nullptr;
@@ -326,6 +350,71 @@ public:
     CriticalSection const audioLock;
 
 private:
+    // Resumes DSP that was suspended by deferDSPUpdate, call with the audio lock held
+    void flushDSPUpdate();
+
+    // Called when something asks pd to turn DSP on or off, with the audio lock held
+    // While a deferred update keeps DSP suspended, pd ignores turning it off, and turning it on already rebuilds the graph
+    // Either way, flushing the update must not change DSP state anymore
+    void dspStateRequested();
+
+    std::atomic<bool> dspUpdatePending = false;
+    std::atomic<int64> numAudioThreadLocks = 0;
+    int deferredDSPState = 0;
+
+    // Suspending and resuming DSP for a deferred update makes pd report that DSP was turned off and on again
+    // We don't want the UI to see that, since DSP stays on from the user's point of view
+    std::atomic<bool> ignoreDSPStateMessages = false;
+
+    // Flushes a deferred DSP update from the message thread, in case no audio blocks arrive to do it
+    // That happens when the host has stopped processing, or while rendering offline
+    struct DSPUpdateFallback : public Timer {
+        Instance* instance;
+
+        DSPUpdateFallback(Instance* parent)
+            : instance(parent)
+        {
+        }
+
+        void timerCallback() override
+        {
+            stopTimer();
+
+            instance->lockAudioThread();
+            instance->setThis();
+            instance->flushDSPUpdate();
+            instance->unlockAudioThread();
+        }
+    };
+
+    DSPUpdateFallback dspUpdateFallback = DSPUpdateFallback(this);
+    static inline constexpr int dspUpdateFallbackInterval = 100;
+
+    // The DSP graph is usually rebuilt on the audio thread, this passes that on to the message thread
+    struct DSPGraphChangeNotifier : public AsyncUpdater {
+        Instance* instance;
+
+        DSPGraphChangeNotifier(Instance* parent)
+            : instance(parent)
+        {
+        }
+
+        void handleAsyncUpdate() override
+        {
+            instance->dspGraphChanged();
+        }
+    };
+
+    DSPGraphChangeNotifier dspGraphChangeNotifier = DSPGraphChangeNotifier(this);
+
+    void stepLuaGC(int64 blockStart);
+
+    std::atomic<int> luaGCBudget = 100;
+    int64 blockDurationTicks = 0;
+    std::atomic<int64> luaGCTicks = 0;
+    std::atomic<int64> luaGCMaxBlockTicks = 0;
+    std::atomic<int64> luaGCSteps = 0;
+
     std::mutex weakReferenceMutex;
     std::unordered_map<void*, std::vector<pd_weak_reference*>> pdWeakReferences;
     std::unordered_map<void*, std::vector<juce::WeakReference<MessageListener>>> messageListeners;
@@ -21,6 +21,8 @@ extern "C" {
 #include <s_stuff.h>
 #include <z_libpd.h>
 #include <x_libpd_mod_utils.h>
+#include <x_libpd_abstraction_cache.h>
+#include <x_libpd_path_cache.h>
 }
 
 #include <utility>
@@ -260,6 +262,10 @@ StringArray Library::getAllCategories()
 
 void Library::fsChangeCallback()
 {
+    // Abstractions may have changed on disk, make sure they get reparsed on their next instantiation
+    libpd_abstraction_cache_invalidate();
+    libpd_path_cache_invalidate();
+
     appDirChanged();
 }
 
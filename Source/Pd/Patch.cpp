@@ -22,6 +22,8 @@ extern "C" {
 #include "g_undo.h"
 #include "x_libpd_extra_utils.h"
 #include "x_libpd_multi.h"
+#include "x_libpd_journal.h"
+#include "x_libpd_undo_budget.h"
 
 struct _instanceeditor {
     t_binbuf* copy_binbuf;
@@ -68,7 +70,8 @@ Patch::~Patch()
         instance->setThis();
         instance->clearObjectImplementationsForPatch(this); // Make sure that there are no object implementations running in the background!
 
-        if (auto patch = ptr.get<void>()) {
+        if (auto patch = ptr.get<t_glist>()) {
+            libpd_undo_budget_forget(patch.get());
             libpd_closefile(patch.get());
         }
     }
@@ -114,8 +117,8 @@ void Patch::savePatch(File const& location)
     if (auto patch = ptr.get<t_glist>()) {
         setTitle(filename);
         untitledPatchNum = 0;
-        canvas_dirty(patch.get(), 0);
 
+        // Only marks the patch as clean if it was saved
         libpd_savetofile(patch.get(), file, dir);
 
         instance->reloadAbstractions(location, patch.get());
@@ -162,8 +165,8 @@ void Patch::savePatch()
     if (auto patch = ptr.get<t_glist>()) {
         setTitle(filename);
         untitledPatchNum = 0;
-        canvas_dirty(patch.get(), 0);
 
+        // Only marks the patch as clean if it was saved
         libpd_savetofile(patch.get(), file, dir);
     }
 
@@ -209,6 +212,33 @@ Connections Patch::getConnections() const
     return connections;
 }
 
+Patch::Content Patch::readContent()
+{
+    // Hold the lock for the whole read, so the journal position matches what we read
+    instance->lockAudioThread();
+    Content content { getObjects(), getConnections(), libpd_journal_head() };
+    instance->unlockAudioThread();
+    return content;
+}
+
+void Patch::addView(View* view)
+{
+    views.addIfNotAlreadyThere(view);
+}
+
+void Patch::removeView(View* view)
+{
+    views.removeFirstMatchingValue(view);
+}
+
+void Patch::shareContent(Content const& content, View* source)
+{
+    for (auto* view : views) {
+        if (view != source)
+            view->synchroniseWithContent(content);
+    }
+}
+
 std::vector<void*> Patch::getObjects()
 {
     setCurrent();
@@ -227,6 +257,7 @@ void* Patch::createGraphOnParent(int x, int y)
 {
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         return libpd_creategraphonparent(patch.get(), x, y);
     }
 
@@ -237,6 +268,7 @@ void* Patch::createGraph(int x, int y, String const& name, int size, int drawMod
 {
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         return libpd_creategraph(patch.get(), name.toRawUTF8(), size, x, y, drawMode, saveContents, range.first, range.second);
     }
 
@@ -336,6 +368,7 @@ void* Patch::createObject(int x, int y, String const& name)
 
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         return libpd_createobj(patch.get(), typesymbol, argc, argv.data());
     }
 
@@ -379,6 +412,7 @@ void* Patch::renameObject(void* obj, String const& name)
 
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         libpd_renameobj(patch.get(), &checkObject(obj)->te_g, newName.toRawUTF8(), newName.getNumBytesAsUTF8());
         return libpd_newest(patch.get());
     }
@@ -496,6 +530,7 @@ void Patch::paste(Point<int> position)
     auto translatedObjects = translatePatchAsString(text, position.translated(1540, 1540));
 
     if (auto patch = ptr.get<t_glist>()) {
+        instance->deferDSPUpdate();
         libpd_paste(patch.get(), translatedObjects.toRawUTF8());
     }
 }
@@ -504,6 +539,7 @@ void Patch::duplicate()
 {
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         libpd_duplicate(patch.get());
     }
 }
@@ -533,6 +569,7 @@ void Patch::removeObject(void* obj)
 
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         libpd_removeobj(patch.get(), &checkObject(obj)->te_g);
     }
 }
@@ -559,6 +596,7 @@ void Patch::createConnection(void* src, int nout, void* sink, int nin)
 {
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         libpd_createconnection(patch.get(), checkObject(src), nout, checkObject(sink), nin);
     }
 }
@@ -569,6 +607,7 @@ void* Patch::createAndReturnConnection(void* src, int nout, void* sink, int nin)
 
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         return libpd_createconnection(patch.get(), checkObject(src), nout, checkObject(sink), nin);
     }
 
@@ -579,6 +618,7 @@ void Patch::removeConnection(void* src, int nout, void* sink, int nin, t_symbol*
 {
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         libpd_removeconnection(patch.get(), checkObject(src), nout, checkObject(sink), nin, connectionPath);
     }
 }
@@ -624,6 +664,7 @@ void Patch::finishRemove()
 {
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         libpd_finishremove(patch.get());
     }
 }
@@ -632,6 +673,7 @@ void Patch::removeSelection()
 {
     if (auto patch = ptr.get<t_glist>()) {
         setCurrent();
+        instance->deferDSPUpdate();
         libpd_removeselection(patch.get());
     }
 }
@@ -657,6 +699,7 @@ void Patch::undo()
         glist_noselect(patch.get());
         libpd_this_instance()->pd_gui->i_editor->canvas_undo_already_set_move = 0;
 
+        instance->deferDSPUpdate();
         libpd_undo(patch.get());
     }
 }
@@ -667,10 +710,23 @@ void Patch::redo()
         setCurrent();
         glist_noselect(patch.get());
         libpd_this_instance()->pd_gui->i_editor->canvas_undo_already_set_move = 0;
+        instance->deferDSPUpdate();
         libpd_redo(patch.get());
     }
 }
 
+std::pair<size_t, int> Patch::getUndoMemoryUsage()
+{
+    size_t bytes = 0;
+    int steps = 0;
+
+    if (auto patch = ptr.get<t_glist>()) {
+        libpd_undo_budget_getusage(patch.get(), &bytes, &steps);
+    }
+
+    return { bytes, steps };
+}
+
 t_object* Patch::checkObject(void* obj)
 {
     return pd_checkobject(static_cast<t_pd*>(obj));
@@ -760,16 +816,46 @@ String Patch::getCanvasContent()
 
     freebytes(static_cast<void*>(buf), static_cast<size_t>(bufsize) * sizeof(char));
 
-    instance->unlockAudioThread();
-
     return content;
 }
 
+Patch::PreparedContent Patch::prepareContent(Instance* instance, String const& content)
+{
+    auto text = content.toUTF8();
+
+    instance->setThis();
+    return { libpd_update_patch_prepare(text, static_cast<int>(text.sizeInBytes() - 1)), &libpd_update_patch_free };
+}
+
+void Patch::updateContent(PreparedContent const& content, File const& location)
+{
+    t_symbol* name = nullptr;
+    t_symbol* dir = nullptr;
+
+    if (location.existsAsFile()) {
+        name = instance->generateSymbol(location.getFileName());
+        dir = instance->generateSymbol(location.getParentDirectory().getFullPathName().replace("\\", "/"));
+    }
+
+    if (auto patch = ptr.get<t_canvas>()) {
+        instance->deferDSPUpdate();
+        libpd_update_patch_apply(patch.get(), content.get(), name, dir);
+    }
+
+    if (location.existsAsFile())
+        setCurrentFile(location);
+}
+
 void Patch::reloadPatch(File const& changedPatch, t_glist* except)
 {
     auto* dir = gensym(changedPatch.getParentDirectory().getFullPathName().replace("\\", "/").toRawUTF8());
     auto* file = gensym(changedPatch.getFileName().toRawUTF8());
-    canvas_reload(file, dir, except);
+
+    // Try to only apply what changed, so unchanged objects keep their state
+    if (!libpd_reload_abstraction(file, dir, except)) {
+        canvas_reload(file, dir, except);
+        libpd_journal_resync(nullptr);
+    }
 }
 
 bool Patch::objectWasDeleted(void* objectPtr) const
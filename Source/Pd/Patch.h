@@ -74,6 +74,9 @@ public:
     void undo();
     void redo();
 
+    // Returns how many bytes the undo history uses, and how many steps it holds
+    std::pair<size_t, int> getUndoMemoryUsage();
+
     enum GroupUndoType {
         Remove = 0,
         Move
@@ -111,8 +114,41 @@ public:
     // Gets the objects of the patch.
     std::vector<void*> getObjects();
 
+    // The objects and connections of the patch, read from pd in one go
+    struct Content {
+        std::vector<void*> objects;
+        Connections connections;
+        unsigned int journalPosition = 0; // Head of pd's change journal when this was read, everything before it is included
+    };
+
+    // A patch can be shown by more than one canvas, for example as a graph-on-parent and in its own tab
+    // When one of them needs to read everything from pd, the others that are waiting for a full synchronisation get the same content
+    class View {
+    public:
+        virtual ~View() = default;
+
+        virtual void synchroniseWithContent(Content const& content) = 0;
+    };
+
+    Content readContent();
+
+    void addView(View* view);
+    void removeView(View* view);
+
+    // Hands content that was read by one of the views to all the other views
+    void shareContent(Content const& content, View* source);
+
     String getCanvasContent();
 
+    // New content for updateContent, parsed ahead of time so applying it only needs a short lock
+    using PreparedContent = std::unique_ptr<t_libpd_patch_update, decltype(&libpd_update_patch_free)>;
+
+    // Returns null if the content can't be loaded as a patch
+    static PreparedContent prepareContent(Instance* instance, String const& content);
+
+    // Brings the patch up to date with new content without closing it, see libpd_update_patch_apply
+    void updateContent(PreparedContent const& content, File const& location);
+
     static void reloadPatch(File const& changedPatch, t_glist* except);
 
     static t_object* checkObject(void* obj);
@@ -132,6 +168,8 @@ private:
 
     WeakReference ptr;
 
+    Array<View*> views;
+
     // Initialisation parameters for GUI objects
     // Taken from pd save files, this will make sure that it directly initialises objects with the right parameters
     static inline const std::map<String, String> guiDefaults = {
@@ -9,6 +9,7 @@
 #include "Utility/Config.h"
 #include "Utility/Fonts.h"
 #include "Utility/OSUtils.h"
+#include "Utility/Autosave.h"
 
 #include "PluginEditor.h"
 #include "PluginProcessor.h"
@@ -67,6 +68,7 @@ public:
 PluginEditor::PluginEditor(PluginProcessor& p)
     : AudioProcessorEditor(&p)
     , pd(&p)
+    , frameScheduler(this)
     , statusbar(std::make_unique<Statusbar>(&p))
     , zoomLabel(std::make_unique<ZoomLabel>())
     , sidebar(std::make_unique<Sidebar>(&p, this))
@@ -284,6 +286,27 @@ PluginEditor::PluginEditor(PluginProcessor& p)
     if (ProjectInfo::isStandalone) {
         auto* midiDeviceManager = ProjectInfo::getMidiDeviceManager();
         midiDeviceManager->loadMidiOutputSettings();
+
+        // Offer to restore patches from a session that didn't shut down cleanly
+        auto recoveryFiles = Autosave::getRecoveryFiles();
+        if (!recoveryFiles.isEmpty()) {
+            MessageManager::callAsync([_this = SafePointer(this), recoveryFiles]() {
+                if (!_this)
+                    return;
+
+                Dialogs::showOkayCancelDialog(&_this->openedDialog, _this.getComponent(), "plugdata didn't shut down properly. Do you want to recover unsaved changes?",
+                    [_this, recoveryFiles](bool result) {
+                        if (!_this)
+                            return;
+
+                        if (result) {
+                            Autosave::recover(_this->pd, recoveryFiles);
+                        } else {
+                            Autosave::discard(recoveryFiles);
+                        }
+                    });
+            });
+        }
     }
 
     // This is necessary on Linux to make PluginEditor grab keyboard focus on startup
@@ -826,10 +849,12 @@ void PluginEditor::updateCommandStatus()
             return;
 
         pd->lockAudioThread();
+        auto [undoBytes, undoSteps] = cnv->patch.getUndoMemoryUsage();
         canUndo = libpd_can_undo(patchPtr.get()) && !isDragging && !locked;
         canRedo = libpd_can_redo(patchPtr.get()) && !isDragging && !locked;
         pd->unlockAudioThread();
 
+        undoButton.setTooltip(undoSteps ? String("Undo (" + String(undoSteps) + " steps, " + File::descriptionOfSizeInBytes(undoBytes) + ")") : String("Undo"));
         undoButton.setEnabled(canUndo);
         redoButton.setEnabled(canRedo);
 
@@ -16,6 +16,7 @@
 #include "Utility/ZoomableDragAndDropContainer.h"
 #include "Utility/OfflineObjectRenderer.h"
 #include "Utility/WindowDragger.h"
+#include "Utility/FrameScheduler.h"
 
 #include "SplitView.h" // TODO: move to impl
 #include "Dialogs/OverlayDisplaySettings.h"
@@ -115,6 +116,9 @@ public:
 
     std::unique_ptr<ConnectionMessageDisplay> connectionMessageDisplay;
 
+    // Needs to outlive the canvases, since their objects are listening to it
+    FrameScheduler frameScheduler;
+
     OwnedArray<Canvas, CriticalSection> canvases;
     std::unique_ptr<Sidebar> sidebar;
     std::unique_ptr<Statusbar> statusbar;
@@ -20,6 +20,7 @@
 #include "Utility/OSUtils.h"
 #include "Utility/AudioSampleRingBuffer.h"
 #include "Utility/MidiDeviceManager.h"
+#include "Utility/Autosave.h"
 
 #include "Presets.h"
 #include "Canvas.h"
@@ -28,6 +29,7 @@
 #include "LookAndFeel.h"
 #include "Tabbar.h"
 #include "Object.h"
+#include "Connection.h"
 #include "Statusbar.h"
 
 #include "Dialogs/Dialogs.h"
@@ -36,6 +38,10 @@
 extern "C" {
 #include "../Libraries/cyclone/shared/common/file.h"
 #include "x_libpd_extra_utils.h"
+#include "x_libpd_abstraction_cache.h"
+#include "x_libpd_binary_patch.h"
+#include "x_libpd_undo_budget.h"
+#include "x_libpd_lua_gc.h"
 EXTERN char* pd_version;
 }
 
@@ -152,6 +158,18 @@ PluginProcessor::PluginProcessor()
     initialisePd(pdlua_version);
     logMessage(pdlua_version);
 
+    // Precompiled patches are kept outside of the user's folders, and can always be regenerated
+    auto binaryPatchDir = ProjectInfo::appDataDir.getChildFile("Cache").getChildFile("Patches");
+    binaryPatchDir.createDirectory();
+    libpd_binary_patch_setdir(binaryPatchDir.getFullPathName().replace("\\", "/").toRawUTF8());
+    libpd_binary_patch_exclude(File::getSpecialLocation(File::tempDirectory).getFullPathName().replace("\\", "/").toRawUTF8());
+
+    // Undo history limit per canvas, in megabytes
+    libpd_undo_budget_set(static_cast<size_t>(settingsFile->getProperty<int>("undo_memory_limit")) << 20);
+
+    // Time per block that may be spent collecting lua garbage, in microseconds
+    setLuaGCBudget(settingsFile->getProperty<int>("lua_gc_budget"));
+
     updateSearchPaths();
 
     objectLibrary = std::make_unique<pd::Library>(this);
@@ -168,10 +186,21 @@ PluginProcessor::PluginProcessor()
     };
 
     setLatencySamples(pd::Instance::getBlockSize());
+
+    // In a plugin, the host takes care of storing our state
+    if (ProjectInfo::isStandalone) {
+        autosave = std::make_unique<Autosave>(this);
+    }
 }
 
 PluginProcessor::~PluginProcessor()
 {
+    // Make sure a state restore that's still running stops touching our patches
+    ++stateRestoreGeneration;
+    stateRestorePool.removeAllJobs(true, -1);
+
+    autosave.reset();
+
     // Deleting the pd instance in ~PdInstance() will also free all the Pd patches
     patches.clear();
 }
@@ -359,7 +388,10 @@ void PluginProcessor::setCurrentProgram(int index)
         MemoryOutputStream data;
         Base64::convertFromBase64(data, Presets::presets[index].second);
         if (data.getDataSize() > 0) {
-            setStateInformation(data.getData(), static_cast<int>(data.getDataSize()));
+            // Only fall back to reloading everything if the preset has a different set of patches
+            if (!switchState(data.getMemoryBlock())) {
+                setStateInformation(data.getData(), static_cast<int>(data.getDataSize()));
+            }
             lastSetProgram = index;
         }
     }
@@ -389,9 +421,11 @@ void PluginProcessor::setOversampling(int amount)
     auto blockSize = AudioProcessor::getBlockSize();
     auto sampleRate = AudioProcessor::getSampleRate();
 
+    // Don't resume processing if it was suspended by someone else, like a state restore that's still running
+    auto wasSuspended = isSuspended();
     suspendProcessing(true);
     prepareToPlay(sampleRate, blockSize);
-    suspendProcessing(false);
+    suspendProcessing(wasSuspended);
 }
 
 void PluginProcessor::setProtectedMode(bool enabled)
@@ -922,6 +956,15 @@ bool PluginProcessor::isInPluginMode()
 
 void PluginProcessor::getStateInformation(MemoryBlock& destData)
 {
+    // While a state is being restored, our patches are incomplete, so hand back the state that we're restoring
+    {
+        ScopedLock lock(stateRestoreLock);
+        if (!pendingState.isEmpty()) {
+            destData = pendingState;
+            return;
+        }
+    }
+
     setThis();
 
     savePatchTabPositions();
@@ -929,27 +972,27 @@ void PluginProcessor::getStateInformation(MemoryBlock& destData)
     // Store pure-data and parameter state
     MemoryOutputStream ostream(destData, false);
 
-    ostream.writeInt(patches.size());
-
     // Save path and content for patch
     lockAudioThread();
 
-    auto presetDir = ProjectInfo::appDataDir.getChildFile("Extra").getChildFile("Presets");
-
     auto* patchesTree = new XmlElement("Patches");
 
+    // Identical patch content, like multiple instances of the same patch, only gets stored once
+    StringArray patchContents;
+
     for (auto const& patch : patches) {
 
         auto content = patch->getCanvasContent();
         auto patchFile = patch->getCurrentFile().getFullPathName();
 
-        // Write legacy format
-        ostream.writeString(content);
-        ostream.writeString(patchFile);
+        auto contentIndex = patchContents.indexOf(content);
+        if (contentIndex < 0) {
+            contentIndex = patchContents.size();
+            patchContents.add(content);
+        }
 
         auto* patchTree = new XmlElement("Patch");
-        // Write new format
-        patchTree->setAttribute("Content", content);
+        patchTree->setAttribute("ContentIndex", contentIndex);
         patchTree->setAttribute("Location", patchFile);
         patchTree->setAttribute("PluginMode", patch->openInPluginMode);
         patchTree->setAttribute("SplitIndex", patch->splitViewIndex);
@@ -958,15 +1001,9 @@ void PluginProcessor::getStateInformation(MemoryBlock& destData)
     }
     unlockAudioThread();
 
-    ostream.writeInt(getLatencySamples());
-    ostream.writeInt(oversampling);
-    ostream.writeFloat(getValue<float>(tailLength));
-
     auto xml = XmlElement("plugdata_save");
     xml.setAttribute("Version", PLUGDATA_VERSION);
 
-    // In the future, we're gonna load everything from xml, to make it easier to add new properties
-    // By putting this here, we can prepare for making this change without breaking existing DAW saves
     xml.setAttribute("Oversampling", oversampling);
     xml.setAttribute("Latency", getLatencySamples());
     xml.setAttribute("TailLength", getValue<float>(tailLength));
@@ -995,8 +1032,20 @@ void PluginProcessor::getStateInformation(MemoryBlock& destData)
     // JYG added this
     m_temp_xml = nullptr;
 
-    ostream.writeInt(static_cast<int>(xmlBlock.getSize()));
-    ostream.write(xmlBlock.getData(), xmlBlock.getSize());
+    // The header is stored uncompressed, so we can tell this format apart from the legacy format
+    ostream.writeInt(compactStateMagic);
+    ostream.writeInt(compactStateVersion);
+
+    GZIPCompressorOutputStream zstream(ostream, 9);
+
+    zstream.writeCompressedInt(patchContents.size());
+    for (auto const& content : patchContents) {
+        zstream.writeString(content);
+    }
+
+    zstream.writeCompressedInt(static_cast<int>(xmlBlock.getSize()));
+    zstream.write(xmlBlock.getData(), xmlBlock.getSize());
+    zstream.flush();
 }
 
 void PluginProcessor::setStateInformation(void const* data, int sizeInBytes)
@@ -1004,163 +1053,450 @@ void PluginProcessor::setStateInformation(void const* data, int sizeInBytes)
     if (sizeInBytes == 0)
         return;
 
-    // By calling this asynchronously on the message thread and also suspending processing on the audio thread, we can make sure this is safe
-    // The DAW can call this function from basically any thread, hence the need for this
-    // Audio will only be reactivated once this action is completed
+    auto startTime = Time::getMillisecondCounterHiRes();
 
-    MemoryInputStream istream(data, sizeInBytes, false);
+    // The DAW can call this function from basically any thread, and loading all patches can take a long time
+    // So we suspend processing, and let a background job parse the state and prepare the patch files
+    // The patches are then loaded on the message thread one at a time, so the host doesn't stall for the whole load
+    // Audio is only reactivated once all patches are loaded
+    int generation;
+    {
+        ScopedLock lock(stateRestoreLock);
+        pendingState = MemoryBlock(data, sizeInBytes);
+        generation = ++stateRestoreGeneration;
+        suspendProcessing(true);
+    }
 
-    // Close any opened patches
-    if (auto* editor = dynamic_cast<PluginEditor*>(getActiveEditor())) {
-        MessageManager::callAsync([editor = Component::SafePointer(editor)]() {
-            if (!editor)
-                return;
+    // Offline renders start processing as soon as we return, so restore on the calling thread like we used to
+    if (isNonRealtime()) {
+        auto savedState = std::make_shared<SavedState>();
+        auto error = prepareState(MemoryBlock(data, sizeInBytes), *savedState);
+        restoreState(savedState, error, generation, startTime);
+        return;
+    }
 
-            for (auto split : editor->splitView.splits) {
-                split->getTabComponent()->clearTabs();
-            }
-            editor->canvases.clear();
+    stateRestorePool.addJob([this, state = MemoryBlock(data, sizeInBytes), generation, startTime]() {
+        // A newer state has been set before we even started
+        if (generation != stateRestoreGeneration)
+            return;
+
+        auto savedState = std::make_shared<SavedState>();
+        auto error = prepareState(state, *savedState);
+
+        MessageManager::callAsync([_this = WeakReference<PluginProcessor>(this), savedState, error, generation, startTime]() {
+            if (_this)
+                _this->restoreState(savedState, error, generation, startTime);
+            else
+                deleteTemporaryFiles(*savedState);
         });
+    });
+}
+
+PluginProcessor::StateError PluginProcessor::parseState(MemoryBlock const& state, SavedState& result)
+{
+    MemoryInputStream istream(state, false);
+
+    StringArray patchContents;
+    Array<SavedPatch> legacyPatches;
+
+    if (istream.readInt() == compactStateMagic) {
+        auto version = istream.readInt();
+
+        // State from a newer version that we don't know how to read
+        if (version > compactStateVersion)
+            return StateError::NewerVersion;
+
+        GZIPDecompressorInputStream zstream(istream);
+
+        auto numContents = zstream.readCompressedInt();
+        if (numContents < 0)
+            return StateError::Corrupted;
+
+        for (int i = 0; i < numContents; i++) {
+            if (zstream.isExhausted())
+                return StateError::Corrupted;
+
+            patchContents.add(zstream.readString());
+        }
+
+        auto xmlSize = zstream.readCompressedInt();
+        MemoryBlock xmlData;
+        if (xmlSize <= 0 || zstream.readIntoMemoryBlock(xmlData, xmlSize) != static_cast<size_t>(xmlSize))
+            return StateError::Corrupted;
+
+        result.xml = getXmlFromBinary(xmlData.getData(), static_cast<int>(xmlData.getSize()));
+
+        // The compact format always has settings
+        if (!result.xml)
+            return StateError::Corrupted;
+    } else {
+        // Legacy format, starts with the number of patches
+        istream.setPosition(0);
+
+        int numPatches = istream.readInt();
+        if (numPatches < 0)
+            return StateError::Corrupted;
+
+        for (int i = 0; i < numPatches; i++) {
+            if (istream.isExhausted())
+                return StateError::Corrupted;
+
+            auto state = istream.readString();
+            auto path = istream.readString();
+
+            auto presetDir = ProjectInfo::appDataDir.getChildFile("Extra").getChildFile("Presets");
+            path = path.replace("${PRESET_DIR}", presetDir.getFullPathName());
+
+            legacyPatches.add({ state, File(path) });
+        }
+
+        result.legacyLatency = istream.readInt();
+        result.legacyOversampling = istream.readInt();
+        result.legacyTail = istream.readFloat();
+
+        auto xmlSize = istream.readInt();
+
+        MemoryBlock xmlData;
+        if (xmlSize < 0 || istream.readIntoMemoryBlock(xmlData, xmlSize) != static_cast<size_t>(xmlSize))
+            return StateError::Corrupted;
+
+        result.xml = getXmlFromBinary(xmlData.getData(), static_cast<int>(xmlData.getSize()));
+
+        if (xmlSize > 0 && !result.xml)
+            return StateError::Corrupted;
     }
 
-    lockAudioThread();
-    
-    setThis();
-    patches.clear();
+    if (!result.xml)
+        return StateError::None;
 
-    int numPatches = istream.readInt();
+    // If xmltree contains new patch format, use that
+    if (auto* patchTree = result.xml->getChildByName("Patches")) {
+        forEachXmlChildElementWithTagName(*patchTree, p, "Patch")
+        {
+            SavedPatch patch;
+            patch.content = p->hasAttribute("ContentIndex") ? patchContents[p->getIntAttribute("ContentIndex")] : p->getStringAttribute("Content");
+            patch.pluginMode = p->getBoolAttribute("PluginMode");
 
-    Array<std::pair<String, File>> patches;
+            if (p->hasAttribute("SplitIndex")) {
+                patch.splitIndex = p->getIntAttribute("SplitIndex");
+            }
 
-    for (int i = 0; i < numPatches; i++) {
-        auto state = istream.readString();
-        auto path = istream.readString();
+            auto presetDir = ProjectInfo::versionDataDir.getChildFile("Extra").getChildFile("Presets");
+            patch.location = File(p->getStringAttribute("Location").replace("${PRESET_DIR}", presetDir.getFullPathName()));
 
-        auto presetDir = ProjectInfo::appDataDir.getChildFile("Extra").getChildFile("Presets");
-        path = path.replace("${PRESET_DIR}", presetDir.getFullPathName());
+            result.patches.add(patch);
+        }
+    }
+    // Otherwise, load from legacy format
+    else {
+        result.patches = legacyPatches;
+    }
 
-        auto location = File(path);
+    return StateError::None;
+}
 
-        patches.add({ state, location });
+void PluginProcessor::applyStateSettings(SavedState const& state)
+{
+    auto& xmlState = *state.xml;
+
+    PlugDataParameter::loadStateInformation(xmlState, getParameters());
+
+    auto versionString = String("0.6.1"); // latest version that didn't have version inside the daw state
+
+    if (!xmlState.hasAttribute("Legacy") || xmlState.getBoolAttribute("Legacy")) {
+        setLatencySamples(state.legacyLatency);
+        setOversampling(state.legacyOversampling);
+        tailLength = state.legacyTail;
+    } else {
+        setOversampling(xmlState.getDoubleAttribute("Oversampling"));
+        setLatencySamples(xmlState.getDoubleAttribute("Latency"));
+        tailLength = xmlState.getDoubleAttribute("TailLength");
     }
 
-    auto legacyLatency = istream.readInt();
-    auto legacyOversampling = istream.readInt();
-    auto legacyTail = istream.readFloat();
+    if (xmlState.hasAttribute("Version")) {
+        versionString = xmlState.getStringAttribute("Version");
+    }
 
-    auto xmlSize = istream.readInt();
+    if (xmlState.hasAttribute("Height") && xmlState.hasAttribute("Width")) {
+        int windowWidth = xmlState.getIntAttribute("Width", 1000);
+        int windowHeight = xmlState.getIntAttribute("Height", 650);
+        lastUIWidth = windowWidth;
+        lastUIHeight = windowHeight;
+        if (auto* editor = getActiveEditor()) {
+            MessageManager::callAsync([editor = Component::SafePointer(editor), windowWidth, windowHeight]() {
+                if (!editor)
+                    return;
+                editor->setSize(windowWidth, windowHeight);
+            });
+        }
+    }
 
-    auto* xmlData = new char[xmlSize];
-    istream.read(xmlData, xmlSize);
+    // JYG added this
+    parseDataBuffer(xmlState);
+}
 
-    std::unique_ptr<XmlElement> xmlState(getXmlFromBinary(xmlData, xmlSize));
+PluginProcessor::StateError PluginProcessor::prepareState(MemoryBlock const& state, SavedState& result)
+{
+    if (auto error = parseState(state, result); error != StateError::None)
+        return error;
 
-    auto openPatch = [this](String const& content, File const& location, bool pluginMode = false, int splitIndex = 0) {
-        if (location.getFullPathName().isNotEmpty() && location.existsAsFile()) {
-            auto patch = loadPatch(location, splitIndex);
-            if (patch) {
-                patch->setTitle(location.getFileName());
-                patch->openInPluginMode = pluginMode;
-            }
-        } else {
-            if (location.getParentDirectory().exists()) {
-                auto parentPath = location.getParentDirectory().getFullPathName();
-                libpd_add_to_search_path(parentPath.toRawUTF8());
-            }
-            auto patch = loadPatch(content, splitIndex);
-            if (patch && ((location.exists() && location.getParentDirectory() == File::getSpecialLocation(File::tempDirectory)) || !location.exists())) {
-                patch->setTitle("Untitled Patcher");
-                patch->openInPluginMode = pluginMode;
-                patch->splitViewIndex = splitIndex;
-            } else if (patch && location.existsAsFile()) {
-                patch->setCurrentFile(location);
-                patch->setTitle(location.getFileName());
-                patch->openInPluginMode = pluginMode;
-                patch->splitViewIndex = splitIndex;
-            }
+    for (auto& patch : result.patches) {
+        if (patch.location.getFullPathName().isNotEmpty() && patch.location.existsAsFile()) {
+            patch.fileToOpen = patch.location;
+            continue;
         }
-    };
 
-    if (xmlState) {
-        // If xmltree contains new patch format, use that
-        if (auto* patchTree = xmlState->getChildByName("Patches")) {
-            forEachXmlChildElementWithTagName(*patchTree, p, "Patch")
-            {
-                auto content = p->getStringAttribute("Content");
-                auto location = p->getStringAttribute("Location");
-                auto pluginMode = p->getBoolAttribute("PluginMode");
-
-                int splitIndex = 0;
-                if (p->hasAttribute("SplitIndex")) {
-                    splitIndex = p->getIntAttribute("SplitIndex");
-                }
+        // pd can only open patches from a file
+        patch.fileToOpen = File::createTempFile(".pd");
+        patch.fileToOpen.replaceWithText(patch.content.isEmpty() ? pd::Instance::defaultPatch : patch.content);
+        patch.isTemporary = true;
+    }
 
-                auto presetDir = ProjectInfo::versionDataDir.getChildFile("Extra").getChildFile("Presets");
-                location = location.replace("${PRESET_DIR}", presetDir.getFullPathName());
+    return StateError::None;
+}
 
-                openPatch(content, location, pluginMode, splitIndex);
-            }
+void PluginProcessor::deleteTemporaryFiles(SavedState const& state)
+{
+    for (auto const& saved : state.patches) {
+        if (saved.isTemporary)
+            saved.fileToOpen.deleteFile();
+    }
+}
+
+static void callOnEditor(AudioProcessorEditor* activeEditor, std::function<void(PluginEditor*)> callback)
+{
+    auto editor = Component::SafePointer(dynamic_cast<PluginEditor*>(activeEditor));
+    if (!editor)
+        return;
+
+    if (MessageManager::existsAndIsCurrentThread()) {
+        callback(editor.getComponent());
+    } else {
+        MessageManager::callAsync([editor, callback]() {
+            if (editor)
+                callback(editor.getComponent());
+        });
+    }
+}
+
+void PluginProcessor::restoreState(std::shared_ptr<SavedState> state, StateError error, int generation, double startTime)
+{
+    // A newer state was set while we were preparing this one, that one will reactivate audio
+    if (generation != stateRestoreGeneration) {
+        deleteTemporaryFiles(*state);
+        return;
+    }
+
+    // Close any opened patches
+    callOnEditor(getActiveEditor(), [](PluginEditor* editor) {
+        for (auto split : editor->splitView.splits) {
+            split->getTabComponent()->clearTabs();
         }
-        // Otherwise, load from legacy format
-        else {
-            for (auto& [content, location] : patches) {
-                openPatch(content, location);
-            }
+        editor->canvases.clear();
+    });
+
+    lockAudioThread();
+    setThis();
+    patches.clear();
+    unlockAudioThread();
+
+    if (error == StateError::NewerVersion) {
+        logError("Failed to load state: saved by a newer version of plugdata");
+    } else if (error == StateError::Corrupted) {
+        logError("Failed to load state: the saved data is corrupted");
+    }
+
+    if (error != StateError::None || !state->xml) {
+        finishStateRestore(*state, false, generation, startTime);
+        return;
+    }
+
+    // Offline renders need everything to be loaded before we return
+    if (isNonRealtime() || !MessageManager::existsAndIsCurrentThread()) {
+        for (auto const& saved : state->patches) {
+            restoreSavedPatch(saved);
         }
 
-        jassert(xmlState);
+        finishStateRestore(*state, true, generation, startTime);
+        return;
+    }
 
-        PlugDataParameter::loadStateInformation(*xmlState, getParameters());
+    restoreNextPatch(state, 0, generation, startTime);
+}
 
-        auto versionString = String("0.6.1"); // latest version that didn't have version inside the daw state
+void PluginProcessor::restoreNextPatch(std::shared_ptr<SavedState> state, int index, int generation, double startTime)
+{
+    // A newer state was set while we were loading this one, that one will close what we loaded so far
+    if (generation != stateRestoreGeneration) {
+        deleteTemporaryFiles(*state);
+        return;
+    }
 
-        if (!xmlState->hasAttribute("Legacy") || xmlState->getBoolAttribute("Legacy")) {
-            setLatencySamples(legacyLatency);
-            setOversampling(legacyOversampling);
-            tailLength = legacyTail;
-        } else {
-            setOversampling(xmlState->getDoubleAttribute("Oversampling"));
-            setLatencySamples(xmlState->getDoubleAttribute("Latency"));
-            tailLength = xmlState->getDoubleAttribute("TailLength");
+    if (index >= state->patches.size()) {
+        finishStateRestore(*state, true, generation, startTime);
+        return;
+    }
+
+    restoreSavedPatch(state->patches.getReference(index));
+
+    // Give the message loop a chance to run, which also adds the canvas of the patch we just loaded to the editor
+    MessageManager::callAsync([_this = WeakReference<PluginProcessor>(this), state, index, generation, startTime]() {
+        if (_this)
+            _this->restoreNextPatch(state, index + 1, generation, startTime);
+        else
+            deleteTemporaryFiles(*state);
+    });
+}
+
+void PluginProcessor::restoreSavedPatch(SavedPatch const& saved)
+{
+    if (!saved.isTemporary) {
+        if (auto patch = loadPatch(saved.fileToOpen, saved.splitIndex)) {
+            patch->setTitle(saved.location.getFileName());
+            patch->openInPluginMode = saved.pluginMode;
         }
+        return;
+    }
+
+    if (saved.location.getParentDirectory().exists()) {
+        auto parentPath = saved.location.getParentDirectory().getFullPathName();
+        libpd_add_to_search_path(parentPath.toRawUTF8());
+    }
+
+    auto patch = loadPatch(saved.fileToOpen, saved.splitIndex);
+    if (!patch)
+        return;
 
-        if (xmlState->hasAttribute("Version")) {
-            versionString = xmlState->getStringAttribute("Version");
+    // Set to unknown file when loading temp patch
+    patch->setCurrentFile(File());
+
+    if ((saved.location.exists() && saved.location.getParentDirectory() == File::getSpecialLocation(File::tempDirectory)) || !saved.location.exists()) {
+        patch->setTitle("Untitled Patcher");
+    } else if (saved.location.existsAsFile()) {
+        patch->setCurrentFile(saved.location);
+        patch->setTitle(saved.location.getFileName());
+    }
+
+    patch->openInPluginMode = saved.pluginMode;
+    patch->splitViewIndex = saved.splitIndex;
+}
+
+void PluginProcessor::finishStateRestore(SavedState const& state, bool applySettings, int generation, double startTime)
+{
+    if (applySettings) {
+        lockAudioThread();
+        applyStateSettings(state);
+        unlockAudioThread();
+    }
+
+    deleteTemporaryFiles(state);
+
+    callOnEditor(getActiveEditor(), [](PluginEditor* editor) {
+        editor->sidebar->updateAutomationParameters();
+
+        if (editor->pluginMode && !editor->pd->isInPluginMode()) {
+            editor->pluginMode->closePluginMode();
         }
+    });
 
-        if (xmlState->hasAttribute("Height") && xmlState->hasAttribute("Width")) {
-            int windowWidth = xmlState->getIntAttribute("Width", 1000);
-            int windowHeight = xmlState->getIntAttribute("Height", 650);
-            lastUIWidth = windowWidth;
-            lastUIHeight = windowHeight;
-            if (auto* editor = getActiveEditor()) {
-                MessageManager::callAsync([editor = Component::SafePointer(editor), windowWidth, windowHeight]() {
-                    if (!editor)
-                        return;
-                    editor->setSize(windowWidth, windowHeight);
-                });
+    ScopedLock lock(stateRestoreLock);
+
+    // If a newer state was set while we were loading, that one will reactivate audio
+    if (generation != stateRestoreGeneration)
+        return;
+
+    pendingState.reset();
+    suspendProcessing(false);
+
+    logMessage("Restored state in " + String(Time::getMillisecondCounterHiRes() - startTime, 1) + " ms");
+}
+
+bool PluginProcessor::switchState(MemoryBlock const& state)
+{
+    auto startTime = Time::getMillisecondCounterHiRes();
+
+    SavedState target;
+    if (parseState(state, target) != StateError::None || !target.xml)
+        return false;
+
+    // Let a restore that is still running finish first
+    {
+        ScopedLock lock(stateRestoreLock);
+        if (!pendingState.isEmpty())
+            return false;
+    }
+
+    // We can only update patches in place if the target state has the same set of patches
+    if (target.patches.size() != patches.size())
+        return false;
+
+    // Parse everything before taking the lock, so the audio thread only waits for the update itself.
+    // Same as when restoring: patches that exist on disk are loaded from their file
+    std::vector<pd::Patch::PreparedContent> contents;
+    for (auto const& saved : target.patches) {
+        auto content = pd::Patch::prepareContent(this, saved.location.existsAsFile() ? saved.location.loadFileAsString() : saved.content);
+        if (!content)
+            return false;
+
+        contents.push_back(std::move(content));
+    }
+
+    lockAudioThread();
+    setThis();
+
+    bool canSwitch = target.patches.size() == patches.size();
+    for (int i = 0; canSwitch && i < patches.size(); i++) {
+        canSwitch = patches[i]->getPointer() && patches[i]->openInPluginMode == target.patches[i].pluginMode;
+    }
+
+    if (!canSwitch) {
+        unlockAudioThread();
+        return false;
+    }
+
+    for (int i = 0; i < patches.size(); i++) {
+        auto const& patch = patches[i];
+        auto const& saved = target.patches[i];
+
+        if (saved.location.existsAsFile()) {
+            patch->updateContent(contents[i], saved.location);
+            patch->setTitle(saved.location.getFileName());
+        } else {
+            if (saved.location.getParentDirectory().exists()) {
+                libpd_add_to_search_path(saved.location.getParentDirectory().getFullPathName().toRawUTF8());
             }
+            patch->updateContent(contents[i], File());
         }
 
-        // JYG added this
-        parseDataBuffer(*xmlState);
+        patch->splitViewIndex = saved.splitIndex;
     }
-    
-    unlockAudioThread();
 
-    delete[] xmlData;
+    applyStateSettings(target);
+
+    unlockAudioThread();
 
     if (auto* editor = dynamic_cast<PluginEditor*>(getActiveEditor())) {
         MessageManager::callAsync([editor = Component::SafePointer(editor)]() {
             if (!editor)
                 return;
-            editor->sidebar->updateAutomationParameters();
 
-            if (editor->pluginMode && !editor->pd->isInPluginMode()) {
-                editor->pluginMode->closePluginMode();
+            // Subpatches that were open may have been replaced
+            for (int i = editor->canvases.size() - 1; i >= 0; i--) {
+                if (!editor->canvases[i]->patch.getPointer()) {
+                    editor->closeTab(editor->canvases[i]);
+                }
+            }
+
+            for (auto* cnv : editor->canvases) {
+                cnv->synchronise();
             }
+
+            editor->sidebar->updateAutomationParameters();
         });
     }
+
+    logMessage("Switched state in " + String(Time::getMillisecondCounterHiRes() - startTime, 1) + " ms");
+    return true;
 }
 
 pd::Patch::Ptr PluginProcessor::loadPatch(File const& patchFile, int splitIdx)
@@ -1237,7 +1573,8 @@ pd::Patch::Ptr PluginProcessor::loadPatch(String patchText, int splitIdx)
     auto patch = loadPatch(patchFile, splitIdx);
 
     // Set to unknown file when loading temp patch
-    patch->setCurrentFile(File());
+    if (patch)
+        patch->setCurrentFile(File());
 
     return patch;
 }
@@ -1400,6 +1737,15 @@ void PluginProcessor::receiveSysMessage(String const& selector, std::vector<pd::
                 if (auto* editor = dynamic_cast<PluginEditor*>(getActiveEditor())) {
                     editor->statusbar->powerButton.setToggleState(dsp, dontSendNotification);
                 }
+
+                // Report how much time lua's garbage collector took from the audio blocks while DSP was running
+                // This waits for the lua lock, so it can't be done from the audio thread
+                if (!dsp && libpd_lua_gc_active()) {
+                    auto stats = getLuaGCStats();
+                    if (stats.steps) {
+                        logMessage("Lua garbage collection: " + String(stats.totalTime, 2) + " ms in " + String(stats.steps) + " steps, longest block " + String(stats.maxBlockTime, 3) + " ms, " + String(stats.cycles) + " cycles, " + File::descriptionOfSizeInBytes(static_cast<int64>(stats.memoryUsage)) + " in use");
+                    }
+                }
             });
         break;
     }
@@ -1628,6 +1974,10 @@ void PluginProcessor::reloadAbstractions(File changedPatch, t_glist* except)
     // Ensure that all messages are dequeued before we start deleting objects
     sendMessagesFromQueue();
 
+    // The file may have been rewritten within the resolution of its modification time, so don't rely on that
+    libpd_abstraction_cache_invalidate();
+    libpd_binary_patch_invalidate(changedPatch.getFullPathName().replace("\\", "/").toRawUTF8());
+
     isPerformingGlobalSync = true;
 
     pd::Patch::reloadPatch(changedPatch, except);
@@ -1655,6 +2005,18 @@ void PluginProcessor::reloadAbstractions(File changedPatch, t_glist* except)
     }
 }
 
+void PluginProcessor::dspGraphChanged()
+{
+    if (auto* editor = dynamic_cast<PluginEditor*>(getActiveEditor())) {
+        // Signal connections show how many channels they carry, which depends on the new graph
+        lockAudioThread();
+        for (auto* cnv : editor->canvases) {
+            Connection::updateNumSignalChannels(cnv->connections);
+        }
+        unlockAudioThread();
+    }
+}
+
 void PluginProcessor::titleChanged()
 {
     if (auto* editor = dynamic_cast<PluginEditor*>(getActiveEditor())) {
@@ -19,6 +19,7 @@ class Library;
 }
 
 class InternalSynth;
+class Autosave;
 class SettingsFile;
 class StatusbarSource;
 class PlugDataLook;
@@ -115,6 +116,8 @@ public:
 
     void titleChanged() override;
 
+    void dspGraphChanged() override;
+
     void setTheme(String themeToUse, bool force = false);
 
     Colour getForegroundColour() override;
@@ -160,9 +163,61 @@ public:
     std::unique_ptr<InternalSynth> internalSynth;
     std::atomic<bool> enableInternalSynth = false;
 
+    std::unique_ptr<Autosave> autosave;
+
 private:
     void processInternal();
 
+    struct SavedPatch {
+        String content;
+        File location;
+        bool pluginMode = false;
+        int splitIndex = 0;
+
+        // Resolved by prepareState: the file pd should open, which is a temporary copy if the patch doesn't exist on disk
+        File fileToOpen;
+        bool isTemporary = false;
+    };
+
+    struct SavedState {
+        Array<SavedPatch> patches;
+        std::unique_ptr<XmlElement> xml;
+
+        int legacyLatency = 0;
+        int legacyOversampling = 0;
+        float legacyTail = 0.0f;
+    };
+
+    enum class StateError {
+        None,
+        NewerVersion,
+        Corrupted
+    };
+
+    // Reads both the compact and the legacy state format
+    static StateError parseState(MemoryBlock const& state, SavedState& result);
+
+    // Applies parameters and processor settings from a parsed state, call with the audio thread locked
+    void applyStateSettings(SavedState const& state);
+
+    // Parses the state and writes patches that only exist as content to temporary files, safe to call from any thread
+    static StateError prepareState(MemoryBlock const& state, SavedState& result);
+
+    // pd has read the temporary files once the patches are loaded, or they were never loaded because a newer state came in
+    static void deleteTemporaryFiles(SavedState const& state);
+
+    // Replaces the open patches and settings with a prepared state
+    // On the message thread, patches are loaded one per message loop iteration, so the host and the editor stay responsive
+    // Processing stays suspended until all patches are loaded, nothing happens if a newer state has been set in the meantime
+    void restoreState(std::shared_ptr<SavedState> state, StateError error, int generation, double startTime);
+    void restoreNextPatch(std::shared_ptr<SavedState> state, int index, int generation, double startTime);
+    void restoreSavedPatch(SavedPatch const& saved);
+    void finishStateRestore(SavedState const& state, bool applySettings, int generation, double startTime);
+
+    // Updates the open patches to match a state in place, instead of closing and reloading them
+    // Returns false if the state has a different set of patches, in which case it needs a full restore
+    bool switchState(MemoryBlock const& state);
+
     SmoothedValue<float, ValueSmoothingTypes::Linear> smoothedGain;
 
     int audioAdvancement = 0;
@@ -187,6 +242,16 @@ private:
     int lastSplitIndex = -1;
     int lastSetProgram = 0;
 
+    // State that is being restored by the background job, handed back to the host if it asks for our state in the meantime
+    CriticalSection stateRestoreLock;
+    MemoryBlock pendingState;
+    std::atomic<int> stateRestoreGeneration = 0;
+    ThreadPool stateRestorePool { 1 };
+
+    // Header for the compressed state format, the legacy format starts with the number of patches instead
+    static inline constexpr int compactStateMagic = 0x70645354;
+    static inline constexpr int compactStateVersion = 1;
+
     Limiter limiter;
     std::unique_ptr<dsp::Oversampling<float>> oversampler;
 
@@ -197,5 +262,6 @@ private:
     // this gets updated with live version data later
     static String pdlua_version;
 
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PluginProcessor)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginProcessor)
 };
@@ -0,0 +1,197 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen and Alex Mitchell
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "Autosave.h"
+#include "PluginProcessor.h"
+
+extern "C" {
+#include <m_pd.h>
+#include <g_canvas.h>
+}
+
+Autosave::Autosave(PluginProcessor* processor)
+    : Thread("Autosave")
+    , pd(processor)
+{
+    sessionLock.enter();
+    startThread();
+    startTimer(autosaveInterval);
+}
+
+Autosave::~Autosave()
+{
+    stopTimer();
+    stopThread(-1);
+
+    // We're shutting down cleanly, so the user has already decided what to do with their unsaved changes
+    sessionDir.deleteRecursively();
+    sessionLock.exit();
+}
+
+void Autosave::timerCallback()
+{
+    std::set<pd::Patch*> openPatches;
+
+    for (auto const& patch : pd->patches) {
+        openPatches.insert(patch.get());
+
+        auto existing = snapshots.find(patch.get());
+
+        if (!patch->isDirty()) {
+            // Patch was saved, we don't need to keep the snapshot around
+            if (existing != snapshots.end()) {
+                pendingWrites.enqueue({ existing->second.file, String() });
+                snapshots.erase(existing);
+            }
+            continue;
+        }
+
+        // Only hold the lock for as long as it takes to copy the patch content
+        pd->lockAudioThread();
+        auto content = patch->getCanvasContent();
+        pd->unlockAudioThread();
+
+        auto contentHash = content.hashCode64();
+        if (existing != snapshots.end() && existing->second.contentHash == contentHash)
+            continue;
+
+        auto& snapshot = snapshots[patch.get()];
+        if (snapshot.file == File()) {
+            snapshot.file = sessionDir.getChildFile(Uuid().toString()).withFileExtension(".autosave");
+        }
+        snapshot.contentHash = contentHash;
+
+        auto entry = XmlElement("Autosave");
+        entry.setAttribute("Content", content);
+        entry.setAttribute("Location", patch->getCurrentFile().getFullPathName());
+        entry.setAttribute("Time", Time::getCurrentTime().toISO8601(true));
+
+        pendingWrites.enqueue({ snapshot.file, entry.toString() });
+    }
+
+    // Patches that were closed don't need a snapshot anymore
+    for (auto it = snapshots.begin(); it != snapshots.end();) {
+        if (!openPatches.count(it->first)) {
+            pendingWrites.enqueue({ it->second.file, String() });
+            it = snapshots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    notify();
+}
+
+void Autosave::run()
+{
+    while (!threadShouldExit()) {
+        wait(-1);
+
+        PendingWrite write;
+        while (pendingWrites.try_dequeue(write)) {
+            if (write.content.isEmpty()) {
+                write.target.deleteFile();
+                continue;
+            }
+
+            write.target.getParentDirectory().createDirectory();
+
+            if (!writeFileAtomically(write.target, write.content)) {
+                // Nothing sensible to do here, we'll retry when the patch changes again
+                jassertfalse;
+            }
+        }
+    }
+}
+
+bool Autosave::writeFileAtomically(File const& target, String const& content)
+{
+    TemporaryFile tempFile(target, TemporaryFile::useHiddenFile);
+
+    {
+        FileOutputStream ostream(tempFile.getFile());
+
+        if (!ostream.openedOk())
+            return false;
+
+        ostream.writeText(content, false, false, "\n");
+
+        // Flushing a FileOutputStream calls fsync/FlushFileBuffers, so the data is on disk before we rename
+        ostream.flush();
+
+        if (ostream.getStatus().failed())
+            return false;
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+Array<File> Autosave::getRecoveryFiles()
+{
+    Array<File> recoveryFiles;
+
+    for (auto const& dir : autosaveDir.findChildFiles(File::findDirectories, false)) {
+        // If the lock is still held, that session is still running
+        InterProcessLock lock("plugdata_autosave_" + dir.getFileName());
+        if (!lock.enter(0))
+            continue;
+
+        auto files = dir.findChildFiles(File::findFiles, false, "*.autosave");
+        if (files.isEmpty()) {
+            dir.deleteRecursively();
+        }
+
+        recoveryFiles.addArray(files);
+    }
+
+    return recoveryFiles;
+}
+
+void Autosave::recover(PluginProcessor* processor, Array<File> const& recoveryFiles)
+{
+    for (auto const& file : recoveryFiles) {
+        auto entry = XmlDocument::parse(file);
+        if (!entry || !entry->hasTagName("Autosave"))
+            continue;
+
+        auto location = File(entry->getStringAttribute("Location"));
+
+        // The snapshot gets loaded from a temporary file, make sure abstractions next to the original can still be found
+        if (location.getParentDirectory().exists()) {
+            libpd_add_to_search_path(location.getParentDirectory().getFullPathName().toRawUTF8());
+        }
+
+        auto patch = processor->loadPatch(entry->getStringAttribute("Content"));
+        if (!patch)
+            continue;
+
+        if (location.existsAsFile()) {
+            patch->setCurrentFile(location);
+            patch->setTitle(location.getFileName());
+        } else {
+            patch->setTitle("Untitled Patcher");
+        }
+
+        // Mark the patch as dirty, so the user gets asked to save the recovered changes
+        if (auto cnv = patch->getPointer()) {
+            canvas_dirty(cnv.get(), 1);
+        }
+    }
+
+    discard(recoveryFiles);
+}
+
+void Autosave::discard(Array<File> const& recoveryFiles)
+{
+    for (auto const& file : recoveryFiles) {
+        auto dir = file.getParentDirectory();
+        file.deleteFile();
+
+        if (dir.findChildFiles(File::findFiles, false).isEmpty()) {
+            dir.deleteRecursively();
+        }
+    }
+}
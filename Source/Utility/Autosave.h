@@ -0,0 +1,69 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen and Alex Mitchell
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <concurrentqueue.h>
+
+#include "Utility/Config.h"
+
+class PluginProcessor;
+
+namespace pd {
+class Patch;
+}
+
+// Periodically stores a recovery snapshot of every dirty patch, so unsaved work survives a crash
+// Snapshots are taken on the message thread while holding the audio lock, all file I/O happens on a background thread
+class Autosave : public Timer
+    , private Thread {
+public:
+    explicit Autosave(PluginProcessor* processor);
+
+    ~Autosave() override;
+
+    // Returns the snapshots left behind by sessions that didn't shut down cleanly
+    static Array<File> getRecoveryFiles();
+
+    // Reopens the snapshots as dirty patches, and removes them from disk
+    static void recover(PluginProcessor* processor, Array<File> const& recoveryFiles);
+    static void discard(Array<File> const& recoveryFiles);
+
+    // Writes to a temporary file that is synced to disk and then renamed over the target
+    // Readers of the target will always see either the old or the new content
+    static bool writeFileAtomically(File const& target, String const& content);
+
+private:
+    void timerCallback() override;
+    void run() override;
+
+    struct PendingWrite {
+        File target;
+        String content; // Empty content means the snapshot should be removed
+    };
+
+    struct Snapshot {
+        File file;
+        int64 contentHash = 0;
+    };
+
+    PluginProcessor* pd;
+
+    moodycamel::ConcurrentQueue<PendingWrite> pendingWrites;
+    std::map<pd::Patch*, Snapshot> snapshots;
+
+    // Every session writes to its own folder, which is locked for as long as the session is alive
+    // If we can acquire the lock of another folder, the session that created it must have crashed
+    String const sessionID = Uuid().toString();
+    File const sessionDir = autosaveDir.getChildFile(sessionID);
+    InterProcessLock sessionLock = InterProcessLock("plugdata_autosave_" + sessionID);
+
+    static inline File const autosaveDir = ProjectInfo::appDataDir.getChildFile("Autosave");
+    static inline constexpr int autosaveInterval = 30000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Autosave)
+};
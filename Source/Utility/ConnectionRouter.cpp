@@ -0,0 +1,342 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen and Alex Mitchell
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "ConnectionRouter.h"
+#include "SpatialIndex.h"
+
+#include <queue>
+
+ConnectionRouter::ConnectionRouter()
+    : Thread("Connection Router")
+{
+}
+
+ConnectionRouter::~ConnectionRouter()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(-1);
+}
+
+bool ConnectionRouter::findRoute(void* id, Point<float> start, Point<float> end, std::vector<Rectangle<float>> obstacles, Callback callback, Route& cachedRoute)
+{
+    auto key = getKey(start, end, obstacles);
+
+    ScopedLock sl(lock);
+
+    auto& generation = latestGeneration[id];
+    generation = ++nextGeneration;
+
+    if (auto cached = cache.find(key.hash); cached != cache.end() && cached->second.key == key) {
+        cachedRoute = cached->second.route;
+        for (auto& point : cachedRoute)
+            point += start;
+        return true;
+    }
+
+    // Requests that haven't started yet are replaced, a running search notices that it's outdated
+    pendingRequests.erase(std::remove_if(pendingRequests.begin(), pendingRequests.end(), [id](auto const& request) { return request.id == id; }), pendingRequests.end());
+    pendingRequests.push_back({ id, generation, std::move(key), start, end, std::move(obstacles), std::move(callback) });
+
+    // Only start the thread once something actually needs routing
+    if (!isThreadRunning())
+        startThread();
+
+    notify();
+    return false;
+}
+
+void ConnectionRouter::cancel(void* id)
+{
+    ScopedLock sl(lock);
+    latestGeneration.erase(id);
+    pendingRequests.erase(std::remove_if(pendingRequests.begin(), pendingRequests.end(), [id](auto const& request) { return request.id == id; }), pendingRequests.end());
+}
+
+void ConnectionRouter::run()
+{
+    while (!threadShouldExit()) {
+        Request request;
+        {
+            ScopedLock sl(lock);
+            if (!pendingRequests.empty()) {
+                request = std::move(pendingRequests.front());
+                pendingRequests.pop_front();
+            }
+        }
+
+        if (!request.id) {
+            wait(-1);
+            continue;
+        }
+
+        auto isOutdated = [this, &request]() {
+            if (threadShouldExit())
+                return true;
+
+            ScopedLock sl(lock);
+            auto latest = latestGeneration.find(request.id);
+            return latest == latestGeneration.end() || latest->second != request.generation;
+        };
+
+        auto route = search(request.start, request.end, request.obstacles, isOutdated);
+
+        if (isOutdated())
+            continue;
+
+        if (!route.empty()) {
+            ScopedLock sl(lock);
+            if (cache.size() >= maxCacheSize)
+                cache.clear();
+
+            auto& cached = cache[request.key.hash];
+            cached.route = route;
+            for (auto& point : cached.route)
+                point -= request.start;
+            cached.key = std::move(request.key);
+        }
+
+        MessageManager::callAsync([callback = std::move(request.callback), route = std::move(route)]() {
+            callback(route);
+        });
+    }
+}
+
+ConnectionRouter::Key ConnectionRouter::getKey(Point<float> start, Point<float> end, std::vector<Rectangle<float>> const& obstacles)
+{
+    auto round = [](float value) { return static_cast<int>(std::round(value)); };
+
+    // Everything is relative to the start point
+    Key key;
+    key.end = { round(end.x - start.x), round(end.y - start.y) };
+    key.obstacles.reserve(obstacles.size());
+    for (auto const& obstacle : obstacles) {
+        key.obstacles.emplace_back(round(obstacle.getX() - start.x), round(obstacle.getY() - start.y), round(obstacle.getWidth()), round(obstacle.getHeight()));
+    }
+
+    // The spatial index returns objects in no particular order
+    std::sort(key.obstacles.begin(), key.obstacles.end(), [](auto const& a, auto const& b) {
+        return std::make_tuple(a.getY(), a.getX(), a.getWidth(), a.getHeight()) < std::make_tuple(b.getY(), b.getX(), b.getWidth(), b.getHeight());
+    });
+
+    auto hash = static_cast<uint64>(0xcbf29ce484222325ull);
+    auto add = [&hash](int value) {
+        hash ^= static_cast<uint64>(static_cast<int64>(value));
+        hash *= 0x100000001b3ull;
+    };
+
+    add(key.end.x);
+    add(key.end.y);
+
+    for (auto const& obstacle : key.obstacles) {
+        add(obstacle.getX());
+        add(obstacle.getY());
+        add(obstacle.getWidth());
+        add(obstacle.getHeight());
+    }
+
+    key.hash = hash;
+    return key;
+}
+
+ConnectionRouter::Route ConnectionRouter::search(Point<float> start, Point<float> end, std::vector<Rectangle<float>> const& obstacles, std::function<bool()> const& shouldStop)
+{
+    // Routes keep this much distance from objects
+    constexpr float clearance = 8.0f;
+
+    // A bend costs as much as this many pixels of cable, so we prefer simple routes over slightly shorter ones
+    constexpr float bendCost = 24.0f;
+
+    // Give up on layouts that would take too long to search, the caller shows a simple path instead
+    constexpr int maxExpansions = 20000;
+
+    // The only useful places to turn are next to obstacles, or in line with the start or end point
+    // Searching on that grid finds the same routes as searching on every pixel, with a fraction of the nodes
+    std::vector<float> xs = { start.x, end.x };
+    std::vector<float> ys = { start.y, end.y, start.y + clearance, end.y - clearance };
+
+    for (auto const& obstacle : obstacles) {
+        xs.push_back(obstacle.getX() - clearance);
+        xs.push_back(obstacle.getRight() + clearance);
+        ys.push_back(obstacle.getY() - clearance);
+        ys.push_back(obstacle.getBottom() + clearance);
+    }
+
+    auto makeUnique = [](std::vector<float>& values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+    };
+
+    makeUnique(xs);
+    makeUnique(ys);
+
+    auto const numX = static_cast<int>(xs.size());
+    auto const numY = static_cast<int>(ys.size());
+
+    auto indexOf = [](std::vector<float> const& values, float value) {
+        return static_cast<int>(std::lower_bound(values.begin(), values.end(), value) - values.begin());
+    };
+
+    auto const startX = indexOf(xs, start.x), startY = indexOf(ys, start.y);
+    auto const endX = indexOf(xs, end.x), endY = indexOf(ys, end.y);
+
+    // Steps only go to the neighbouring grid line, so they're short and only touch a few cells of the index
+    SpatialIndex<Rectangle<float> const> obstacleIndex;
+    for (auto const& obstacle : obstacles) {
+        obstacleIndex.update(&obstacle, obstacle.getSmallestIntegerContainer());
+    }
+
+    auto isBlocked = [&obstacleIndex](Point<float> a, Point<float> b) {
+        auto const left = std::min(a.x, b.x), right = std::max(a.x, b.x);
+        auto const top = std::min(a.y, b.y), bottom = std::max(a.y, b.y);
+        auto const area = Rectangle<float>::leftTopRightBottom(left, top, right, bottom).getSmallestIntegerContainer();
+
+        return obstacleIndex.anyNear(area, [&](Rectangle<float> const* obstacle) {
+            // Also works for segments, which have no width or height
+            return right > obstacle->getX() && left < obstacle->getRight() && bottom > obstacle->getY() && top < obstacle->getBottom();
+        });
+    };
+
+    // Nodes are grid points combined with the direction we arrived in, 0 is vertical and 1 is horizontal
+    auto nodeIndex = [numY](int x, int y, int direction) { return ((x * numY) + y) * 2 + direction; };
+
+    // The node arrays are kept between searches, and a node only counts as visited if it was stamped by this search
+    // That way a search doesn't have to allocate or clear anything in proportion to the size of the grid
+    struct Scratch {
+        std::vector<float> cost;
+        std::vector<int> previous;
+        std::vector<uint32> stamp;
+        uint32 currentStamp = 0;
+    };
+    thread_local Scratch scratch;
+
+    auto const numNodes = static_cast<size_t>(numX) * numY * 2;
+    if (scratch.stamp.size() < numNodes) {
+        scratch.cost.resize(numNodes);
+        scratch.previous.resize(numNodes);
+        scratch.stamp.resize(numNodes, 0);
+    }
+    if (++scratch.currentStamp == 0) {
+        std::fill(scratch.stamp.begin(), scratch.stamp.end(), 0);
+        scratch.currentStamp = 1;
+    }
+
+    auto& cost = scratch.cost;
+    auto& previous = scratch.previous;
+    auto getCost = [&scratch](int node) {
+        return scratch.stamp[node] == scratch.currentStamp ? scratch.cost[node] : std::numeric_limits<float>::max();
+    };
+
+    using QueueEntry = std::pair<float, int>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> queue;
+
+    auto heuristic = [&](int x, int y) {
+        return std::abs(xs[x] - end.x) + std::abs(ys[y] - end.y);
+    };
+
+    // Cables leave an outlet going down, so we start out vertically
+    auto const startNode = nodeIndex(startX, startY, 0);
+    scratch.stamp[startNode] = scratch.currentStamp;
+    cost[startNode] = 0.0f;
+    previous[startNode] = -1;
+    queue.push({ heuristic(startX, startY), startNode });
+
+    int found = -1;
+    int expanded = 0;
+
+    while (!queue.empty()) {
+        auto [estimate, node] = queue.top();
+        queue.pop();
+
+        auto const direction = node % 2;
+        auto const y = (node / 2) % numY;
+        auto const x = (node / 2) / numY;
+
+        if (estimate - heuristic(x, y) > cost[node])
+            continue; // outdated queue entry
+
+        if (x == endX && y == endY) {
+            found = node;
+            break;
+        }
+
+        if (++expanded > maxExpansions)
+            return {};
+
+        if (shouldStop && (expanded & 255) == 0 && shouldStop())
+            return {};
+
+        auto const here = Point<float>(xs[x], ys[y]);
+
+        auto tryStep = [&](int nx, int ny, int newDirection) {
+            if (nx < 0 || ny < 0 || nx >= numX || ny >= numY)
+                return;
+
+            auto const there = Point<float>(xs[nx], ys[ny]);
+            if (isBlocked(here, there))
+                return;
+
+            auto newCost = cost[node] + here.getDistanceFrom(there) + (newDirection != direction ? bendCost : 0.0f);
+
+            // Entering an inlet sideways needs an extra bend
+            if (nx == endX && ny == endY && newDirection != 0)
+                newCost += bendCost;
+
+            auto const next = nodeIndex(nx, ny, newDirection);
+            if (newCost < getCost(next)) {
+                scratch.stamp[next] = scratch.currentStamp;
+                cost[next] = newCost;
+                previous[next] = node;
+                queue.push({ newCost + heuristic(nx, ny), next });
+            }
+        };
+
+        tryStep(x, y - 1, 0);
+        tryStep(x, y + 1, 0);
+        tryStep(x - 1, y, 1);
+        tryStep(x + 1, y, 1);
+    }
+
+    if (found < 0)
+        return {};
+
+    Route points;
+    for (int node = found; node >= 0; node = previous[node]) {
+        points.emplace_back(xs[(node / 2) / numY], ys[(node / 2) % numY]);
+    }
+    std::reverse(points.begin(), points.end());
+
+    // Only keep the corners
+    Route corners;
+    for (size_t n = 0; n < points.size(); n++) {
+        if (n == 0 || n == points.size() - 1) {
+            corners.push_back(points[n]);
+            continue;
+        }
+
+        auto const& a = points[n - 1];
+        auto const& b = points[n];
+        auto const& c = points[n + 1];
+        if (!((a.x == b.x && b.x == c.x) || (a.y == b.y && b.y == c.y)))
+            corners.push_back(b);
+    }
+
+    // Make sure we start and end with a vertical segment, a zero-length one if needed
+    Route route;
+    route.push_back(start);
+    if (corners.size() > 1 && corners[0].y == corners[1].y)
+        route.push_back(start);
+
+    for (size_t n = 1; n + 1 < corners.size(); n++) {
+        route.push_back(corners[n]);
+    }
+
+    if (corners.size() > 1 && corners[corners.size() - 2].y == corners.back().y)
+        route.push_back(end);
+    route.push_back(end);
+
+    return route;
+}
@@ -0,0 +1,75 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen and Alex Mitchell
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <deque>
+
+// Finds orthogonal connection paths around objects on a background thread
+// Requests only contain plain geometry, so the search never touches any components
+// Routes are found with A* on a grid made of the edges of the obstacles, preferring short routes with few bends
+// Canvases share a single router through a SharedResourcePointer, so there is only one routing thread
+class ConnectionRouter : private Thread {
+public:
+    using Route = std::vector<Point<float>>;
+    using Callback = std::function<void(Route const&)>;
+
+    ConnectionRouter();
+    ~ConnectionRouter() override;
+
+    // Returns true and fills in the route straight away if we've routed the same geometry before
+    // Otherwise, the route is searched in the background and the callback is invoked on the message thread
+    // A new request with the same id cancels the previous one, if that one hasn't finished yet
+    bool findRoute(void* id, Point<float> start, Point<float> end, std::vector<Rectangle<float>> obstacles, Callback callback, Route& cachedRoute);
+
+    // Cancels a pending request, for when the requester is going away
+    void cancel(void* id);
+
+    // Finds the shortest route with the least bends from start to end, that doesn't cross any of the obstacles
+    // Segments alternate between vertical and horizontal, starting and ending with a vertical one
+    // Returns an empty route if there is no way around, if that takes too long to find, or if the search was cancelled
+    static Route search(Point<float> start, Point<float> end, std::vector<Rectangle<float>> const& obstacles, std::function<bool()> const& shouldStop = nullptr);
+
+private:
+    // Geometry of a request relative to its start point, with the obstacles in a fixed order
+    struct Key {
+        Point<int> end;
+        std::vector<Rectangle<int>> obstacles;
+        uint64 hash = 0;
+
+        bool operator==(Key const& other) const = default;
+    };
+
+    struct Request {
+        void* id = nullptr;
+        uint64 generation = 0;
+        Key key;
+        Point<float> start, end;
+        std::vector<Rectangle<float>> obstacles;
+        Callback callback;
+    };
+
+    void run() override;
+
+    static Key getKey(Point<float> start, Point<float> end, std::vector<Rectangle<float>> const& obstacles);
+
+    CriticalSection lock;
+    std::deque<Request> pendingRequests;
+    std::unordered_map<void*, uint64> latestGeneration;
+    uint64 nextGeneration = 0;
+
+    // Routes are stored relative to their start point, so moving a group of objects together still hits the cache
+    // The full key is kept, so a hash collision is a miss instead of somebody else's route
+    struct CachedRoute {
+        Key key;
+        Route route;
+    };
+    std::unordered_map<uint64, CachedRoute> cache;
+    static inline constexpr size_t maxCacheSize = 1024;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConnectionRouter)
+};
@@ -0,0 +1,119 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen and Alex Mitchell
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include "FrameScheduler.h"
+
+FrameScheduler::Listener::~Listener()
+{
+    if (scheduler)
+        scheduler->removeListener(this);
+}
+
+FrameScheduler::FrameScheduler(Component* component)
+    : vBlankAttachment(component, [this]() { onVBlank(); })
+{
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    for (auto& client : clients) {
+        if (client.listener)
+            client.listener->scheduler = nullptr;
+    }
+}
+
+void FrameScheduler::addListener(Listener* listener, int hz)
+{
+    jassert(hz > 0);
+    auto divisor = getDivisor(hz);
+
+    for (auto& client : clients) {
+        if (client.listener == listener) {
+            client.hz = hz;
+            client.framesLeft = std::min(client.framesLeft, divisor);
+            return;
+        }
+    }
+
+    // Spread listeners with the same rate over different frames
+    clients.push_back({ listener, hz, 1 + static_cast<int>(clients.size() % divisor) });
+    listener->scheduler = this;
+}
+
+void FrameScheduler::removeListener(Listener* listener)
+{
+    for (auto it = clients.begin(); it != clients.end(); ++it) {
+        if (it->listener != listener)
+            continue;
+
+        // We can't change the vector while iterating over it, so we clean it up after the frame
+        if (isDispatching) {
+            it->listener = nullptr;
+        } else {
+            clients.erase(it);
+        }
+
+        listener->scheduler = nullptr;
+        return;
+    }
+}
+
+bool FrameScheduler::hasListener(Listener* listener) const
+{
+    return std::any_of(clients.begin(), clients.end(), [listener](Client const& client) {
+        return client.listener == listener;
+    });
+}
+
+void FrameScheduler::repaintOnNextFrame(Component* component)
+{
+    pendingRepaints.addIfNotAlreadyThere(component);
+}
+
+int FrameScheduler::getDivisor(int hz) const
+{
+    return std::max(1, roundToInt(refreshRate / static_cast<double>(hz)));
+}
+
+void FrameScheduler::onVBlank()
+{
+    auto now = Time::getMillisecondCounterHiRes();
+    auto frameTime = now - lastFrameTime;
+    lastFrameTime = now;
+
+    // Ignore long gaps, those happen when the window was hidden or the message thread was busy
+    if (frameTime > 2.0 && frameTime < 100.0) {
+        refreshRate = refreshRate * 0.9 + (1000.0 / frameTime) * 0.1;
+    }
+
+    numFrames++;
+
+    isDispatching = true;
+
+    // Listeners that get added during the callbacks will be called on the next frame
+    auto numClients = clients.size();
+    for (size_t i = 0; i < numClients; i++) {
+        if (!clients[i].listener || --clients[i].framesLeft > 0)
+            continue;
+
+        clients[i].framesLeft = getDivisor(clients[i].hz);
+        clients[i].listener->frameCallback();
+        numCallbacks++;
+    }
+
+    isDispatching = false;
+
+    clients.erase(std::remove_if(clients.begin(), clients.end(), [](Client const& client) {
+        return client.listener == nullptr;
+    }),
+        clients.end());
+
+    for (auto& component : pendingRepaints) {
+        if (component)
+            component->repaint();
+    }
+    pendingRepaints.clear();
+}
@@ -0,0 +1,69 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen and Alex Mitchell
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Drives periodic GUI updates from the display refresh, instead of every object running its own timer
+// Listeners are called on every nth frame, where n is picked to get as close as possible to the rate they ask for
+// Repaints can be deferred to the end of the next frame, so components that get many updates are only invalidated once per frame
+class FrameScheduler {
+public:
+    class Listener {
+    public:
+        virtual ~Listener();
+
+        virtual void frameCallback() = 0;
+
+    private:
+        FrameScheduler* scheduler = nullptr;
+        friend class FrameScheduler;
+    };
+
+    explicit FrameScheduler(Component* component);
+
+    ~FrameScheduler();
+
+    // Starts calling the listener about hz times per second, or changes the rate if it was already added
+    void addListener(Listener* listener, int hz);
+    void removeListener(Listener* listener);
+    bool hasListener(Listener* listener) const;
+
+    void repaintOnNextFrame(Component* component);
+
+    // Estimated from the time between frames
+    double getRefreshRate() const { return refreshRate; }
+
+    int64 getNumFrames() const { return numFrames; }
+    int64 getNumCallbacks() const { return numCallbacks; }
+
+private:
+    void onVBlank();
+
+    int getDivisor(int hz) const;
+
+    struct Client {
+        Listener* listener;
+        int hz;
+        int framesLeft;
+    };
+
+    std::vector<Client> clients;
+    Array<Component::SafePointer<Component>> pendingRepaints;
+
+    bool isDispatching = false;
+
+    double refreshRate = 60.0;
+    double lastFrameTime = 0.0;
+
+    int64 numFrames = 0;
+    int64 numCallbacks = 0;
+
+    VBlankAttachment vBlankAttachment;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameScheduler)
+};
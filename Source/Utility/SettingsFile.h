@@ -93,6 +93,8 @@ private:
         { "theme", var("light") },
         { "oversampling", var(0) },
         { "protected", var(1) },
+        { "undo_memory_limit", var(64) },
+        { "lua_gc_budget", var(100) },
         { "internal_synth", var(0) },
         { "grid_enabled", var(1) },
         { "grid_type", var(6) },
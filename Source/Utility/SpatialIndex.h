@@ -0,0 +1,158 @@
+/*
+ // Copyright (c) 2021-2023 Timothy Schoen and Alex Mitchell
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+// Uniform grid over canvas coordinates, so we can find the components near a point or inside an area
+// without looking at every component on the canvas. Items are stored in every cell that their bounds touch
+template<typename T>
+class SpatialIndex {
+public:
+    void update(T* item, Rectangle<int> bounds)
+    {
+        auto existing = items.find(item);
+        if (existing != items.end()) {
+            auto oldBounds = existing->second;
+            existing->second = bounds;
+
+            // Most moves stay within the same cells
+            if (getCellRange(oldBounds) == getCellRange(bounds))
+                return;
+
+            forEachCell(getCellRange(oldBounds), [this, item](int64 key) {
+                removeFromCell(key, item);
+            });
+        } else {
+            items[item] = bounds;
+        }
+
+        forEachCell(getCellRange(bounds), [this, item](int64 key) {
+            cells[key].push_back(item);
+        });
+    }
+
+    void remove(T* item)
+    {
+        auto existing = items.find(item);
+        if (existing == items.end())
+            return;
+
+        forEachCell(getCellRange(existing->second), [this, item](int64 key) {
+            removeFromCell(key, item);
+        });
+
+        items.erase(existing);
+    }
+
+    // Returns every item whose bounds intersect the area, each item only once
+    Array<T*> query(Rectangle<int> area) const
+    {
+        Array<T*> result;
+        auto range = getCellRange(area);
+
+        // For very large areas, it's faster to just check every item
+        if (static_cast<int64>(range.getWidth() + 1) * (range.getHeight() + 1) > static_cast<int64>(items.size())) {
+            for (auto const& [item, bounds] : items) {
+                if (bounds.intersects(area))
+                    result.add(item);
+            }
+            return result;
+        }
+
+        forEachCell(range, [this, &result, &area, &range](int64 key) {
+            auto cell = cells.find(key);
+            if (cell == cells.end())
+                return;
+
+            for (auto* item : cell->second) {
+                auto const& bounds = items.at(item);
+                if (!bounds.intersects(area))
+                    continue;
+
+                // An item that spans multiple cells is only reported by the first cell that both the item and area touch
+                auto itemRange = getCellRange(bounds);
+                auto cellX = static_cast<int>(key >> 32);
+                auto cellY = static_cast<int>(static_cast<uint32>(key));
+                if (cellX == std::max(itemRange.getX(), range.getX()) && cellY == std::max(itemRange.getY(), range.getY()))
+                    result.add(item);
+            }
+        });
+
+        return result;
+    }
+
+    Array<T*> query(Point<int> position) const
+    {
+        return query(Rectangle<int>(position.x, position.y, 1, 1));
+    }
+
+    // Calls the callback with every item stored in the cells that the area touches, until it returns true
+    // Items can be visited more than once and don't have to intersect the area, but nothing is allocated,
+    // so this is meant for quick tests that are done very often
+    template<typename Callback>
+    bool anyNear(Rectangle<int> area, Callback callback) const
+    {
+        auto range = getCellRange(area);
+        for (int x = range.getX(); x <= range.getRight(); x++) {
+            for (int y = range.getY(); y <= range.getBottom(); y++) {
+                auto cell = cells.find((static_cast<int64>(x) << 32) | static_cast<uint32>(y));
+                if (cell == cells.end())
+                    continue;
+
+                for (auto* item : cell->second) {
+                    if (callback(item))
+                        return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    static constexpr int cellShift = 7; // 128 pixel cells
+
+    // Inclusive range of cells that the bounds touch
+    static Rectangle<int> getCellRange(Rectangle<int> bounds)
+    {
+        auto x1 = bounds.getX() >> cellShift;
+        auto y1 = bounds.getY() >> cellShift;
+        auto x2 = (bounds.getRight() - (bounds.getWidth() > 0)) >> cellShift;
+        auto y2 = (bounds.getBottom() - (bounds.getHeight() > 0)) >> cellShift;
+        return { x1, y1, x2 - x1, y2 - y1 };
+    }
+
+    template<typename Callback>
+    static void forEachCell(Rectangle<int> range, Callback callback)
+    {
+        for (int x = range.getX(); x <= range.getRight(); x++) {
+            for (int y = range.getY(); y <= range.getBottom(); y++) {
+                callback((static_cast<int64>(x) << 32) | static_cast<uint32>(y));
+            }
+        }
+    }
+
+    void removeFromCell(int64 key, T* item)
+    {
+        auto cell = cells.find(key);
+        if (cell == cells.end())
+            return;
+
+        auto& cellItems = cell->second;
+        auto it = std::find(cellItems.begin(), cellItems.end(), item);
+        if (it != cellItems.end()) {
+            *it = cellItems.back();
+            cellItems.pop_back();
+        }
+
+        if (cellItems.empty())
+            cells.erase(cell);
+    }
+
+    std::unordered_map<int64, std::vector<T*>> cells;
+    std::unordered_map<T*, Rectangle<int>> items;
+};
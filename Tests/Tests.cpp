@@ -5,6 +5,30 @@
 #define Rectangle juce::Rectangle
 
 #include <PluginProcessor.h>
+#include <x_libpd_path_cache.h>
+#include <x_libpd_binary_patch.h>
+#include <x_libpd_abstraction_cache.h>
+#include <x_libpd_array_sidecar.h>
+#include <x_libpd_undo_budget.h>
+#include <Utility/Autosave.h>
+
+extern "C" {
+#include <g_canvas.h>
+#include <g_undo.h>
+}
+
+#if COUNT_FILE_OPENS
+// The tests are linked with --wrap=sys_trytoopenone, so every file that pd or one of its loaders
+// tries to open in a search path goes through here
+static std::atomic<int> fileOpens = 0;
+
+extern "C" int __real_sys_trytoopenone(char const* dir, char const* name, char const* ext, char* dirresult, char** nameresult, unsigned int size, int bin);
+extern "C" int __wrap_sys_trytoopenone(char const* dir, char const* name, char const* ext, char* dirresult, char** nameresult, unsigned int size, int bin)
+{
+    fileOpens++;
+    return __real_sys_trytoopenone(dir, name, ext, dirresult, nameresult, size, bin);
+}
+#endif
 
 
 #include <juce_core/system/juce_TargetPlatform.h>
@@ -37,6 +61,19 @@ extern juce::JUCEApplicationBase* juce_CreateApplication();
                             MessageManager::getInstance()->runDispatchLoop();
 #endif
 
+// Fills a canvas with a chain of [+ n] objects in rows of 100, each one connected to the next
+static std::vector<void*> createObjectChain(PluginEditor* editor, Canvas* cnv, int numObjects)
+{
+    std::vector<void*> created;
+    editor->pd->lockAudioThread();
+    for (int i = 0; i < numObjects; i++) {
+        created.push_back(cnv->patch.createObject(i % 100 * 60, i / 100 * 30, "+ " + String(i)));
+        if (i > 0)
+            cnv->patch.createConnection(created[i - 1], 0, created[i], 0);
+    }
+    editor->pd->unlockAudioThread();
+    return created;
+}
 
 TEST_CASE("Plugin instance name", "[name]")
 {
@@ -77,3 +114,898 @@ TEST_CASE("Create and delete objects", "[name]")
     
     StopApplicationAfter(1500);
 }
+
+TEST_CASE("Autosave snapshots can be recovered", "[name]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        // Pretend that a session crashed and left a snapshot behind, nobody holds the lock on its folder
+        auto crashedSession = ProjectInfo::appDataDir.getChildFile("Autosave").getChildFile(Uuid().toString());
+        auto snapshot = crashedSession.getChildFile("patch.autosave");
+        crashedSession.createDirectory();
+
+        auto entry = XmlElement("Autosave");
+        entry.setAttribute("Content", "#N canvas 0 50 450 300 12;\n#X obj 10 10 + 1;\n");
+        entry.setAttribute("Location", crashedSession.getChildFile("missing.pd").getFullPathName());
+
+        REQUIRE(Autosave::writeFileAtomically(snapshot, entry.toString()));
+
+        // The temporary file was renamed over the snapshot
+        REQUIRE(crashedSession.findChildFiles(File::findFiles, false).size() == 1);
+        REQUIRE(XmlDocument::parse(snapshot)->getStringAttribute("Content") == entry.getStringAttribute("Content"));
+
+        REQUIRE(Autosave::getRecoveryFiles().contains(snapshot));
+
+        auto numPatches = editor->pd->patches.size();
+        Autosave::recover(editor->pd, { snapshot });
+
+        // The snapshot is opened as an unsaved patch and removed from disk
+        REQUIRE(editor->pd->patches.size() == numPatches + 1);
+        auto recovered = editor->pd->patches.getLast();
+        REQUIRE(recovered->isDirty());
+        REQUIRE(!crashedSession.exists());
+
+        // Saving goes through a hidden temporary file, which must be gone afterwards
+        auto dir = File::createTempFile("").getSiblingFile("plugdata_atomic_save_test");
+        dir.createDirectory();
+        auto target = dir.getChildFile("recovered.pd");
+        target.replaceWithText("old content");
+
+        recovered->savePatch(target);
+
+        REQUIRE(target.loadFileAsString().contains("#X obj 10 10 + 1;"));
+        REQUIRE(dir.findChildFiles(File::findFiles, false).size() == 1);
+        REQUIRE(!recovered->isDirty());
+
+        dir.deleteRecursively();
+    });
+
+    StopApplicationAfter(3000);
+}
+
+TEST_CASE("Turning DSP off while a graph rebuild is pending", "[name]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto* cnv = editor->getCurrentCanvas();
+
+        editor->pd->lockAudioThread();
+        editor->pd->setThis();
+        editor->pd->startDSP();
+        REQUIRE(pd_getdspstate() == 1);
+
+        // Creating an object suspends DSP until the graph is rebuilt
+        cnv->patch.createObject(10, 10, "osc~ 440");
+        REQUIRE(pd_getdspstate() == 0);
+
+        // This is what [; pd dsp 0( does, pd ignores it because DSP is already suspended
+        editor->pd->sendMessage("pd", "dsp", { 0.0f });
+        editor->pd->unlockAudioThread();
+
+        // Give the pending update time to be flushed, by an audio block or by the fallback timer
+        Timer::callAfterDelay(500, [=]() {
+            editor->pd->lockAudioThread();
+            editor->pd->setThis();
+            REQUIRE(pd_getdspstate() == 0);
+
+            // Turning it back on while an update is pending leaves it on
+            editor->pd->startDSP();
+            cnv->patch.createObject(10, 40, "osc~ 220");
+            editor->pd->sendMessage("pd", "dsp", { 1.0f });
+            editor->pd->unlockAudioThread();
+
+            Timer::callAfterDelay(500, [=]() {
+                editor->pd->lockAudioThread();
+                editor->pd->setThis();
+                REQUIRE(pd_getdspstate() == 1);
+                editor->pd->unlockAudioThread();
+            });
+        });
+    });
+
+    StopApplicationAfter(2000);
+}
+
+TEST_CASE("Search path lookups are cached", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto dir = File::createTempFile("").getSiblingFile("plugdata_pathcache_test");
+        dir.createDirectory();
+        dir.getChildFile("pathcache_abs.pd").replaceWithText("#N canvas 0 50 450 300 12;\n#X obj 10 10 inlet;\n#X obj 10 50 outlet;\n#X connect 0 0 1 0;\n");
+
+        String content = "#N canvas 0 50 450 300 12;\n";
+        for (int i = 0; i < 100; i++) {
+            content += "#X obj 10 " + String(i * 20) + " pathcache_unknown_" + String(i) + ";\n";
+            content += "#X obj 200 " + String(i * 20) + " pathcache_abs;\n";
+        }
+
+        auto patchFile = dir.getChildFile("pathcache_test.pd");
+        patchFile.replaceWithText(content);
+
+        int lookups, hits, diskAccesses;
+
+        // A patch that is already open can't be loaded again, so the second load uses a copy
+        auto secondPatchFile = dir.getChildFile("pathcache_test_copy.pd");
+        secondPatchFile.replaceWithText(content);
+
+        libpd_path_cache_invalidate();
+        libpd_path_cache_reset_stats();
+#if COUNT_FILE_OPENS
+        fileOpens = 0;
+#endif
+
+        auto firstPatch = editor->pd->loadPatch(patchFile);
+        REQUIRE(firstPatch != nullptr);
+
+        libpd_path_cache_get_stats(&lookups, &hits, &diskAccesses);
+
+        // Every unknown class is resolved once, after that the abstraction is registered
+        REQUIRE(lookups == 101);
+        REQUIRE(hits == 1);
+
+        // Every directory in the search path is read once, instead of once per class
+        REQUIRE(diskAccesses < 100);
+
+#if COUNT_FILE_OPENS
+        // Each instance of the abstraction opens its file once. No listing has anything called
+        // pathcache_unknown_*, so pd's loaders never try an extension for those
+        REQUIRE(fileOpens <= 100);
+        fileOpens = 0;
+#endif
+
+        libpd_path_cache_reset_stats();
+
+        auto secondPatch = editor->pd->loadPatch(secondPatchFile);
+        REQUIRE(secondPatch != nullptr);
+
+        libpd_path_cache_get_stats(&lookups, &hits, &diskAccesses);
+
+        // The abstraction already has a creator, only the unknown classes are looked up again
+        // All listings are still fresh, so no directory is read or checked again
+        REQUIRE(lookups == 100);
+        REQUIRE(hits == 0);
+        REQUIRE(diskAccesses == 0);
+
+#if COUNT_FILE_OPENS
+        // The only files opened are the abstraction's, once per instance
+        REQUIRE(fileOpens <= 100);
+#endif
+
+        dir.deleteRecursively();
+    });
+
+    StopApplicationAfter(3000);
+}
+
+TEST_CASE("Abstractions are parsed once", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto dir = File::createTempFile("").getSiblingFile("plugdata_abscache_test");
+        dir.createDirectory();
+        auto abstraction = dir.getChildFile("abscache_abs.pd");
+        abstraction.replaceWithText("#N canvas 0 50 450 300 12;\n#X obj 10 10 inlet;\n#X obj 10 50 outlet;\n#X connect 0 0 1 0;\n");
+
+        String content = "#N canvas 0 50 450 300 12;\n";
+        for (int i = 0; i < 50; i++) {
+            content += "#X obj 10 " + String(i * 20) + " abscache_abs;\n";
+        }
+
+        // A patch that is already open can't be loaded again, so the second load uses a copy
+        auto patchFile = dir.getChildFile("abscache_test.pd");
+        auto secondPatchFile = dir.getChildFile("abscache_test_copy.pd");
+        patchFile.replaceWithText(content);
+        secondPatchFile.replaceWithText(content);
+
+        int hits, parses;
+
+        libpd_abstraction_cache_invalidate();
+        libpd_abstraction_cache_reset_stats();
+
+        REQUIRE(editor->pd->loadPatch(patchFile) != nullptr);
+
+        // Only the first instance reads the file
+        libpd_abstraction_cache_get_stats(&hits, &parses);
+        REQUIRE(parses == 1);
+        REQUIRE(hits == 49);
+
+        // Changing the abstraction makes it get parsed again, after that the new version is cached
+        abstraction.replaceWithText("#N canvas 0 50 450 300 12;\n#X obj 10 10 inlet;\n#X obj 10 30 f;\n#X obj 10 50 outlet;\n#X connect 0 0 1 0;\n#X connect 1 0 2 0;\n");
+        libpd_abstraction_cache_invalidate();
+        libpd_abstraction_cache_reset_stats();
+
+        REQUIRE(editor->pd->loadPatch(secondPatchFile) != nullptr);
+
+        libpd_abstraction_cache_get_stats(&hits, &parses);
+        REQUIRE(parses == 1);
+        REQUIRE(hits == 49);
+
+        dir.deleteRecursively();
+    });
+
+    StopApplicationAfter(3000);
+}
+
+TEST_CASE("Reloading abstractions keeps unchanged objects", "[name]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto dir = File::createTempFile("").getSiblingFile("plugdata_reload_test");
+        dir.createDirectory();
+        auto abstraction = dir.getChildFile("reload_abs.pd");
+        abstraction.replaceWithText("#N canvas 0 50 450 300 12;\n#X obj 10 10 inlet;\n#X obj 10 40 + 1;\n#X obj 10 70 * 2;\n#X obj 10 100 outlet;\n#X connect 0 0 1 0;\n#X connect 1 0 2 0;\n#X connect 2 0 3 0;\n");
+
+        auto patchFile = dir.getChildFile("reload_test.pd");
+        patchFile.replaceWithText("#N canvas 0 50 450 300 12;\n#X obj 10 10 reload_abs;\n#X obj 10 50 reload_abs;\n#X obj 10 90 reload_abs;\n");
+
+        auto patch = editor->pd->loadPatch(patchFile);
+        REQUIRE(patch != nullptr);
+
+        auto getContent = [](void* instance) {
+            std::vector<t_gobj*> content;
+            for (auto* y = static_cast<t_canvas*>(instance)->gl_list; y; y = y->g_next)
+                content.push_back(y);
+            return content;
+        };
+
+        editor->pd->lockAudioThread();
+        auto instances = patch->getObjects();
+        std::vector<std::vector<t_gobj*>> before;
+        for (auto* instance : instances)
+            before.push_back(getContent(instance));
+        editor->pd->unlockAudioThread();
+
+        REQUIRE(instances.size() == 3);
+        REQUIRE(before[0].size() == 4);
+
+        // Insert an object in the middle of the chain
+        abstraction.replaceWithText("#N canvas 0 50 450 300 12;\n#X obj 10 10 inlet;\n#X obj 10 40 + 1;\n#X obj 100 55 t f;\n#X obj 10 70 * 2;\n#X obj 10 100 outlet;\n#X connect 0 0 1 0;\n#X connect 1 0 2 0;\n#X connect 2 0 3 0;\n#X connect 3 0 4 0;\n");
+
+        editor->pd->lockAudioThread();
+        editor->pd->setThis();
+        pd::Patch::reloadPatch(abstraction, nullptr);
+
+        // The instances weren't recreated, and the new object is where the file has it
+        REQUIRE(patch->getObjects() == instances);
+        for (int i = 0; i < 3; i++) {
+            auto after = getContent(instances[i]);
+            REQUIRE(after.size() == 5);
+            REQUIRE(after[0] == before[i][0]);
+            REQUIRE(after[1] == before[i][1]);
+            REQUIRE(std::find(before[i].begin(), before[i].end(), after[2]) == before[i].end());
+            REQUIRE(after[3] == before[i][2]);
+            REQUIRE(after[4] == before[i][3]);
+        }
+        editor->pd->unlockAudioThread();
+
+        dir.deleteRecursively();
+    });
+
+    StopApplicationAfter(3000);
+}
+
+TEST_CASE("Switching presets updates patches in place", "[name]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto dir = File::createTempFile("").getSiblingFile("plugdata_preset_test");
+        dir.createDirectory();
+        auto patchFile = dir.getChildFile("preset_test.pd");
+
+        auto makeContent = [](String const& values, String const& extraObject) {
+            return "#N canvas 0 50 450 300 12;\n"
+                   "#N canvas 0 50 450 250 (subpatch) 0;\n"
+                   "#X array preset_arr 4 float 1;\n"
+                   "#A 0 " + values + ";\n"
+                   "#X coords 0 1 4 -1 200 140 1 0 0;\n"
+                   "#X restore 10 100 graph;\n"
+                   "#X obj 10 10 + 1;\n"
+                   "#X obj 10 40 * 2;\n"
+                   + extraObject +
+                   "#X connect 1 0 2 0;\n";
+        };
+
+        patchFile.replaceWithText(makeContent("0 0 0 0", ""));
+
+        auto patch = editor->pd->loadPatch(patchFile);
+        REQUIRE(patch != nullptr);
+
+        auto getContent = [patch]() {
+            std::vector<t_gobj*> content;
+            if (auto cnv = patch->getPointer()) {
+                for (auto* y = cnv->gl_list; y; y = y->g_next)
+                    content.push_back(y);
+            }
+            return content;
+        };
+
+        auto getArrayValues = [](pd::Instance* instance) {
+            std::vector<float> values;
+            int size;
+            t_word* vec;
+            auto* array = reinterpret_cast<t_garray*>(pd_findbyclass(instance->generateSymbol("preset_arr"), garray_class));
+            if (array && garray_getfloatwords(array, &size, &vec)) {
+                for (int i = 0; i < size; i++)
+                    values.push_back(vec[i].w_float);
+            }
+            return values;
+        };
+
+        editor->pd->lockAudioThread();
+        editor->pd->setThis();
+        auto* canvas = patch->getPointer().get();
+        auto before = getContent();
+        editor->pd->unlockAudioThread();
+
+        REQUIRE(before.size() == 3);
+
+        // Only the array data differs: the values are written into the existing array
+        auto content = pd::Patch::prepareContent(editor->pd, makeContent("1 2 3 4", ""));
+        REQUIRE(content != nullptr);
+
+        editor->pd->lockAudioThread();
+        editor->pd->setThis();
+        patch->updateContent(content, patchFile);
+
+        REQUIRE(patch->getPointer().get() == canvas);
+        REQUIRE(getContent() == before);
+        REQUIRE(getArrayValues(editor->pd) == std::vector<float> { 1, 2, 3, 4 });
+        editor->pd->unlockAudioThread();
+
+        // An object was added: everything that didn't change keeps its state
+        content = pd::Patch::prepareContent(editor->pd, makeContent("1 2 3 4", "#X obj 10 70 t f;\n"));
+        REQUIRE(content != nullptr);
+
+        editor->pd->lockAudioThread();
+        editor->pd->setThis();
+        patch->updateContent(content, patchFile);
+
+        auto after = getContent();
+        REQUIRE(patch->getPointer().get() == canvas);
+        REQUIRE(after.size() == 4);
+        REQUIRE(std::equal(before.begin(), before.end(), after.begin()));
+        editor->pd->unlockAudioThread();
+
+        // Content that isn't a patch can't be switched to
+        REQUIRE(pd::Patch::prepareContent(editor->pd, "not a patch") == nullptr);
+
+        dir.deleteRecursively();
+    });
+
+    StopApplicationAfter(3000);
+}
+
+TEST_CASE("Large arrays are saved to sidecar files", "[name]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto dir = File::createTempFile("").getSiblingFile("plugdata_sidecar_test");
+        dir.createDirectory();
+        auto patchFile = dir.getChildFile("sidecar_test.pd");
+        auto textFile = dir.getChildFile("sidecar_test.big.txt");
+        auto rawFile = dir.getChildFile("sidecar_test.big.f32");
+
+        int const size = LIBPD_SIDECAR_MINSIZE;
+        patchFile.replaceWithText("#N canvas 0 50 450 300 12;\n"
+                                  "#N canvas 0 50 450 250 (subpatch) 0;\n"
+                                  "#X array big " + String(size) + " float 1;\n"
+                                  "#X coords 0 1 " + String(size) + " -1 200 140 1 0 0;\n"
+                                  "#X restore 10 10 graph;\n");
+
+        auto patch = editor->pd->loadPatch(patchFile);
+        REQUIRE(patch != nullptr);
+
+        // Runs a function on the values of the array, with pd locked
+        auto withArray = [instance = editor->pd, size](auto const& function) {
+            instance->lockAudioThread();
+            instance->setThis();
+            int n = 0;
+            t_word* vec = nullptr;
+            auto* array = reinterpret_cast<t_garray*>(pd_findbyclass(instance->generateSymbol("big"), garray_class));
+            REQUIRE(array);
+            REQUIRE(garray_getfloatwords(array, &n, &vec));
+            REQUIRE(n == size);
+            function(vec);
+            instance->unlockAudioThread();
+        };
+
+        withArray([](t_word* vec) {
+            for (int i = 0; i < size; i++)
+                vec[i].w_float = static_cast<float>(i % 100);
+        });
+
+        patch->savePatch(patchFile);
+
+        // The patch refers to the sidecars instead of holding the values
+        auto saved = patchFile.loadFileAsString();
+        REQUIRE(saved.contains("#A read sidecar_test.big.txt sidecar_test.big.f32 " + String(size)));
+        REQUIRE(textFile.existsAsFile());
+        REQUIRE(rawFile.getSize() == size * static_cast<int64>(sizeof(float)));
+        REQUIRE(!patch->isDirty());
+
+        // Saving unchanged contents leaves the sidecars alone
+        auto past = Time(2000, 0, 1, 0, 0);
+        textFile.setLastModificationTime(past);
+        rawFile.setLastModificationTime(past);
+
+        patch->savePatch(patchFile);
+        REQUIRE(textFile.getLastModificationTime() == past);
+        REQUIRE(rawFile.getLastModificationTime() == past);
+
+        withArray([](t_word* vec) {
+            vec[1].w_float = -1.0f;
+        });
+
+        patch->savePatch(patchFile);
+        REQUIRE(textFile.getLastModificationTime() != past);
+        REQUIRE(rawFile.getLastModificationTime() != past);
+
+        // Reading it back gives the same values
+        editor->pd->patches.removeAllInstancesOf(patch);
+        patch = nullptr;
+        patch = editor->pd->loadPatch(patchFile);
+        REQUIRE(patch != nullptr);
+
+        withArray([](t_word* vec) {
+            REQUIRE(vec[0].w_float == 0.0f);
+            REQUIRE(vec[1].w_float == -1.0f);
+            REQUIRE(vec[size - 1].w_float == static_cast<float>((size - 1) % 100));
+        });
+
+        // A sidecar that can't be written makes the array keep its values in the patch
+        dir.getChildFile("sidecar_test.big.txt.tmp").createDirectory();
+
+        withArray([](t_word* vec) {
+            vec[2].w_float = -2.0f;
+        });
+
+        patch->savePatch(patchFile);
+
+        saved = patchFile.loadFileAsString();
+        REQUIRE(!saved.contains("#A read"));
+        REQUIRE(saved.contains("#A 0 0 -1 -2 3"));
+        REQUIRE(!patch->isDirty());
+
+        // The patch doesn't use the old sidecars anymore
+        REQUIRE(!textFile.exists());
+        REQUIRE(!rawFile.exists());
+
+        editor->pd->patches.removeAllInstancesOf(patch);
+        patch = nullptr;
+        patch = editor->pd->loadPatch(patchFile);
+        REQUIRE(patch != nullptr);
+
+        withArray([](t_word* vec) {
+            REQUIRE(vec[1].w_float == -1.0f);
+            REQUIRE(vec[2].w_float == -2.0f);
+        });
+
+        editor->pd->patches.removeAllInstancesOf(patch);
+        dir.deleteRecursively();
+    });
+
+    StopApplicationAfter(10000);
+}
+
+TEST_CASE("Undo history stays within its budget", "[name]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto* cnv = editor->getCurrentCanvas();
+        auto* patch = cnv->patch.getPointer().get();
+
+        libpd_undo_budget_set(0);
+
+        // Removing an object keeps a copy of it, which is measured by its contents
+        String arguments;
+        for (int i = 0; i < 500; i++)
+            arguments += " " + String(i);
+
+        editor->pd->lockAudioThread();
+        auto before = cnv->patch.getUndoMemoryUsage().first;
+        auto* object = cnv->patch.createObject(10, 10, "list" + arguments);
+        cnv->patch.deselectAll();
+        cnv->patch.selectObject(object);
+        cnv->patch.removeSelection();
+        cnv->patch.finishRemove();
+        auto after = cnv->patch.getUndoMemoryUsage().first;
+        editor->pd->unlockAudioThread();
+
+        REQUIRE(after - before >= 500 * sizeof(t_atom));
+
+        // Mark the current state as saved, then fill the history until the oldest steps are dropped
+        size_t const budget = 16 << 10;
+        libpd_undo_budget_set(budget);
+
+        editor->pd->lockAudioThread();
+        auto* udo = canvas_undo_get(patch);
+        udo->u_cleanstate = udo->u_last;
+        editor->pd->unlockAudioThread();
+
+        createObjectChain(editor, cnv, 500);
+
+        editor->pd->lockAudioThread();
+        editor->pd->setThis();
+
+        auto [bytes, steps] = cnv->patch.getUndoMemoryUsage();
+        REQUIRE(bytes <= budget);
+        REQUIRE(steps < 1000);
+
+        std::set<t_undo_action*> history;
+        for (auto* action = udo->u_queue->next; action; action = action->next)
+            history.insert(action);
+
+        // pd's position in the history is still in it, and the saved state was dropped
+        REQUIRE((udo->u_last == udo->u_queue || history.count(udo->u_last)));
+        REQUIRE(udo->u_cleanstate == nullptr);
+
+        // Everything that is left can still be undone
+        for (int i = 0; i < steps && libpd_can_undo(patch); i++)
+            cnv->patch.undo();
+
+        REQUIRE(!libpd_can_undo(patch));
+        REQUIRE(udo->u_last == udo->u_queue);
+        editor->pd->unlockAudioThread();
+
+        libpd_undo_budget_set(0);
+    });
+
+    StopApplicationAfter(3000);
+}
+
+TEST_CASE("Precompiled patches load faster", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        // Patches in the temporary folder are not precompiled, so keep this one somewhere else
+        auto dir = ProjectInfo::appDataDir.getChildFile("plugdata_binpatch_test");
+        dir.createDirectory();
+        auto patchFile = dir.getChildFile("large.pd");
+
+        String content = "#N canvas 0 50 450 300 12;\n";
+        for (int i = 0; i < 10000; i++) {
+            content += "#X obj " + String(i % 100 * 60) + " " + String(i / 100 * 30) + " + " + String(i) + ";\n";
+        }
+        for (int i = 1; i < 10000; i++) {
+            content += "#X connect " + String(i - 1) + " 0 " + String(i) + " 0;\n";
+        }
+        patchFile.replaceWithText(content);
+
+        int hits, misses, objects;
+
+        libpd_binary_patch_reset_stats();
+
+        auto first = editor->pd->loadPatch(patchFile);
+        REQUIRE(first);
+        editor->pd->patches.removeAllInstancesOf(first);
+
+        libpd_binary_patch_get_stats(&hits, &misses, &objects);
+
+        // The first load parses the text and writes the precompiled form in the background
+        REQUIRE(misses == 1);
+        REQUIRE(hits == 0);
+        libpd_binary_patch_flush();
+
+        auto second = editor->pd->loadPatch(patchFile);
+        REQUIRE(second);
+        editor->pd->patches.removeAllInstancesOf(second);
+
+        libpd_binary_patch_get_stats(&hits, &misses, &objects);
+
+        REQUIRE(hits == 1);
+        REQUIRE(objects == 10001);
+
+        // Changing the patch makes it get parsed again, even if its size stays the same within the same second
+        patchFile.replaceWithText(content.replaceFirstOccurrenceOf(" + 0;", " - 0;"));
+        libpd_binary_patch_flush();
+
+        auto third = editor->pd->loadPatch(patchFile);
+        REQUIRE(third);
+        editor->pd->patches.removeAllInstancesOf(third);
+
+        libpd_binary_patch_get_stats(&hits, &misses, &objects);
+        REQUIRE(misses == 2);
+        REQUIRE(hits == 1);
+
+        // Temporary patches are read as text without being precompiled
+        auto tempFile = File::createTempFile(".pd");
+        patchFile.copyFileTo(tempFile);
+        for (int i = 0; i < 2; i++) {
+            auto temp = editor->pd->loadPatch(tempFile);
+            REQUIRE(temp);
+            editor->pd->patches.removeAllInstancesOf(temp);
+            libpd_binary_patch_flush();
+        }
+
+        libpd_binary_patch_get_stats(&hits, &misses, &objects);
+        REQUIRE(misses == 2);
+        REQUIRE(hits == 1);
+
+        tempFile.deleteFile();
+        dir.deleteRecursively();
+    });
+
+    StopApplicationAfter(10000);
+}
+
+TEST_CASE("Synchronising large canvases", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto* cnv = editor->getCurrentCanvas();
+        auto created = createObjectChain(editor, cnv, 5000);
+
+        cnv->synchroniseAll();
+
+        REQUIRE(cnv->objects.size() == 5000);
+        REQUIRE(cnv->connections.size() == 4999);
+
+        // Nothing changed, so this only compares everything against pd
+        cnv->synchroniseAll();
+
+        REQUIRE(cnv->objects.size() == 5000);
+        REQUIRE(cnv->connections.size() == 4999);
+
+        for (int i = 0; i < 5000; i++) {
+            REQUIRE(cnv->objects[i]->getPointer() == created[i]);
+        }
+
+        // Removing every other object must leave the order intact
+        editor->pd->lockAudioThread();
+        for (int i = 0; i < 5000; i += 2) {
+            cnv->patch.removeObject(created[i]);
+        }
+        editor->pd->unlockAudioThread();
+
+        cnv->synchroniseAll();
+
+        REQUIRE(cnv->objects.size() == 2500);
+        REQUIRE(cnv->connections.size() == 0);
+        for (int i = 0; i < 2500; i++) {
+            REQUIRE(cnv->objects[i]->getPointer() == created[i * 2 + 1]);
+        }
+    });
+
+    StopApplicationAfter(10000);
+}
+
+TEST_CASE("Edits only apply what changed", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto* cnv = editor->getCurrentCanvas();
+        auto created = createObjectChain(editor, cnv, 1000);
+
+        cnv->synchroniseAll();
+        REQUIRE(cnv->objects.size() == 1000);
+        auto fullSynchronisations = cnv->getNumFullSynchronisations();
+
+        // Edits through pd::Patch are journaled, the canvas also gets pd's "obj" and "connect" messages for them
+        editor->pd->lockAudioThread();
+        auto* added = cnv->patch.createObject(10, 400, "f");
+        cnv->patch.createConnection(created.back(), 0, added, 0);
+        for (int i = 0; i < 1000; i += 2) {
+            cnv->patch.removeObject(created[i]);
+        }
+        editor->pd->unlockAudioThread();
+
+        cnv->synchroniseChanges();
+
+        // Wait for the messages that pd sent to the canvas
+        Timer::callAfterDelay(500, [=]() {
+            cnv->handleUpdateNowIfNeeded();
+
+            REQUIRE(cnv->getNumFullSynchronisations() == fullSynchronisations);
+            REQUIRE(cnv->objects.size() == 501);
+            REQUIRE(cnv->connections.size() == 1);
+            for (int i = 0; i < 500; i++) {
+                REQUIRE(cnv->objects[i]->getPointer() == created[i * 2 + 1]);
+            }
+            REQUIRE(cnv->objects.getLast()->getPointer() == added);
+
+            // Changes that pd makes by itself, like dynamic patching, need a full synchronisation
+            editor->pd->sendTypedMessage(cnv->patch.getPointer().get(), "obj", { 10.0f, 450.0f, "f" });
+
+            Timer::callAfterDelay(500, [=]() {
+                cnv->handleUpdateNowIfNeeded();
+
+                REQUIRE(cnv->getNumFullSynchronisations() == fullSynchronisations + 1);
+                REQUIRE(cnv->objects.size() == 502);
+            });
+        });
+    });
+
+    StopApplicationAfter(3000);
+}
+
+TEST_CASE("Zoomed out canvases draw less detail", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto* cnv = editor->getCurrentCanvas();
+        createObjectChain(editor, cnv, 10000);
+
+        cnv->synchroniseAll();
+        REQUIRE(cnv->objects.size() == 10000);
+
+        auto renderAtZoom = [cnv](float scale) {
+            cnv->zoomScale = scale;
+            cnv->zoomScale.getValueSource().sendChangeMessage(true);
+            cnv->jumpToOrigin();
+
+            auto* viewport = cnv->viewport.get();
+            viewport->createComponentSnapshot(viewport->getLocalBounds());
+        };
+
+        renderAtZoom(1.0f);
+        REQUIRE(cnv->getDetailLevel() == Canvas::DetailLevel::Full);
+        REQUIRE(cnv->objects.getFirst()->iolets.getFirst()->isVisible());
+
+        renderAtZoom(0.4f);
+        REQUIRE(cnv->getDetailLevel() == Canvas::DetailLevel::Reduced);
+
+        // Iolets stay visible, so connections can still be made when zoomed out
+        REQUIRE(cnv->objects.getFirst()->iolets.getFirst()->isVisible());
+
+        renderAtZoom(0.2f);
+        REQUIRE(cnv->getDetailLevel() == Canvas::DetailLevel::Minimal);
+        REQUIRE(!cnv->objects.getFirst()->gui->isVisible());
+        REQUIRE(cnv->objects.getFirst()->iolets.getFirst()->isVisible());
+
+        // Zooming back in restores everything
+        renderAtZoom(1.0f);
+        REQUIRE(cnv->objects.getFirst()->gui->isVisible());
+        REQUIRE(cnv->objects.getFirst()->iolets.getFirst()->isVisible());
+    });
+
+    StopApplicationAfter(20000);
+}
+
+TEST_CASE("GUI objects update from a single frame scheduler", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto* cnv = editor->getCurrentCanvas();
+
+        editor->pd->lockAudioThread();
+        for (int i = 0; i < 200; i++) {
+            cnv->patch.createObject(20 + i % 20 * 10, 20 + i / 20 * 10, "scope~");
+        }
+        editor->pd->unlockAudioThread();
+
+        cnv->synchroniseAll();
+        REQUIRE(cnv->objects.size() == 200);
+
+        int numOnScreen = 0;
+        for (auto* object : cnv->objects) {
+            auto* listener = dynamic_cast<FrameScheduler::Listener*>(object->gui.get());
+            REQUIRE(listener != nullptr);
+            REQUIRE(editor->frameScheduler.hasListener(listener) == object->isOnScreen());
+            numOnScreen += object->isOnScreen();
+        }
+
+        auto framesBefore = editor->frameScheduler.getNumFrames();
+        auto callbacksBefore = editor->frameScheduler.getNumCallbacks();
+
+        Timer::callAfterDelay(2000, [=]() {
+            auto frames = static_cast<double>(editor->frameScheduler.getNumFrames() - framesBefore) / 2.0;
+            auto callbacks = static_cast<double>(editor->frameScheduler.getNumCallbacks() - callbacksBefore) / 2.0;
+            auto refreshRate = editor->frameScheduler.getRefreshRate();
+
+            // One wakeup per frame, no matter how many objects there are to update
+            REQUIRE(frames > 0.0);
+            REQUIRE(frames <= refreshRate * 1.25);
+
+            // Every scope on screen is called on every nth frame, to get close to the 25 Hz it asks for
+            auto divisor = std::max(1, roundToInt(refreshRate / 25.0));
+            auto expectedCallbacks = numOnScreen * frames / divisor;
+            REQUIRE(callbacks >= expectedCallbacks * 0.75);
+            REQUIRE(callbacks <= expectedCallbacks * 1.25 + numOnScreen);
+        });
+    });
+
+    StopApplicationAfter(10000);
+}
+
+TEST_CASE("Dragging objects doesn't lock pd", "[benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=](){
+
+        auto* cnv = editor->getCurrentCanvas();
+        createObjectChain(editor, cnv, 100);
+
+        cnv->synchroniseAll();
+        REQUIRE(cnv->objects.size() == 100);
+        REQUIRE(cnv->connections.size() == 99);
+
+        auto getPdPositions = [editor, cnv]() {
+            std::vector<Point<int>> positions;
+            editor->pd->lockAudioThread();
+            for (auto* object : cnv->objects) {
+                auto* ob = pd::Patch::checkObject(object->getPointer());
+                positions.emplace_back(ob->te_xpix, ob->te_ypix);
+            }
+            editor->pd->unlockAudioThread();
+            return positions;
+        };
+
+        // Drag the first half, so some cables move as a whole and others get stretched
+        for (int i = 0; i < 50; i++) {
+            cnv->setSelected(cnv->objects[i], true, false);
+            cnv->setSelected(cnv->connections[i], true, false);
+        }
+
+        auto before = getPdPositions();
+
+        // Send the mouse events that dragging the first object would cause
+        auto* dragged = cnv->objects[0];
+        auto mouseDownPosition = dragged->getLocalBounds().getCentre().toFloat();
+        auto mouseDownTime = Time::getCurrentTime();
+        auto createMouseEvent = [dragged, mouseDownPosition, mouseDownTime](Point<float> offset, bool wasDragged) {
+            return MouseEvent(Desktop::getInstance().getMainMouseSource(), mouseDownPosition + offset, ModifierKeys::leftButtonModifier,
+                MouseInputSource::defaultPressure, MouseInputSource::defaultOrientation, MouseInputSource::defaultRotation,
+                MouseInputSource::defaultTiltX, MouseInputSource::defaultTiltY, dragged, dragged, Time::getCurrentTime(),
+                mouseDownPosition, mouseDownTime, 1, wasDragged);
+        };
+
+        dragged->mouseDown(createMouseEvent({}, false));
+
+        auto locksBefore = editor->pd->getNumAudioThreadLocks();
+
+        for (int step = 1; step <= 20; step++) {
+            // Drag events are rate limited, let every one of them through
+            cnv->objectRateReducer.timerCallback();
+            dragged->mouseDrag(createMouseEvent(Point<float>(step * 2, step), true));
+            cnv->viewport->createComponentSnapshot(cnv->viewport->getLocalBounds());
+        }
+
+        // Nothing was sent to pd while dragging
+        REQUIRE(editor->pd->getNumAudioThreadLocks() == locksBefore);
+        REQUIRE(getPdPositions() == before);
+
+        dragged->mouseUp(createMouseEvent(Point<float>(40, 20), true));
+
+        // Releasing the mouse moves the dragged objects in pd, all by the same distance
+        auto after = getPdPositions();
+        auto distance = after[0] - before[0];
+        REQUIRE(!distance.isOrigin());
+        for (int i = 0; i < 100; i++) {
+            REQUIRE(after[i] - before[i] == (i < 50 ? distance : Point<int>()));
+        }
+
+        // Synchronising afterwards doesn't move anything again
+        cnv->synchroniseAll();
+        REQUIRE(getPdPositions() == after);
+    });
+
+    StopApplicationAfter(10000);
+}